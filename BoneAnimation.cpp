@@ -9,14 +9,15 @@
 #include <set>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
 
 BoneAnimation::BoneAnimation(std::string const &filename) {
 	std::cout << "Reading bone-based animation from '" << filename << "'." << std::endl;
 
-	std::ifstream file(filename, std::ios::binary);
+	MappedChunks file(filename);
+	file.inflate_all(); //(frames and mesh are both large, so if they are compressed, decompress them side by side)
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	ChunkSpan< char > strings = file.find< char >("str0");
 
 	{ //read bones:
 		struct BoneInfo {
@@ -26,8 +27,7 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(BoneInfo) == 4*2 + 4 + 4*12, "BoneInfo is packed.");
 
-		std::vector< BoneInfo > file_bones;
-		read_chunk(file, "bon0", &file_bones);
+		ChunkSpan< BoneInfo > file_bones = file.find< BoneInfo >("bon0");
 		bones.reserve(file_bones.size());
 		for (auto const &file_bone : file_bones) {
 			if (!(file_bone.name_begin <= file_bone.name_end && file_bone.name_end <= strings.size())) {
@@ -38,14 +38,17 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 			}
 			bones.emplace_back();
 			Bone &bone = bones.back();
-			bone.name = std::string(&strings[0] + file_bone.name_begin, &strings[0] + file_bone.name_end);
+			bone.name = std::string(strings.data() + file_bone.name_begin, strings.data() + file_bone.name_end);
 			bone.parent = file_bone.parent;
 			bone.inverse_bind_matrix = file_bone.inverse_bind_matrix;
 		}
 	}
 
 	static_assert(sizeof(PoseBone) == 3*4 + 4*4 + 3*4, "PoseBone is packed.");
-	read_chunk(file, "frm0", &frame_bones);
+	{ //(frames are kept for posing, so they are copied out of the file)
+		ChunkSpan< PoseBone > file_frame_bones = file.find< PoseBone >("frm0");
+		frame_bones.assign(file_frame_bones.begin(), file_frame_bones.end());
+	}
 	if (frame_bones.size() % bones.size() != 0) {
 		throw std::runtime_error("frame bones is not divisible by bones");
 	}
@@ -59,8 +62,7 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(AnimationInfo) == 4*2 + 4*2, "AnimationInfo is packed.");
 
-		std::vector< AnimationInfo > file_animations;
-		read_chunk(file, "act0", &file_animations);
+		ChunkSpan< AnimationInfo > file_animations = file.find< AnimationInfo >("act0");
 		animations.reserve(file_animations.size());
 		for (auto const &file_animation : file_animations) {
 			if (!(file_animation.name_begin <= file_animation.name_end && file_animation.name_end <= strings.size())) {
@@ -71,13 +73,36 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 			}
 			animations.emplace_back();
 			Animation &animation = animations.back();
-			animation.name = std::string(&strings[0] + file_animation.name_begin, &strings[0] + file_animation.name_end);
+			animation.name = std::string(strings.data() + file_animation.name_begin, strings.data() + file_animation.name_end);
 			animation.begin = file_animation.begin;
 			animation.end = file_animation.end;
 		}
 	}
 
-	{ //read actual mesh:
+	//read mesh; the branches only pick the vertex layout (and attributes to match), then all vertices are checked and uploaded alike:
+	uint8_t const *vertices = nullptr;
+	size_t vertex_count = 0;
+	if (file.has("msh1")) { //quantized mesh (from meshes/quantize-vertices.py):
+		struct Vertex {
+			glm::u16vec4 Position; //half floats (w is 1)
+			uint32_t Normal; //GL_INT_2_10_10_10_REV
+			glm::u8vec4 Color;
+			glm::u16vec2 TexCoord; //half floats
+			glm::u8vec4 BoneWeights;
+			glm::u8vec4 BoneIndices;
+		};
+		static_assert(sizeof(Vertex) == 4*2+4+4*1+2*2+4*1+4*1, "Vertex is packed.");
+		ChunkSpan< Vertex > data = file.find< Vertex >("msh1");
+		vertices = reinterpret_cast< uint8_t const * >(data.data());
+		vertex_count = data.size();
+
+		Position = MeshBuffer::Attrib(4, GL_HALF_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = MeshBuffer::Attrib(4, GL_INT_2_10_10_10_REV, MeshBuffer::Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Normal));
+		Color = MeshBuffer::Attrib(4, GL_UNSIGNED_BYTE, MeshBuffer::Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
+		TexCoord = MeshBuffer::Attrib(2, GL_HALF_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, TexCoord));
+		BoneWeights = MeshBuffer::Attrib(4, GL_UNSIGNED_BYTE, MeshBuffer::Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, BoneWeights));
+		BoneIndices = MeshBuffer::Attrib(4, GL_UNSIGNED_BYTE, MeshBuffer::Attrib::AsInteger, sizeof(Vertex), offsetof(Vertex, BoneIndices));
+	} else { //actual mesh:
 		struct Vertex {
 			glm::vec3 Position;
 			glm::vec3 Normal;
@@ -88,19 +113,9 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4+4*4+4*4, "Vertex is packed.");
 		//GLAttribBuffer< glm::vec3, glm::vec3, glm::u8vec4, glm::vec2, glm::vec4, glm::uvec4 > buffer;
-		std::vector< Vertex > data;
-		read_chunk(file, "msh0", &data);
-
-		//check bone indices:
-		for (auto const &vertex : data) {
-			if ( vertex.BoneIndices.x >= bones.size()
-				|| vertex.BoneIndices.y >= bones.size()
-				|| vertex.BoneIndices.z >= bones.size()
-				|| vertex.BoneIndices.w >= bones.size()
-			) {
-				throw std::runtime_error("animation mesh has out of range vertex index");
-			}
-		}
+		ChunkSpan< Vertex > data = file.find< Vertex >("msh0");
+		vertices = reinterpret_cast< uint8_t const * >(data.data());
+		vertex_count = data.size();
 
 		{ //DEBUG: dump bounding box info
 			glm::vec3 min = glm::vec3(std::numeric_limits< float >::infinity());
@@ -112,24 +127,38 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 			std::cout << "INFO: bounding box of animation mesh in '" << filename << "' is [" << min.x << "," << max.x << "]x[" << min.y << "," << max.y << "]x[" << min.z << "," << max.z << "]" << std::endl;
 		}
 
-		//upload data:
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		//specify the (only) mesh:
-		mesh.start = 0;
-		mesh.count = GLuint(data.size());
-
-		//store attributes for later vao creation:
 		Position = MeshBuffer::Attrib(3, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
 		Normal = MeshBuffer::Attrib(3, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Normal));
 		Color = MeshBuffer::Attrib(4, GL_UNSIGNED_BYTE, MeshBuffer::Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
 		TexCoord = MeshBuffer::Attrib(2, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, TexCoord));
 		BoneWeights = MeshBuffer::Attrib(4, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, BoneWeights));
 		BoneIndices = MeshBuffer::Attrib(4, GL_UNSIGNED_INT, MeshBuffer::Attrib::AsInteger, sizeof(Vertex), offsetof(Vertex, BoneIndices));
+	}
+
+	//check bone indices (uint8 or uint32, as per BoneIndices.type):
+	for (size_t v = 0; v < vertex_count; ++v) {
+		uint8_t const *indices = vertices + v * BoneIndices.stride + BoneIndices.offset;
+		for (uint32_t i = 0; i < 4; ++i) {
+			uint32_t index = indices[i];
+			if (BoneIndices.type == GL_UNSIGNED_INT) std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+			if (index >= bones.size()) {
+				throw std::runtime_error("animation mesh has out of range vertex index");
+			}
+		}
+	}
+
+	//upload data (straight from the mapped file):
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertex_count * Position.stride, vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//specify the (only) mesh:
+	mesh.start = 0;
+	mesh.count = GLuint(vertex_count);
 
+	if (file.realigned_bytes > 0) {
+		std::cerr << "WARNING: copied " << file.realigned_bytes << " bytes of misaligned chunk data from animation file '" << filename << "' (re-export it to pad its chunks)" << std::endl;
 	}
 
 	GL_ERRORS();
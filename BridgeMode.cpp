@@ -63,6 +63,7 @@ Load< Scene > bridge_scene(LoadTagDefault, [](){
 		MeshBuffer::Mesh const &mesh = bridge_meshes->lookup(m);
 		obj->programs[Scene::Object::ProgramTypeDefault].start = mesh.start;
 		obj->programs[Scene::Object::ProgramTypeDefault].count = mesh.count;
+		obj->programs[Scene::Object::ProgramTypeDefault].index_type = mesh.index_type;
 	});
 
 	//look up various transforms:
@@ -176,9 +176,11 @@ Load< Scene > scene(LoadTagDefault, [](){
 		MeshBuffer::Mesh const &mesh = meshes->lookup(m);
 		obj->programs[Scene::Object::ProgramTypeDefault].start = mesh.start;
 		obj->programs[Scene::Object::ProgramTypeDefault].count = mesh.count;
+		obj->programs[Scene::Object::ProgramTypeDefault].index_type = mesh.index_type;
 
 		obj->programs[Scene::Object::ProgramTypeShadow].start = mesh.start;
 		obj->programs[Scene::Object::ProgramTypeShadow].count = mesh.count;
+		obj->programs[Scene::Object::ProgramTypeShadow].index_type = mesh.index_type;
 	});
 
 	//look up camera parent transform:
@@ -0,0 +1,86 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#undef min
+#undef max
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	#if defined(_WIN32)
+	file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		file_handle = nullptr;
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size)) {
+		CloseHandle(file_handle);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	size = size_t(file_size.QuadPart);
+	if (size == 0) return; //can't map an empty file, but there's nothing to read anyway
+	mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_handle == NULL) {
+		CloseHandle(file_handle);
+		throw std::runtime_error("Failed to create mapping of '" + filename + "'.");
+	}
+	data = reinterpret_cast< uint8_t const * >(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	size = size_t(st.st_size);
+	if (size == 0) { //can't map an empty file, but there's nothing to read anyway
+		close(fd);
+		return;
+	}
+	void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //mapping stays valid after close
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	data = reinterpret_cast< uint8_t const * >(mapped);
+	#endif
+}
+
+MappedFile::~MappedFile() {
+	#if defined(_WIN32)
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	#else
+	if (data) munmap(const_cast< uint8_t * >(data), size);
+	#endif
+}
+
+void MappedFile::release(uint8_t const *begin, uint8_t const *end) {
+	#if defined(_WIN32)
+	//(no cheap equivalent for a read-only view; the OS trims the working set when it needs to)
+	(void)begin;
+	(void)end;
+	#else
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	uintptr_t from = (uintptr_t(begin) + page - 1) / page * page;
+	uintptr_t to = uintptr_t(end) / page * page;
+	if (to > from) madvise(reinterpret_cast< void * >(from), to - from, MADV_DONTNEED);
+	#endif
+}
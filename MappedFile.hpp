@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+//"MappedFile" maps a whole file read-only into memory.
+// Reading from 'data' pages the file in on demand, so there is no up-front copy.
+
+struct MappedFile {
+	//note: will throw if the file cannot be opened or mapped.
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	uint8_t const *data = nullptr;
+	size_t size = 0;
+
+	//hint that [begin,end) won't be read again soon, so its (whole) pages can leave memory:
+	// (reading them again still works; they are paged back in from the file)
+	void release(uint8_t const *begin, uint8_t const *end);
+
+	//internals:
+	std::string filename;
+	#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+};
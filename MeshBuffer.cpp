@@ -15,7 +15,7 @@
 MeshBuffer::MeshBuffer(std::string const &filename) {
 	glGenBuffers(1, &vbo);
 
-	std::ifstream file(filename, std::ios::binary);
+	MappedChunks file(filename);
 
 	GLuint total = 0;
 	//read + upload data chunk:
@@ -25,10 +25,9 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4, "Vertex is packed.");
 
-		std::vector< Vertex > data;
-		read_chunk(file, "p...", &data);
+		ChunkSpan< Vertex > data = file.find< Vertex >("p...");
 
-		//upload data:
+		//upload data (straight from the mapped file):
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -45,10 +44,9 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4+3*4, "Vertex is packed.");
 
-		std::vector< Vertex > data;
-		read_chunk(file, "pn..", &data);
+		ChunkSpan< Vertex > data = file.find< Vertex >("pn..");
 
-		//upload data:
+		//upload data (straight from the mapped file):
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -59,6 +57,29 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		Position = Attrib(3, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
 		Normal = Attrib(3, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Normal));
 
+	} else if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".pnc" && file.has("qnc.")) {
+		//quantized (from meshes/quantize-vertices.py):
+		struct Vertex {
+			glm::u16vec4 Position; //half floats (w is 1)
+			uint32_t Normal; //GL_INT_2_10_10_10_REV
+			glm::u8vec4 Color;
+		};
+		static_assert(sizeof(Vertex) == 4*2+4+4*1, "Vertex is packed.");
+
+		ChunkSpan< Vertex > data = file.find< Vertex >("qnc.");
+
+		//upload data (straight from the mapped file):
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		total = GLuint(data.size()); //store total for later checks on index
+
+		//store attrib locations:
+		Position = Attrib(4, GL_HALF_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = Attrib(4, GL_INT_2_10_10_10_REV, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
+
 	} else if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".pnc") {
 		struct Vertex {
 			glm::vec3 Position;
@@ -67,10 +88,9 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4+3*4+4*1, "Vertex is packed.");
 
-		std::vector< Vertex > data;
-		read_chunk(file, "pnc.", &data);
+		ChunkSpan< Vertex > data = file.find< Vertex >("pnc.");
 
-		//upload data:
+		//upload data (straight from the mapped file):
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -82,6 +102,36 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		Normal = Attrib(3, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Normal));
 		Color = Attrib(4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
 
+	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct" && (file.has("qnct") || file.has("qnch"))) {
+		//quantized (from meshes/quantize-vertices.py), with unorm16 texcoords ('qnct') or, if they didn't fit in [0,1], half float texcoords ('qnch'):
+		struct Vertex {
+			glm::u16vec4 Position; //half floats (w is 1)
+			uint32_t Normal; //GL_INT_2_10_10_10_REV
+			glm::u8vec4 Color;
+			glm::u16vec2 TexCoord;
+		};
+		static_assert(sizeof(Vertex) == 4*2+4+4*1+2*2, "Vertex is packed.");
+
+		bool half_texcoords = file.has("qnch");
+		ChunkSpan< Vertex > data = file.find< Vertex >(half_texcoords ? "qnch" : "qnct");
+
+		//upload data (straight from the mapped file):
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		total = GLuint(data.size()); //store total for later checks on index
+
+		//store attrib locations:
+		Position = Attrib(4, GL_HALF_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = Attrib(4, GL_INT_2_10_10_10_REV, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
+		if (half_texcoords) {
+			TexCoord = Attrib(2, GL_HALF_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, TexCoord));
+		} else {
+			TexCoord = Attrib(2, GL_UNSIGNED_SHORT, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, TexCoord));
+		}
+
 	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
 		struct Vertex {
 			glm::vec3 Position;
@@ -91,10 +141,9 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
 
-		std::vector< Vertex > data;
-		read_chunk(file, "pnct", &data);
+		ChunkSpan< Vertex > data = file.find< Vertex >("pnct");
 
-		//upload data:
+		//upload data (straight from the mapped file):
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -111,39 +160,81 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	ChunkSpan< char > strings = file.find< char >("str0");
 
-	{ //read index chunk, add to meshes:
+	//add a mesh to the collection:
+	auto add_mesh = [&](uint32_t name_begin, uint32_t name_end, Mesh const &mesh) {
+		if (!(name_begin <= name_end && name_end <= strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+		std::string name(strings.data() + name_begin, strings.data() + name_end);
+		bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
+		if (!inserted) {
+			std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+		}
+	};
+
+	if (file.has("tri0")) { //indexed file (from meshes/cook-meshes.py): read index and triangle chunks, add to meshes:
 		struct IndexEntry {
 			uint32_t name_begin, name_end;
 			uint32_t vertex_begin, vertex_end;
+			uint32_t index_begin, index_end;
 		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+		static_assert(sizeof(IndexEntry) == 24, "Index entry should be packed");
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		ChunkSpan< IndexEntry > index = file.find< IndexEntry >("idx1");
+		ChunkSpan< uint32_t > indices = file.find< uint32_t >("tri0");
 
 		for (auto const &entry : index) {
-			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-				throw std::runtime_error("index entry has out-of-range name begin/end");
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
+				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			}
+			if (!(entry.index_begin <= entry.index_end && entry.index_end <= indices.size() && (entry.index_end - entry.index_begin) % 3 == 0)) {
+				throw std::runtime_error("index entry has out-of-range or non-triangle index start/count");
 			}
+			for (uint32_t i = entry.index_begin; i < entry.index_end; ++i) {
+				if (!(entry.vertex_begin <= indices[i] && indices[i] < entry.vertex_end)) {
+					throw std::runtime_error("index entry has indices outside its vertices");
+				}
+			}
+			Mesh mesh;
+			mesh.start = entry.index_begin;
+			mesh.count = entry.index_end - entry.index_begin;
+			mesh.index_type = GL_UNSIGNED_INT;
+			add_mesh(entry.name_begin, entry.name_end, mesh);
+		}
+
+		//upload indices (straight from the mapped file):
+		// (through the GL_ARRAY_BUFFER binding point, since the element buffer binding belongs to whatever vertex array object is bound)
+		glGenBuffers(1, &ibo);
+		glBindBuffer(GL_ARRAY_BUFFER, ibo);
+		glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	} else { //read index chunk, add to meshes:
+		struct IndexEntry {
+			uint32_t name_begin, name_end;
+			uint32_t vertex_begin, vertex_end;
+		};
+		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+		ChunkSpan< IndexEntry > index = file.find< IndexEntry >("idx0");
+
+		for (auto const &entry : index) {
 			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
 			Mesh mesh;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
-			}
+			add_mesh(entry.name_begin, entry.name_end, mesh);
 		}
 	}
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+	for (auto const &magic : file.unread()) {
+		std::cerr << "WARNING: unused chunk '" << magic << "' in mesh file '" << filename << "'" << std::endl;
+	}
+	if (file.realigned_bytes > 0) {
+		std::cerr << "WARNING: copied " << file.realigned_bytes << " bytes of misaligned chunk data from mesh file '" << filename << "' (re-export it to pad its chunks)" << std::endl;
 	}
 
 	/* //DEBUG:
@@ -172,5 +263,14 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	attribs.emplace_back("Color", Color);
 	attribs.emplace_back("TexCoord", TexCoord);
 
-	return ::make_vao_for_program(vbo, attribs.begin(), attribs.end(), program);
+	GLuint vao = ::make_vao_for_program(vbo, attribs.begin(), attribs.end(), program);
+
+	if (ibo != 0) {
+		//element buffer binding is part of vertex array object state:
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		glBindVertexArray(0);
+	}
+
+	return vao;
 }
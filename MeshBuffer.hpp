@@ -9,6 +9,7 @@
 
 struct MeshBuffer {
 	GLuint vbo = 0; //OpenGL vertex buffer object containing the meshes' data
+	GLuint ibo = 0; //OpenGL buffer object containing the meshes' indices (only for indexed files, made by meshes/cook-meshes.py)
 
 	//Attrib includes location within the vertex buffer of various attributes:
 	// (exactly the parameters to glVertexAttribPointer)
@@ -56,12 +57,18 @@ struct MeshBuffer {
 	//look up a particular mesh in the DB:
 	// note: will throw if mesh not found.
 	struct Mesh {
-		GLuint start = 0;
-		GLuint count = 0;
+		GLuint start = 0; //first vertex (or, for indexed meshes, first index)
+		GLuint count = 0; //vertices (or indices) to draw
+		GLenum index_type = GL_NONE; //for indexed meshes, the type of their indices (draw with glDrawElements rather than glDrawArrays)
 	};
+	//offset (as glDrawElements takes it) of index 'start' in an element buffer holding indices of type 'index_type':
+	static GLvoid const *index_offset(GLenum index_type, GLuint start) {
+		GLsizei index_size = (index_type == GL_UNSIGNED_INT ? 4 : index_type == GL_UNSIGNED_SHORT ? 2 : 1);
+		return (GLbyte const *)0 + size_t(start) * index_size;
+	}
 	const Mesh &lookup(std::string const &name) const;
 	
-	//build a vertex array object that links this vbo to attributes to a program:
+	//build a vertex array object that links this vbo to attributes to a program (and, if present, binds ibo as its element buffer):
 	//  will throw if program defines attributes not contained in this buffer
 	//  and warn if this buffer contains attributes not active in the program
 	GLuint make_vao_for_program(GLuint program) const;
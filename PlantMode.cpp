@@ -62,6 +62,7 @@ PlantMode::PlantMode() {
 		tile_info.vao = *plant_meshes_for_vertex_color_program;
 		tile_info.start = plant_tile->start;
 		tile_info.count = plant_tile->count;
+		tile_info.index_type = plant_tile->index_type;
 		tile_info.mvp_mat4 = vertex_color_program->object_to_clip_mat4;
 		tile_info.mv_mat4x3 = vertex_color_program->object_to_light_mat4x3;
 		tile_info.itmv_mat3 = vertex_color_program->normal_to_light_mat3;
@@ -1,4 +1,5 @@
 #include "Scene.hpp"
+#include "MeshBuffer.hpp"
 #include "read_chunk.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -242,7 +243,11 @@ void Scene::draw(glm::mat4 const &world_to_clip, Object::ProgramType program_typ
 		glBindVertexArray(info.vao);
 
 		//draw the object:
-		glDrawArrays(GL_TRIANGLES, info.start, info.count);
+		if (info.index_type == GL_NONE) {
+			glDrawArrays(GL_TRIANGLES, info.start, info.count);
+		} else {
+			glDrawElements(GL_TRIANGLES, info.count, info.index_type, MeshBuffer::index_offset(info.index_type, info.start));
+		}
 
 		//unbind textures:
 		for (uint32_t i = 0; i < Object::ProgramInfo::TextureCount; ++i) {
@@ -273,10 +278,9 @@ Scene::~Scene() {
 void Scene::load(std::string const &filename,
 	std::function< void(Scene &, Transform *, std::string const &) > const &on_object) {
 
-	std::ifstream file(filename, std::ios::binary);
+	MappedChunks file(filename);
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	ChunkSpan< char > names = file.find< char >("str0");
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -287,8 +291,7 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
+	ChunkSpan< HierarchyEntry > hierarchy = file.find< HierarchyEntry >("xfh0");
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -296,8 +299,7 @@ void Scene::load(std::string const &filename,
 		uint32_t name_end;
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
+	ChunkSpan< MeshEntry > meshes = file.find< MeshEntry >("msh0");
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -306,8 +308,7 @@ void Scene::load(std::string const &filename,
 		float clip_near, clip_far;
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > cameras;
-	read_chunk(file, "cam0", &cameras);
+	ChunkSpan< CameraEntry > cameras = file.find< CameraEntry >("cam0");
 
 	struct LightEntry {
 		uint32_t transform;
@@ -318,11 +319,13 @@ void Scene::load(std::string const &filename,
 		float fov;
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > lamps;
-	read_chunk(file, "lmp0", &lamps);
+	ChunkSpan< LightEntry > lamps = file.find< LightEntry >("lmp0");
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
+	for (auto const &magic : file.unread()) {
+		std::cerr << "WARNING: unused chunk '" << magic << "' in scene file '" << filename << "'" << std::endl;
+	}
+	if (file.realigned_bytes > 0) {
+		std::cerr << "WARNING: copied " << file.realigned_bytes << " bytes of misaligned chunk data from scene file '" << filename << "' (re-export it to pad its chunks)" << std::endl;
 	}
 
 	//--------------------------------
@@ -78,6 +78,7 @@ struct Scene {
 			GLuint vao = 0;
 			GLuint start = 0;
 			GLuint count = 0;
+			GLenum index_type = GL_NONE; //if set, draw indices [start,start+count) of this type from the vao's element buffer
 
 			//uniforms:
 			GLuint mvp_mat4 = -1U; //uniform index for object-to-clip matrix (mat4)
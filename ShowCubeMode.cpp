@@ -5,20 +5,29 @@
 #include "cube_program.hpp"
 #include "cube_diffuse_program.hpp"
 #include "cube_reflect_program.hpp"
+#include "oct_program.hpp"
+#include "oct_reflect_program.hpp"
 #include "make_vao_for_program.hpp"
 #include "load_save_png.hpp"
-#include "rgbe.hpp"
+#include "rgbe_n.hpp"
+#include "cube_e5.hpp"
+#include "cube_bc6h.hpp"
+#include "bc6h.hpp"
 #include "data_path.hpp"
+#include "cubes/ThreadPool.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <random>
+#include <fstream>
+#include <chrono>
+#include <iostream>
 
 extern std::shared_ptr< MenuMode > menu;
 
-//load an rgbe cubemap texture:
-GLuint load_cube(std::string const &filename) {
+//load an rgbe cubemap face stack into one level of the currently bound cubemap, returning the face size:
+static uint32_t upload_cube_level(std::string const &filename, GLint level, uint32_t expected_size) {
 	//assume cube is stacked faces +x,-x,+y,-y,+z,-z:
 	glm::uvec2 size;
 	std::vector< glm::u8vec4 > data;
@@ -26,25 +35,97 @@ GLuint load_cube(std::string const &filename) {
 	if (size.y != size.x * 6) {
 		throw std::runtime_error("Expecting stacked faces in cubemap.");
 	}
+	if (expected_size != 0 && size.x != expected_size) {
+		throw std::runtime_error("Cubemap level '" + filename + "' is " + std::to_string(size.x) + " wide; expecting " + std::to_string(expected_size) + ".");
+	}
 
 	//convert from rgb+exponent to floating point:
-	std::vector< glm::vec3 > float_data;
-	float_data.reserve(data.size());
-	for (auto const &px : data) {
-		float_data.emplace_back(rgbe_to_float(px));
+	std::vector< glm::vec3 > float_data(data.size());
+	rgbe_to_float_n(data.data(), data.size(), float_data.data());
+
+	//the RGB9_E5 format is close to the source format and a lot more efficient to store than full floating point.
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 0*size.x*size.x);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 1*size.x*size.x);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 2*size.x*size.x);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 3*size.x*size.x);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 4*size.x*size.x);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, level, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 5*size.x*size.x);
+
+	return size.x;
+}
+
+static bool has_extension(std::string const &name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		if (name == reinterpret_cast< char const * >(glGetStringi(GL_EXTENSIONS, i))) return true;
 	}
+	return false;
+}
 
-	//upload to cubemap:
+//load an rgbe cubemap texture (.png), a packed RGB9_E5 cubemap (.e5, see cube_e5.hpp), or a BC6H cubemap (.bc6, see cube_bc6h.hpp):
+// if pre-filtered mip levels written by 'blur_cube ggx' sit next to a .png (name.1.png, name.2.png, ...),
+// they are used instead of generated (box-filtered) mipmaps; .e5 and .bc6 files carry their levels inside.
+// (BC6H blocks are uploaded as-is where GL_ARB_texture_compression_bptc is supported, and decoded to RGB9_E5 otherwise)
+GLuint load_cube(std::string const &filename) {
 	GLuint tex = 0;
 	glGenTextures(1, &tex);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
-	//the RGB9_E5 format is close to the source format and a lot more efficient to store than full floating point.
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 0*size.x*size.x);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 1*size.x*size.x);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 2*size.x*size.x);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 3*size.x*size.x);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 4*size.x*size.x);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGB9_E5, size.x, size.x, 0, GL_RGB, GL_FLOAT, float_data.data() + 5*size.x*size.x);
+
+	uint32_t base_size = 0;
+	uint32_t levels = 1;
+	bool e5 = (filename.size() >= 3 && filename.substr(filename.size() - 3) == ".e5");
+	bool bc6 = (filename.size() >= 4 && filename.substr(filename.size() - 4) == ".bc6");
+	if (bc6) {
+		CubeBC6HFile file(filename);
+		base_size = file.size;
+		levels = file.levels;
+		bool bptc = has_extension("GL_ARB_texture_compression_bptc");
+		std::vector< glm::vec3 > decoded;
+		for (uint32_t level = 0; level < levels; ++level) {
+			uint32_t size = file.level_size(level);
+			size_t face_bytes = file.face_bytes(level);
+			uint8_t const *data = file.level_data(level);
+			for (uint32_t f = 0; f < 6; ++f) {
+				if (bptc) {
+					glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, level, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, size, size, 0, GLsizei(face_bytes), data + f*face_bytes);
+				} else {
+					decoded.resize(size * size);
+					decode_bc6h_image(glm::uvec2(size), data + f*face_bytes, decoded.data());
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, level, GL_RGB9_E5, size, size, 0, GL_RGB, GL_FLOAT, decoded.data());
+				}
+			}
+		}
+	} else if (e5) {
+		//texels are already in the texture's format, so they go straight from the mapped file to GL:
+		CubeE5File file(filename);
+		base_size = file.size;
+		levels = file.levels;
+		for (uint32_t level = 0; level < levels; ++level) {
+			uint32_t size = file.level_size(level);
+			uint32_t const *data = file.level_data(level);
+			for (uint32_t f = 0; f < 6; ++f) {
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, level, GL_RGB9_E5, size, size, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, data + f*size*size);
+			}
+		}
+	} else {
+		base_size = upload_cube_level(filename, 0, 0);
+	}
+
+	//look for pre-filtered levels:
+	while (!e5 && !bc6 && (base_size >> levels) > 0) {
+		std::string level_file = filename;
+		auto dot = level_file.rfind('.');
+		if (dot == std::string::npos || level_file.find('/', dot) != std::string::npos) dot = level_file.size();
+		level_file.insert(dot, "." + std::to_string(levels));
+		if (!std::ifstream(level_file)) break;
+		upload_cube_level(level_file, levels, base_size >> levels);
+		++levels;
+	}
+	bool prefiltered = (levels > 1);
+	if (prefiltered && (base_size >> levels) > 0) {
+		throw std::runtime_error("Cubemap '" + filename + "' has only " + std::to_string(levels) + " pre-filtered levels; expecting a full chain.");
+	}
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -54,7 +135,9 @@ GLuint load_cube(std::string const &filename) {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	if (!prefiltered) {
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	}
 
 	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
@@ -67,12 +150,74 @@ GLuint load_cube(std::string const &filename) {
 }
 
 
+//load an rgbe octahedral map (.png, see octahedral.hpp) as a 2D texture:
+// as with load_cube, pre-filtered levels (name.1.png, ...) written by 'blur_cube --layout oct ggx' are used if present.
+// (the map folds over at its edges, which clamping only approximates; see octahedral.hpp)
+GLuint load_oct(std::string const &filename) {
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+
+	uint32_t base_size = 0;
+	uint32_t levels = 0;
+	while (levels == 0 || (base_size >> levels) > 0) {
+		std::string level_file = filename;
+		if (levels > 0) {
+			auto dot = level_file.rfind('.');
+			if (dot == std::string::npos || level_file.find('/', dot) != std::string::npos) dot = level_file.size();
+			level_file.insert(dot, "." + std::to_string(levels));
+			if (!std::ifstream(level_file)) break;
+		}
+		glm::uvec2 size;
+		std::vector< glm::u8vec4 > data;
+		load_png(level_file, &size, &data, LowerLeftOrigin);
+		if (size.x != size.y) {
+			throw std::runtime_error("Expecting a square octahedral map in '" + level_file + "'.");
+		}
+		if (levels == 0) base_size = size.x;
+		else if (size.x != (base_size >> levels)) {
+			throw std::runtime_error("Octahedral map level '" + level_file + "' is " + std::to_string(size.x) + " wide; expecting " + std::to_string(base_size >> levels) + ".");
+		}
+		std::vector< glm::vec3 > float_data(data.size());
+		rgbe_to_float_n(data.data(), data.size(), float_data.data());
+		glTexImage2D(GL_TEXTURE_2D, levels, GL_RGB9_E5, size.x, size.y, 0, GL_RGB, GL_FLOAT, float_data.data());
+		++levels;
+	}
+	bool prefiltered = (levels > 1);
+	if (prefiltered && (base_size >> levels) > 0) {
+		throw std::runtime_error("Octahedral map '" + filename + "' has only " + std::to_string(levels) + " pre-filtered levels; expecting a full chain.");
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (!prefiltered) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GL_ERRORS();
+
+	return tex;
+}
+
 Load< GLuint > sky_cube(LoadTagDefault, [](){
-	return new GLuint(load_cube(data_path("cape_hill_512.png")));
+	return new GLuint(load_cube(data_path("cape_hill_512.bc6")));
 });
 
 Load< GLuint > diffuse_cube(LoadTagDefault, [](){
-	return new GLuint(load_cube(data_path("cape_hill_diffuse.png")));
+	return new GLuint(load_cube(data_path("cape_hill_diffuse.e5")));
+});
+
+Load< GLuint > sky_oct(LoadTagDefault, [](){
+	return new GLuint(load_oct(data_path("cape_hill_oct.png")));
+});
+
+Load< GLuint > diffuse_oct(LoadTagDefault, [](){
+	return new GLuint(load_oct(data_path("cape_hill_diffuse_oct.png")));
 });
 
 MeshBuffer::Mesh const *ship_rocket = nullptr;
@@ -90,8 +235,12 @@ Load< GLuint > ship_meshes_for_cube_reflect_program(LoadTagDefault, [](){
 	return new GLuint(ship_meshes->make_vao_for_program(cube_reflect_program->program));
 });
 
+Load< GLuint > ship_meshes_for_oct_reflect_program(LoadTagDefault, [](){
+	return new GLuint(ship_meshes->make_vao_for_program(oct_reflect_program->program));
+});
+
 uint32_t cube_mesh_count = 0;
-Load< GLuint > cube_mesh_for_cube_program(LoadTagDefault, [](){
+Load< GLuint > cube_mesh_buffer(LoadTagDefault, [](){
 	//mesh for showing cube map texture:
 	glm::vec3 v0(-1.0f,-1.0f,-1.0f);
 	glm::vec3 v1(+1.0f,-1.0f,-1.0f);
@@ -120,7 +269,11 @@ Load< GLuint > cube_mesh_for_cube_program(LoadTagDefault, [](){
 	glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(glm::vec3), verts.data(), GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	//create vertex array object describing layout (position is used as texture coordinate):
+	return new GLuint(vbo);
+});
+
+//create vertex array object describing layout of cube mesh (position is used as texture coordinate):
+static GLuint make_cube_mesh_vao(GLuint program, char const *program_name) {
 	auto Position = MeshBuffer::Attrib(3, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(glm::vec3), 0);
 	auto TexCoord = MeshBuffer::Attrib(3, GL_FLOAT, MeshBuffer::Attrib::AsFloat, sizeof(glm::vec3), 0);
 
@@ -128,9 +281,63 @@ Load< GLuint > cube_mesh_for_cube_program(LoadTagDefault, [](){
 	attribs.emplace_back("Position", Position);
 	attribs.emplace_back("TexCoord", TexCoord);
 
-	return new GLuint(make_vao_for_program(vbo, attribs.begin(), attribs.end(), cube_program->program, "cube_program"));
+	return make_vao_for_program(*cube_mesh_buffer, attribs.begin(), attribs.end(), program, program_name);
+}
+
+Load< GLuint > cube_mesh_for_cube_program(LoadTagDefault, [](){
+	return new GLuint(make_cube_mesh_vao(cube_program->program, "cube_program"));
 });
 
+Load< GLuint > cube_mesh_for_oct_program(LoadTagDefault, [](){
+	return new GLuint(make_cube_mesh_vao(oct_program->program, "oct_program"));
+});
+
+//upload level 0 of a (floating point) cube as an RGB9_E5 cubemap texture, with generated mipmaps:
+static GLuint upload_cube_image(CubeImage const &cube) {
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
+	for (uint32_t f = 0; f < 6; ++f) {
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_RGB9_E5, cube.size, cube.size, 0, GL_RGB, GL_FLOAT, cube.levels[0].data() + f*cube.size*cube.size);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	GL_ERRORS();
+
+	return tex;
+}
+
+//filters 'R' cycles through (all the same size as cape_hill_diffuse):
+static std::vector< std::pair< char const *, FilterJob > > const &refilter_jobs() {
+	static std::vector< std::pair< char const *, FilterJob > > jobs = [](){
+		std::vector< std::pair< char const *, FilterJob > > ret;
+		FilterJob job;
+		job.size = 16;
+		job.kind = FilterJob::SH; job.sh_bands = 3;
+		ret.emplace_back("sh9", job);
+		job.kind = FilterJob::Bokeh; job.samples = {200};
+		ret.emplace_back("bokeh 200", job);
+		job.kind = FilterJob::Diffuse; job.samples = {16};
+		ret.emplace_back("diffuse 16", job);
+		job.kind = FilterJob::Diffuse; job.samples = {200};
+		ret.emplace_back("diffuse 200", job);
+		return ret;
+	}();
+	return jobs;
+}
+
+struct ShowCubeMode::Refilter {
+	//leave a core for the thread that draws (the background task itself is one of the pool's threads):
+	ThreadPool pool{std::max(2U, std::thread::hardware_concurrency()) - 1};
+	CubeImage sky; //loaded by the first refilter
+	std::unique_ptr< FilterSource > source; //built by the first refilter; shares blur inputs between later ones
+};
 
 ShowCubeMode::ShowCubeMode() {
 	//build a basic scene:
@@ -155,6 +362,7 @@ ShowCubeMode::ShowCubeMode() {
 		info.vao = *ship_meshes_for_cube_diffuse_program;
 		info.start = ship_rocket->start;
 		info.count = ship_rocket->count;
+		info.index_type = ship_rocket->index_type;
 		info.mvp_mat4 = cube_diffuse_program->object_to_clip_mat4;
 		info.itmv_mat3 = cube_diffuse_program->normal_to_light_mat3;
 		info.textures[0] = *diffuse_cube;
@@ -172,6 +380,7 @@ ShowCubeMode::ShowCubeMode() {
 		info.vao = *ship_meshes_for_cube_reflect_program;
 		info.start = ship_rocket->start;
 		info.count = ship_rocket->count;
+		info.index_type = ship_rocket->index_type;
 		info.mvp_mat4 = cube_reflect_program->object_to_clip_mat4;
 		info.mv_mat4x3 = cube_reflect_program->object_to_light_mat4x3;
 		info.itmv_mat3 = cube_reflect_program->normal_to_light_mat3;
@@ -183,6 +392,25 @@ ShowCubeMode::ShowCubeMode() {
 		Scene::Object *object = scene.new_object(transform);
 		object->programs[Scene::Object::ProgramTypeDefault] = info;
 		transform->position = glm::vec3(-4.0f, 0.0f, 0.0f);
+		mirror = object;
+		mirror_cube_info = info;
+	}
+
+	{ //the same rocket, lit by octahedral maps (swapped in by 'O'):
+		Scene::Object::ProgramInfo info;
+		info.program = oct_reflect_program->program;
+		info.vao = *ship_meshes_for_oct_reflect_program;
+		info.start = ship_rocket->start;
+		info.count = ship_rocket->count;
+		info.index_type = ship_rocket->index_type;
+		info.mvp_mat4 = oct_reflect_program->object_to_clip_mat4;
+		info.mv_mat4x3 = oct_reflect_program->object_to_light_mat4x3;
+		info.itmv_mat3 = oct_reflect_program->normal_to_light_mat3;
+		info.textures[0] = *diffuse_oct;
+		info.texture_targets[0] = GL_TEXTURE_2D;
+		info.textures[1] = *sky_oct;
+		info.texture_targets[1] = GL_TEXTURE_2D;
+		mirror_oct_info = info;
 	}
 
 
@@ -196,6 +424,9 @@ ShowCubeMode::ShowCubeMode() {
 }
 
 ShowCubeMode::~ShowCubeMode() {
+	//(the background task holds its own reference to 'refilter', but its result is dropped here)
+	if (refilter_result.valid()) refilter_result.wait();
+	if (refiltered_diffuse != 0) glDeleteTextures(1, &refiltered_diffuse);
 }
 
 bool ShowCubeMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
@@ -209,6 +440,28 @@ bool ShowCubeMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_s
 		paused = !paused;
 	}
 
+	if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_O) {
+		octahedral = !octahedral;
+		mirror->programs[Scene::Object::ProgramTypeDefault] = (octahedral ? mirror_oct_info : mirror_cube_info);
+	}
+
+	if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_R && !refilter_result.valid()) {
+		if (!refilter) refilter = std::make_shared< Refilter >();
+		auto const &job = refilter_jobs()[refilter_index];
+		refilter_index = (refilter_index + 1) % uint32_t(refilter_jobs().size());
+		std::cout << "Refiltering diffuse lighting (" << job.first << ") in the background..." << std::endl;
+		std::shared_ptr< Refilter > state = refilter;
+		FilterJob filter = job.second;
+		refilter_result = std::async(std::launch::async, [state, filter]() {
+			if (!state->source) {
+				state->sky = load_cube_image(data_path("cape_hill_512.e5"));
+				state->sky.levels.resize(1);
+				state->source.reset(new FilterSource(state->sky));
+			}
+			return filter_cube(*state->source, filter, &state->pool);
+		});
+	}
+
 	if (evt.type == SDL_MOUSEBUTTONDOWN) {
 		if (!mouse_captured) {
 			SDL_SetRelativeMouseMode(SDL_TRUE);
@@ -247,6 +500,22 @@ bool ShowCubeMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_s
 }
 
 void ShowCubeMode::update(float elapsed) {
+	if (refilter_result.valid() && refilter_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		//swap the new diffuse lighting in for the old (the original, loaded one is left alone):
+		try {
+			FilterResult result = refilter_result.get();
+			GLuint tex = upload_cube_image(result.cube);
+			rocket->programs[Scene::Object::ProgramTypeDefault].textures[0] = tex;
+			mirror_cube_info.textures[0] = tex;
+			if (!octahedral) mirror->programs[Scene::Object::ProgramTypeDefault] = mirror_cube_info;
+			if (refiltered_diffuse != 0) glDeleteTextures(1, &refiltered_diffuse);
+			refiltered_diffuse = tex;
+			std::cout << "Refiltered diffuse lighting is in." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "Refiltering failed: " << e.what() << std::endl;
+		}
+	}
+
 	float ce = std::cos(camera_elevation);
 	float se = std::sin(camera_elevation);
 	float ca = std::cos(camera_azimuth);
@@ -285,9 +554,10 @@ void ShowCubeMode::draw(glm::uvec2 const &drawable_size) {
 		glDisable(GL_CULL_FACE);
 		glCullFace(GL_BACK);
 
-		glUseProgram(cube_program->program);
+		glUseProgram(octahedral ? oct_program->program : cube_program->program);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, *sky_cube);
+		if (octahedral) glBindTexture(GL_TEXTURE_2D, *sky_oct);
+		else glBindTexture(GL_TEXTURE_CUBE_MAP, *sky_cube);
 
 		//make a matrix that acts as if the camera is at the origin:
 		glm::mat4 world_to_camera = camera->transform->make_world_to_local();
@@ -295,13 +565,13 @@ void ShowCubeMode::draw(glm::uvec2 const &drawable_size) {
 		glm::mat4 world_to_clip = camera->make_projection() * world_to_camera;
 		glm::mat4 object_to_clip = world_to_clip;
 
-		glUniformMatrix4fv(cube_program->object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+		glUniformMatrix4fv(octahedral ? oct_program->object_to_clip_mat4 : cube_program->object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
 
-		glBindVertexArray(*cube_mesh_for_cube_program);
+		glBindVertexArray(octahedral ? *cube_mesh_for_oct_program : *cube_mesh_for_cube_program);
 
 		glDrawArrays(GL_TRIANGLES, 0, cube_mesh_count);
 
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		glBindTexture(octahedral ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP, 0);
 
 		//reset state:
 		glEnable(GL_DEPTH_TEST);
@@ -311,6 +581,8 @@ void ShowCubeMode::draw(glm::uvec2 const &drawable_size) {
 
 	glUseProgram(cube_reflect_program->program);
 	glUniform3fv(cube_reflect_program->eye_vec3, 1, glm::value_ptr(glm::vec3(camera->transform->make_local_to_world()[3])));
+	glUseProgram(oct_reflect_program->program);
+	glUniform3fv(oct_reflect_program->eye_vec3, 1, glm::value_ptr(glm::vec3(camera->transform->make_local_to_world()[3])));
 
 
 	//Note: no light positions to set up, yay!
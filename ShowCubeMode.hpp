@@ -4,6 +4,7 @@
 
 #include "MeshBuffer.hpp"
 #include "Scene.hpp"
+#include "cubes/ibl.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -11,6 +12,8 @@
 
 #include <vector>
 #include <list>
+#include <memory>
+#include <future>
 
 // The 'ShowCubeMode' loads and shows a HDR cube-map:
 
@@ -25,12 +28,22 @@ struct ShowCubeMode : public Mode {
 	//controls:
 	bool mouse_captured = false;
 	bool paused = true;
+	bool octahedral = false; //draw sky and mirror rocket from octahedral maps instead of cube maps ('O' toggles)
+
+	//refiltering ('R' recomputes the diffuse lighting with the next of a few filters, on a background thread, while drawing continues):
+	struct Refilter; //the sky being filtered and a pool to filter it on (shared with the background task)
+	std::shared_ptr< Refilter > refilter;
+	std::future< FilterResult > refilter_result; //valid while a refilter is running
+	uint32_t refilter_index = 0; //next filter to run
+	GLuint refiltered_diffuse = 0; //texture holding the last finished refilter (if any)
 
 	//scene:
 	Scene scene;
 	Scene::Camera *camera = nullptr;
 	Scene::Object *cube = nullptr;
 	Scene::Object *rocket = nullptr;
+	Scene::Object *mirror = nullptr;
+	Scene::Object::ProgramInfo mirror_cube_info, mirror_oct_info;
 
 	glm::vec3 camera_center = glm::vec3(0.0f);
 	float camera_radius = 10.0f;
@@ -6,18 +6,16 @@
 #include <fstream>
 
 TransformAnimation::TransformAnimation(std::string const &filename) {
-	std::ifstream file(filename, std::ios::binary);
+	MappedChunks file(filename);
 
-	std::vector< char > strings_data;
-	read_chunk(file, "str0", &strings_data);
+	ChunkSpan< char > strings_data = file.find< char >("str0");
 
 	struct IndexEntry {
 		uint32_t begin;
 		uint32_t end;
 	};
 
-	std::vector< IndexEntry > index_data;
-	read_chunk(file, "idx0", &index_data);
+	ChunkSpan< IndexEntry > index_data = file.find< IndexEntry >("idx0");
 
 	//build names from index:
 	names.reserve(index_data.size());
@@ -28,8 +26,11 @@ TransformAnimation::TransformAnimation(std::string const &filename) {
 		names.emplace_back(strings_data.data() + e.begin, strings_data.data() + e.end);
 	}
 
-	//frames_data gets read directly into this->frames_data:
-	read_chunk(file, "xff0", &frames_data);
+	//frames_data gets copied from the file into this->frames_data:
+	{
+		ChunkSpan< TRS > file_frames_data = file.find< TRS >("xff0");
+		frames_data.assign(file_frames_data.begin(), file_frames_data.end());
+	}
 
 	if (frames_data.size() % names.size() != 0) {
 		throw std::runtime_error("xff0 chunk in '" + filename + "' contains a partial frame.");
@@ -40,6 +41,10 @@ TransformAnimation::TransformAnimation(std::string const &filename) {
 	if (frames == 0) {
 		throw std::runtime_error("Animation in '" + filename + "' contains zero frames.");
 	}
+
+	if (file.realigned_bytes > 0) {
+		std::cerr << "WARNING: copied " << file.realigned_bytes << " bytes of misaligned chunk data from animation file '" << filename << "' (re-export it to pad its chunks)" << std::endl;
+	}
 }
 
 TransformAnimationPlayer::TransformAnimationPlayer(TransformAnimation const &animation_, std::vector< Scene::Transform * > const &transforms_, float speed) : animation(animation_), transforms(transforms_) {
@@ -216,19 +216,15 @@ void WalkMesh::walk(WalkMesh::WalkPoint &wp, glm::vec3 const &step) const {
 
 
 WalkMeshes::WalkMeshes(std::string const &filename) {
-	std::ifstream file(filename, std::ios::binary);
+	MappedChunks file(filename);
 
-	std::vector< glm::vec3 > vertices;
-	read_chunk(file, "p...", &vertices);
+	ChunkSpan< glm::vec3 > vertices = file.find< glm::vec3 >("p...");
 
-	std::vector< glm::vec3 > normals;
-	read_chunk(file, "n...", &normals);
+	ChunkSpan< glm::vec3 > normals = file.find< glm::vec3 >("n...");
 
-	std::vector< glm::uvec3 > triangles;
-	read_chunk(file, "tri0", &triangles);
+	ChunkSpan< glm::uvec3 > triangles = file.find< glm::uvec3 >("tri0");
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	ChunkSpan< char > names = file.find< char >("str0");
 
 	struct IndexEntry {
 		uint32_t name_begin, name_end;
@@ -236,11 +232,13 @@ WalkMeshes::WalkMeshes(std::string const &filename) {
 		uint32_t triangle_begin, triangle_end;
 	};
 
-	std::vector< IndexEntry > index;
-	read_chunk(file, "idxA", &index);
+	ChunkSpan< IndexEntry > index = file.find< IndexEntry >("idxA");
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in walkmesh file '" << filename << "'" << std::endl;
+	for (auto const &magic : file.unread()) {
+		std::cerr << "WARNING: unused chunk '" << magic << "' in walkmesh file '" << filename << "'" << std::endl;
+	}
+	if (file.realigned_bytes > 0) {
+		std::cerr << "WARNING: copied " << file.realigned_bytes << " bytes of misaligned chunk data from walkmesh file '" << filename << "' (re-export it to pad its chunks)" << std::endl;
 	}
 
 	//-----------------
@@ -0,0 +1,390 @@
+#include "bc6h.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+
+//with reference to the BPTC format description in the OpenGL 4.4 specification (appendix C)
+// and the BC6H format page of the Direct3D 11 documentation.
+
+namespace {
+
+//bits of an unsigned half float, rounded to nearest (negatives and NaN go to zero; overflow to the largest finite half):
+uint16_t float_to_half_u(float f) {
+	if (!(f > 0.0f)) return 0;
+	if (f >= 65504.0f) return 0x7bff;
+	uint32_t bits;
+	std::memcpy(&bits, &f, 4);
+	int32_t exp = int32_t((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = bits & 0x7fffff;
+	if (exp <= 0) {
+		//denormal (or zero):
+		if (exp < -10) return 0;
+		mant |= 0x800000;
+		uint32_t shift = uint32_t(14 - exp);
+		uint32_t half = mant >> shift;
+		if ((mant >> (shift - 1)) & 1) half += 1;
+		return uint16_t(half);
+	}
+	uint32_t half = (uint32_t(exp) << 10) | (mant >> 13);
+	if (mant & 0x1000) half += 1; //round (carry into exponent is fine)
+	return uint16_t(std::min(half, 0x7bffU));
+}
+
+float half_to_float(uint16_t h) {
+	uint32_t exp = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+	if (exp == 0) return std::ldexp(float(mant), -24);
+	return std::ldexp(float(mant | 0x400), int32_t(exp) - 25);
+}
+
+//the one-region modes:
+struct Mode {
+	uint32_t value; //5-bit mode field
+	uint32_t endpoint_bits; //precision of endpoint 0 (and of endpoint 1, when not transformed)
+	uint32_t delta_bits; //bits stored for endpoint 1
+	bool transformed; //endpoint 1 is stored as a signed delta from endpoint 0
+};
+constexpr Mode Modes[4] = {
+	{0x03, 10, 10, false},
+	{0x07, 11, 9, true},
+	{0x0b, 12, 8, true},
+	{0x0f, 16, 4, true},
+};
+
+//interpolation weights for 4-bit indices:
+constexpr int32_t Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+//endpoint bits after the mode field are (per mode):
+//  w.r[9:0], w.g[9:0], w.b[9:0],
+//  then, per channel: x[delta_bits-1:0], w[endpoint_bits-1:10] (high bits of w, in descending order)
+//and 63 index bits follow (3 for texel 0, whose top bit is implied zero, then 4 for each other texel).
+
+int32_t unquantize(int32_t q, uint32_t bits) {
+	if (bits >= 15) return q;
+	if (q == 0) return 0;
+	if (q == (1 << bits) - 1) return 0xffff;
+	return ((q << 16) + 0x8000) >> bits;
+}
+
+//half bits for interpolant k between unquantized endpoints a and b:
+int32_t interpolate(int32_t a, int32_t b, uint32_t k) {
+	int32_t v = (a * (64 - Weights[k]) + b * Weights[k] + 32) >> 6;
+	return (v * 31) >> 6;
+}
+
+//quantized value whose unquantized form is closest to 'u' (in [0,65535]):
+int32_t quantize(float u, uint32_t bits) {
+	int32_t max = (1 << bits) - 1;
+	u = std::max(0.0f, std::min(65535.0f, u));
+	int32_t q = std::max(0, std::min(max, int32_t(u * float(1 << bits) / 65536.0f)));
+	int32_t best = q;
+	float best_err = std::abs(float(unquantize(q, bits)) - u);
+	for (int32_t c : {q - 1, q + 1}) {
+		if (c < 0 || c > max) continue;
+		float err = std::abs(float(unquantize(c, bits)) - u);
+		if (err < best_err) {
+			best_err = err;
+			best = c;
+		}
+	}
+	return best;
+}
+
+struct BitWriter {
+	uint8_t *block;
+	uint32_t at = 0;
+	explicit BitWriter(uint8_t *block_) : block(block_) {
+		std::memset(block, 0, 16);
+	}
+	void write(uint32_t value, uint32_t bits) {
+		for (uint32_t i = 0; i < bits; ++i, ++at) {
+			block[at / 8] |= uint8_t(((value >> i) & 1) << (at % 8));
+		}
+	}
+};
+
+struct BitReader {
+	uint8_t const *block;
+	uint32_t at = 0;
+	explicit BitReader(uint8_t const *block_) : block(block_) { }
+	uint32_t read(uint32_t bits) {
+		uint32_t ret = 0;
+		for (uint32_t i = 0; i < bits; ++i, ++at) {
+			ret |= uint32_t((block[at / 8] >> (at % 8)) & 1) << i;
+		}
+		return ret;
+	}
+};
+
+//a candidate encoding (quantized endpoints as stored, plus indices) and its error:
+struct Candidate {
+	Mode const *mode = nullptr;
+	int32_t w[3] = {0, 0, 0}; //endpoint 0
+	int32_t x[3] = {0, 0, 0}; //endpoint 1 (or its delta, when transformed)
+	uint8_t indices[16];
+	float error = std::numeric_limits< float >::infinity();
+};
+
+//quantize endpoints (given as half bits) for 'mode', choose indices, and measure error against 'target' (also half bits):
+Candidate fit(Mode const &mode, glm::vec3 e0, glm::vec3 e1, glm::vec3 const *target) {
+	Candidate ret;
+	ret.mode = &mode;
+	int32_t q0[3], q1[3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		//unquantized values are scaled by 31/64 on the way out (and truncated), so aim a bit high:
+		q0[c] = quantize((std::max(0.0f, std::min(float(0x7bff), e0[c])) + 0.5f) * (64.0f / 31.0f), mode.endpoint_bits);
+		q1[c] = quantize((std::max(0.0f, std::min(float(0x7bff), e1[c])) + 0.5f) * (64.0f / 31.0f), mode.endpoint_bits);
+	}
+	int32_t delta_min = -(1 << (mode.delta_bits - 1));
+	int32_t delta_max = (1 << (mode.delta_bits - 1)) - 1;
+	if (mode.transformed) {
+		//endpoint 1 must be within delta range of endpoint 0:
+		for (uint32_t c = 0; c < 3; ++c) {
+			q1[c] = q0[c] + std::max(delta_min, std::min(delta_max, q1[c] - q0[c]));
+		}
+	}
+
+	int32_t palette[16][3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		int32_t a = unquantize(q0[c], mode.endpoint_bits);
+		int32_t b = unquantize(q1[c], mode.endpoint_bits);
+		for (uint32_t k = 0; k < 16; ++k) {
+			palette[k][c] = interpolate(a, b, k);
+		}
+	}
+
+	ret.error = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i) {
+		float best = std::numeric_limits< float >::infinity();
+		for (uint32_t k = 0; k < 16; ++k) {
+			float err = 0.0f;
+			for (uint32_t c = 0; c < 3; ++c) {
+				float d = float(palette[k][c]) - target[i][c];
+				err += d * d;
+			}
+			if (err < best) {
+				best = err;
+				ret.indices[i] = uint8_t(k);
+			}
+		}
+		ret.error += best;
+	}
+
+	//texel 0's index must have its top bit clear; swapping endpoints (and flipping indices) keeps the same palette:
+	if (ret.indices[0] >= 8) {
+		std::swap(q0, q1);
+		for (auto &i : ret.indices) i = uint8_t(15 - i);
+		if (mode.transformed) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				int32_t d = q1[c] - q0[c];
+				if (d < delta_min || d > delta_max) {
+					ret.error = std::numeric_limits< float >::infinity();
+					return ret;
+				}
+			}
+		}
+	}
+
+	for (uint32_t c = 0; c < 3; ++c) {
+		ret.w[c] = q0[c];
+		ret.x[c] = (mode.transformed ? q1[c] - q0[c] : q1[c]);
+	}
+	return ret;
+}
+
+void pack(Candidate const &cand, uint8_t *block) {
+	Mode const &mode = *cand.mode;
+	BitWriter out(block);
+	out.write(mode.value, 5);
+	for (uint32_t c = 0; c < 3; ++c) {
+		out.write(uint32_t(cand.w[c]) & 0x3ff, 10);
+	}
+	for (uint32_t c = 0; c < 3; ++c) {
+		out.write(uint32_t(cand.x[c]) & ((1U << mode.delta_bits) - 1), mode.delta_bits);
+		for (uint32_t b = mode.endpoint_bits; b > 10; --b) {
+			out.write((uint32_t(cand.w[c]) >> (b - 1)) & 1, 1);
+		}
+	}
+	assert(out.at == 65);
+	out.write(cand.indices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i) {
+		out.write(cand.indices[i], 4);
+	}
+	assert(out.at == 128);
+}
+
+//endpoints (in half bits) from the extent of the texels along their principal axis:
+void principal_endpoints(glm::vec3 const *target, glm::vec3 *e0, glm::vec3 *e1) {
+	glm::vec3 mean = glm::vec3(0.0f);
+	for (uint32_t i = 0; i < 16; ++i) mean += target[i];
+	mean *= 1.0f / 16.0f;
+
+	float cov[3][3] = {{0.0f}};
+	for (uint32_t i = 0; i < 16; ++i) {
+		glm::vec3 d = target[i] - mean;
+		for (uint32_t r = 0; r < 3; ++r) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				cov[r][c] += d[r] * d[c];
+			}
+		}
+	}
+	glm::vec3 axis = glm::vec3(1.0f);
+	for (uint32_t iter = 0; iter < 8; ++iter) {
+		glm::vec3 next;
+		for (uint32_t r = 0; r < 3; ++r) {
+			next[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] + cov[r][2] * axis[2];
+		}
+		float len = glm::length(next);
+		if (!(len > 1e-20f)) break;
+		axis = next / len;
+	}
+	axis = glm::normalize(axis);
+
+	float lo = std::numeric_limits< float >::infinity();
+	float hi = -std::numeric_limits< float >::infinity();
+	for (uint32_t i = 0; i < 16; ++i) {
+		float t = glm::dot(target[i] - mean, axis);
+		lo = std::min(lo, t);
+		hi = std::max(hi, t);
+	}
+	*e0 = mean + lo * axis;
+	*e1 = mean + hi * axis;
+	//put endpoint 0 near texel 0, so its index (usually) fits in three bits:
+	if (glm::dot(target[0] - mean, axis) > 0.5f * (lo + hi)) std::swap(*e0, *e1);
+}
+
+//endpoints (in half bits) minimizing squared error for the given indices:
+bool refine_endpoints(glm::vec3 const *target, uint8_t const *indices, glm::vec3 *e0, glm::vec3 *e1) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	glm::vec3 at = glm::vec3(0.0f), bt = glm::vec3(0.0f);
+	for (uint32_t i = 0; i < 16; ++i) {
+		float beta = Weights[indices[i]] / 64.0f;
+		float alpha = 1.0f - beta;
+		aa += alpha * alpha;
+		ab += alpha * beta;
+		bb += beta * beta;
+		at += alpha * target[i];
+		bt += beta * target[i];
+	}
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f) return false;
+	*e0 = (bb * at - ab * bt) / det;
+	*e1 = (aa * bt - ab * at) / det;
+	return true;
+}
+
+} //namespace
+
+void encode_bc6h_block(glm::vec3 const *texels, BC6HPreset preset, uint8_t *block) {
+	//BC6H interpolates half float bit patterns, so fit (and measure error) in that space:
+	glm::vec3 target[16];
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			target[i][c] = float(float_to_half_u(texels[i][c]));
+		}
+	}
+
+	glm::vec3 e0, e1;
+	principal_endpoints(target, &e0, &e1);
+
+	Candidate best = fit(Modes[0], e0, e1, target);
+	if (preset == BC6HQuality) {
+		for (Mode const &mode : Modes) {
+			Candidate cand = fit(mode, e0, e1, target);
+			for (uint32_t iter = 0; iter < 3 && cand.error < std::numeric_limits< float >::infinity(); ++iter) {
+				glm::vec3 r0, r1;
+				if (!refine_endpoints(target, cand.indices, &r0, &r1)) break;
+				Candidate next = fit(mode, r0, r1, target);
+				if (!(next.error < cand.error)) break;
+				cand = next;
+			}
+			if (cand.error < best.error) best = cand;
+		}
+	}
+	if (!(best.error < std::numeric_limits< float >::infinity())) {
+		//only possible if a delta mode's endpoints could not be swapped; mode 11 always can:
+		best = fit(Modes[0], e0, e1, target);
+	}
+	pack(best, block);
+}
+
+void decode_bc6h_block(uint8_t const *block, glm::vec3 *texels) {
+	BitReader in(block);
+	uint32_t value = in.read(2);
+	if (value >= 2) value |= in.read(3) << 2;
+	Mode const *mode = nullptr;
+	for (Mode const &m : Modes) {
+		if (m.value == value) mode = &m;
+	}
+	if (!mode) {
+		for (uint32_t i = 0; i < 16; ++i) texels[i] = glm::vec3(0.0f);
+		return;
+	}
+
+	int32_t w[3], x[3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		w[c] = int32_t(in.read(10));
+	}
+	for (uint32_t c = 0; c < 3; ++c) {
+		x[c] = int32_t(in.read(mode->delta_bits));
+		for (uint32_t b = mode->endpoint_bits; b > 10; --b) {
+			w[c] |= int32_t(in.read(1)) << (b - 1);
+		}
+	}
+
+	int32_t a[3], b[3];
+	int32_t mask = (1 << mode->endpoint_bits) - 1;
+	for (uint32_t c = 0; c < 3; ++c) {
+		int32_t e1 = x[c];
+		if (mode->transformed) {
+			//sign-extend the delta, then wrap to endpoint precision:
+			if (e1 & (1 << (mode->delta_bits - 1))) e1 -= (1 << mode->delta_bits);
+			e1 = (w[c] + e1) & mask;
+		}
+		a[c] = unquantize(w[c], mode->endpoint_bits);
+		b[c] = unquantize(e1, mode->endpoint_bits);
+	}
+
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t k = in.read(i == 0 ? 3 : 4);
+		for (uint32_t c = 0; c < 3; ++c) {
+			texels[i][c] = half_to_float(uint16_t(interpolate(a[c], b[c], k)));
+		}
+	}
+}
+
+size_t bc6h_image_bytes(glm::uvec2 size) {
+	return size_t((size.x + 3) / 4) * size_t((size.y + 3) / 4) * 16;
+}
+
+void encode_bc6h_row(glm::uvec2 size, glm::vec3 const *image, uint32_t row, BC6HPreset preset, uint8_t *blocks) {
+	uint32_t blocks_x = (size.x + 3) / 4;
+	for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+		glm::vec3 texels[16];
+		for (uint32_t i = 0; i < 16; ++i) {
+			uint32_t x = std::min(4 * bx + (i % 4), size.x - 1);
+			uint32_t y = std::min(4 * row + (i / 4), size.y - 1);
+			texels[i] = image[y * size.x + x];
+		}
+		encode_bc6h_block(texels, preset, blocks + (size_t(row) * blocks_x + bx) * 16);
+	}
+}
+
+void decode_bc6h_image(glm::uvec2 size, uint8_t const *blocks, glm::vec3 *image) {
+	uint32_t blocks_x = (size.x + 3) / 4;
+	uint32_t blocks_y = (size.y + 3) / 4;
+	for (uint32_t by = 0; by < blocks_y; ++by) {
+		for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+			glm::vec3 texels[16];
+			decode_bc6h_block(blocks + (size_t(by) * blocks_x + bx) * 16, texels);
+			for (uint32_t i = 0; i < 16; ++i) {
+				uint32_t x = 4 * bx + (i % 4);
+				uint32_t y = 4 * by + (i / 4);
+				if (x < size.x && y < size.y) image[y * size.x + x] = texels[i];
+			}
+		}
+	}
+}
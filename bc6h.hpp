@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <stdint.h>
+
+//BC6H (GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT) block compression for HDR textures:
+// each 16-byte block holds 4x4 texels; texel i of a block is at column (i % 4), row (i / 4),
+// with rows in the same order as the image rows they came from.
+//
+//The encoder only emits the one-region modes (11-14 in the D3D numbering: 10-bit endpoints,
+// or an 11/12/16-bit base with 9/8/4-bit deltas) with 4-bit indices; the decoder reads those same modes.
+// (sky cubes are smooth almost everywhere, so the two-region modes would rarely win)
+
+enum BC6HPreset {
+	BC6HFast, //one mode (10-bit endpoints), endpoints from the principal axis
+	BC6HQuality, //all one-region modes, endpoints refined by least squares
+};
+
+//encode 16 texels (negative values clamp to zero, large values to the largest half float):
+void encode_bc6h_block(glm::vec3 const *texels, BC6HPreset preset, uint8_t *block);
+
+//decode a block written by encode_bc6h_block into 16 texels:
+// (blocks in other modes decode to zero, as reserved modes do on the GPU)
+void decode_bc6h_block(uint8_t const *block, glm::vec3 *texels);
+
+//whole images (width x height texels, rows in order) are ceil(width/4) x ceil(height/4) blocks, stored row by row;
+// partial blocks at the right and top edges repeat the last column / row of texels.
+size_t bc6h_image_bytes(glm::uvec2 size);
+
+//encode one row of blocks (so callers can spread rows over threads); 'blocks' points at the whole image's blocks:
+void encode_bc6h_row(glm::uvec2 size, glm::vec3 const *image, uint32_t row, BC6HPreset preset, uint8_t *blocks);
+
+void decode_bc6h_image(glm::uvec2 size, uint8_t const *blocks, glm::vec3 *image);
@@ -0,0 +1,107 @@
+#include "cube_bc6h.hpp"
+#include "bc6h.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	struct CubeHeader {
+		uint32_t size = 0;
+		uint32_t levels = 0;
+	};
+	static_assert(sizeof(CubeHeader) == 8, "header is packed");
+}
+
+CubeBC6HFile::CubeBC6HFile(std::string const &filename) : file(filename) {
+	uint8_t const *at = file.data;
+	uint8_t const *end = file.data + file.size;
+
+	auto read_header = [&](char const *magic) -> ChunkHeader {
+		ChunkHeader header;
+		if (size_t(end - at) < sizeof(header)) {
+			throw std::runtime_error("Cube file '" + filename + "' is truncated.");
+		}
+		std::memcpy(&header, at, sizeof(header));
+		at += sizeof(header);
+		if (std::string(header.magic, 4) != magic) {
+			throw std::runtime_error("Cube file '" + filename + "' has unexpected magic number (expecting '" + magic + "').");
+		}
+		if (size_t(end - at) < header.size) {
+			throw std::runtime_error("Cube file '" + filename + "' is truncated.");
+		}
+		return header;
+	};
+
+	ChunkHeader header = read_header("b6cb");
+	if (header.size != sizeof(CubeHeader)) {
+		throw std::runtime_error("Cube file '" + filename + "' has an unexpected header size.");
+	}
+	CubeHeader cube;
+	std::memcpy(&cube, at, sizeof(cube));
+	at += header.size;
+	size = cube.size;
+	levels = cube.levels;
+	if (size == 0 || levels == 0 || levels > 32 || (levels > 1 && (size >> (levels - 1)) == 0)) {
+		throw std::runtime_error("Cube file '" + filename + "' has bad size (" + std::to_string(size) + ") or level count (" + std::to_string(levels) + ").");
+	}
+
+	header = read_header("b6bk");
+	size_t expected = 0;
+	for (uint32_t level = 0; level < levels; ++level) {
+		expected += 6 * face_bytes(level);
+	}
+	if (header.size != expected) {
+		throw std::runtime_error("Cube file '" + filename + "' has " + std::to_string(header.size) + " bytes of blocks; expecting " + std::to_string(expected) + ".");
+	}
+	blocks = at;
+}
+
+size_t CubeBC6HFile::face_bytes(uint32_t level) const {
+	return bc6h_image_bytes(glm::uvec2(level_size(level)));
+}
+
+uint8_t const *CubeBC6HFile::level_data(uint32_t level) const {
+	uint8_t const *ret = blocks;
+	for (uint32_t l = 0; l < level; ++l) {
+		ret += 6 * face_bytes(l);
+	}
+	return ret;
+}
+
+void save_cube_bc6h(std::string const &filename, uint32_t size, std::vector< std::vector< uint8_t > > const &levels) {
+	CubeHeader cube;
+	cube.size = size;
+	cube.levels = uint32_t(levels.size());
+
+	size_t total = 0;
+	for (uint32_t level = 0; level < levels.size(); ++level) {
+		uint32_t level_size = std::max(1U, size >> level);
+		if (levels[level].size() != 6 * bc6h_image_bytes(glm::uvec2(level_size))) {
+			throw std::runtime_error("Level " + std::to_string(level) + " of cube for '" + filename + "' has the wrong number of blocks.");
+		}
+		total += levels[level].size();
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	ChunkHeader header;
+	std::memcpy(header.magic, "b6cb", 4);
+	header.size = sizeof(cube);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(reinterpret_cast< char const * >(&cube), sizeof(cube));
+	std::memcpy(header.magic, "b6bk", 4);
+	header.size = uint32_t(total);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	for (auto const &level : levels) {
+		out.write(reinterpret_cast< char const * >(level.data()), level.size());
+	}
+	if (!out) {
+		throw std::runtime_error("Failed to write '" + filename + "'.");
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+//".bc6" files hold a cube map (and, optionally, its mip chain) as BC6H blocks (see bc6h.hpp), ready for
+// glCompressedTexImage2D(..., GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, ...).
+//
+//Like .e5 files (cube_e5.hpp), they are two chunks in the style of read_chunk.hpp:
+// 'b6cb': uint32_t size (of level 0), uint32_t levels
+// 'b6bk': blocks of each level in turn; each level is faces +x,-x,+y,-y,+z,-z,
+//   each face bc6h_image_bytes() of blocks for max(1, size >> level) texels on a side, block rows bottom-to-top.
+
+struct CubeBC6HFile {
+	//maps and checks the file (will throw on error):
+	CubeBC6HFile(std::string const &filename);
+
+	uint32_t size = 0;
+	uint32_t levels = 0;
+
+	//face size, bytes of blocks per face, and first block (of face +x) of a level:
+	uint32_t level_size(uint32_t level) const { return std::max(1U, size >> level); }
+	size_t face_bytes(uint32_t level) const;
+	uint8_t const *level_data(uint32_t level) const;
+
+	//internals:
+	MappedFile file;
+	uint8_t const *blocks = nullptr;
+};
+
+//write blocks for each level (six faces each, as above) as a .bc6 file (will throw on error):
+void save_cube_bc6h(std::string const &filename, uint32_t size, std::vector< std::vector< uint8_t > > const &levels);
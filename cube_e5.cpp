@@ -0,0 +1,117 @@
+#include "cube_e5.hpp"
+#include "rgb9e5.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	struct CubeHeader {
+		uint32_t size = 0;
+		uint32_t levels = 0;
+	};
+	static_assert(sizeof(CubeHeader) == 8, "header is packed");
+
+	size_t level_texels(uint32_t size) {
+		return 6 * size_t(size) * size_t(size);
+	}
+}
+
+CubeE5File::CubeE5File(std::string const &filename) : file(filename) {
+	uint8_t const *at = file.data;
+	uint8_t const *end = file.data + file.size;
+
+	auto read_header = [&](char const *magic) -> ChunkHeader {
+		ChunkHeader header;
+		if (size_t(end - at) < sizeof(header)) {
+			throw std::runtime_error("Cube file '" + filename + "' is truncated.");
+		}
+		std::memcpy(&header, at, sizeof(header));
+		at += sizeof(header);
+		if (std::string(header.magic, 4) != magic) {
+			throw std::runtime_error("Cube file '" + filename + "' has unexpected magic number (expecting '" + magic + "').");
+		}
+		if (size_t(end - at) < header.size) {
+			throw std::runtime_error("Cube file '" + filename + "' is truncated.");
+		}
+		return header;
+	};
+
+	ChunkHeader header = read_header("e5cb");
+	if (header.size != sizeof(CubeHeader)) {
+		throw std::runtime_error("Cube file '" + filename + "' has an unexpected header size.");
+	}
+	CubeHeader cube;
+	std::memcpy(&cube, at, sizeof(cube));
+	at += header.size;
+	size = cube.size;
+	levels = cube.levels;
+	if (size == 0 || levels == 0 || levels > 32 || (levels > 1 && (size >> (levels - 1)) == 0)) {
+		throw std::runtime_error("Cube file '" + filename + "' has bad size (" + std::to_string(size) + ") or level count (" + std::to_string(levels) + ").");
+	}
+
+	header = read_header("e5tx");
+	size_t expected = 0;
+	for (uint32_t level = 0; level < levels; ++level) {
+		expected += level_texels(level_size(level));
+	}
+	if (header.size != expected * 4) {
+		throw std::runtime_error("Cube file '" + filename + "' has " + std::to_string(header.size) + " bytes of texels; expecting " + std::to_string(expected * 4) + ".");
+	}
+	//chunk data starts 24 bytes into the (page-aligned) mapping, so texels are aligned:
+	texels = reinterpret_cast< uint32_t const * >(at);
+}
+
+uint32_t const *CubeE5File::level_data(uint32_t level) const {
+	uint32_t const *ret = texels;
+	for (uint32_t l = 0; l < level; ++l) {
+		ret += level_texels(level_size(l));
+	}
+	return ret;
+}
+
+void save_cube_e5(std::string const &filename, uint32_t size, std::vector< std::vector< glm::vec3 > > const &levels) {
+	std::vector< uint32_t > texels;
+	for (uint32_t level = 0; level < levels.size(); ++level) {
+		uint32_t level_size = std::max(1U, size >> level);
+		if (levels[level].size() != level_texels(level_size)) {
+			throw std::runtime_error("Level " + std::to_string(level) + " of cube for '" + filename + "' has the wrong number of texels.");
+		}
+		for (auto const &px : levels[level]) {
+			texels.emplace_back(float_to_rgb9e5(px));
+		}
+	}
+
+	save_cube_e5_packed(filename, size, uint32_t(levels.size()), texels.data());
+}
+
+void save_cube_e5_packed(std::string const &filename, uint32_t size, uint32_t levels, uint32_t const *texels) {
+	CubeHeader cube;
+	cube.size = size;
+	cube.levels = levels;
+
+	size_t count = 0;
+	for (uint32_t level = 0; level < levels; ++level) {
+		count += level_texels(std::max(1U, size >> level));
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	ChunkHeader header;
+	std::memcpy(header.magic, "e5cb", 4);
+	header.size = sizeof(cube);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(reinterpret_cast< char const * >(&cube), sizeof(cube));
+	std::memcpy(header.magic, "e5tx", 4);
+	header.size = uint32_t(count * 4);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(reinterpret_cast< char const * >(texels), count * 4);
+	if (!out) {
+		throw std::runtime_error("Failed to write '" + filename + "'.");
+	}
+}
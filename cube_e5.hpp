@@ -0,0 +1,41 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+//".e5" files hold a cube map (and, optionally, its mip chain) as texels already packed for
+// glTexImage2D(..., GL_RGB9_E5, ..., GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, ...), so loading is just mapping the file.
+//
+//They are two chunks in the style of read_chunk.hpp (4-byte magic, 4-byte size, data):
+// 'e5cb': uint32_t size (of level 0), uint32_t levels
+// 'e5tx': uint32_t texels (see rgb9e5.hpp) of each level in turn;
+//   each level is faces +x,-x,+y,-y,+z,-z of max(1, size >> level)^2 texels, rows bottom-to-top.
+//(all values are little-endian)
+
+struct CubeE5File {
+	//maps and checks the file (will throw on error):
+	CubeE5File(std::string const &filename);
+
+	uint32_t size = 0;
+	uint32_t levels = 0;
+
+	//face size and first texel (of face +x) of a level:
+	uint32_t level_size(uint32_t level) const { return std::max(1U, size >> level); }
+	uint32_t const *level_data(uint32_t level) const;
+
+	//internals:
+	MappedFile file;
+	uint32_t const *texels = nullptr;
+};
+
+//write a cube (levels[0], faces stacked as above) and any further mip levels as an .e5 file (will throw on error):
+void save_cube_e5(std::string const &filename, uint32_t size, std::vector< std::vector< glm::vec3 > > const &levels);
+
+//same, for texels already packed with float_to_rgb9e5 (all levels, in file order):
+void save_cube_e5_packed(std::string const &filename, uint32_t size, uint32_t levels, uint32_t const *texels);
@@ -50,6 +50,9 @@ CubeReflectProgram::CubeReflectProgram() {
 		//Varying roughness:
 		//"	col = texture(reflect_tex, reflect(-v, n), round(0.5+0.5*sin(5.0*position.z)) * 4.0).rgb;\n"
 
+		//Pre-filtered roughness: (reflect_tex loaded with 'blur_cube ggx' levels, so level = roughness * (levels - 1); 9 levels for a 256 cube)
+		//"	col = textureLod(reflect_tex, reflect(-v, n), 0.5 * 8.0).rgb;\n"
+
 		//partial mirror: (~"clear coat", but probably could use angular dependence)
 		//"	col = 0.5 * color.rgb * light;\n"
 		//"	col += 0.5 * texture(reflect_tex, reflect(-v, n)).rgb;\n"
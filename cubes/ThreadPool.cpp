@@ -0,0 +1,98 @@
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cassert>
+
+ThreadPool::ThreadPool(uint32_t threads) {
+	if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+	for (uint32_t i = 1; i < threads; ++i) {
+		workers.emplace_back([this](){
+			while (true) {
+				std::function< void() > job;
+				{
+					std::unique_lock< std::mutex > lock(jobs_mutex);
+					jobs_cv.wait(lock, [this](){ return quit || !jobs.empty(); });
+					if (jobs.empty()) return; //only reached when quitting
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+				job();
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock< std::mutex > lock(jobs_mutex);
+		quit = true;
+	}
+	jobs_cv.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::enqueue(std::function< void() > const &job) {
+	if (workers.empty()) {
+		job();
+		return;
+	}
+	{
+		std::unique_lock< std::mutex > lock(jobs_mutex);
+		jobs.emplace_back(job);
+	}
+	jobs_cv.notify_one();
+}
+
+void ThreadPool::parallel_for(uint32_t count, std::function< void(uint32_t) > const &body) {
+	if (count == 0) return;
+
+	//shared between the caller and any helper jobs; helpers may outlive this call
+	// (if they get scheduled late), but they never touch 'body' once all indices are claimed:
+	struct State {
+		std::atomic< uint32_t > next{0};
+		std::atomic< uint32_t > finished{0};
+		uint32_t count = 0;
+		std::function< void(uint32_t) > const *body = nullptr;
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared< State >();
+	state->count = count;
+	state->body = &body;
+
+	auto run = [](State &s) {
+		while (true) {
+			uint32_t i = s.next.fetch_add(1);
+			if (i >= s.count) return;
+			try {
+				(*s.body)(i);
+			} catch (...) {
+				std::unique_lock< std::mutex > lock(s.mutex);
+				if (!s.error) s.error = std::current_exception();
+			}
+			if (s.finished.fetch_add(1) + 1 == s.count) {
+				std::unique_lock< std::mutex > lock(s.mutex);
+				s.cv.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = std::min< uint32_t >(uint32_t(workers.size()), count - 1);
+	for (uint32_t h = 0; h < helpers; ++h) {
+		enqueue([state,run](){ run(*state); });
+	}
+
+	run(*state);
+
+	{
+		std::unique_lock< std::mutex > lock(state->mutex);
+		state->cv.wait(lock, [&state](){ return state->finished.load() == state->count; });
+	}
+	if (state->error) std::rethrow_exception(state->error);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+//"ThreadPool" holds a set of worker threads that can be handed jobs.
+// (used by the cube utilities to split per-texel work across cores)
+
+struct ThreadPool {
+	//construct with a total thread count (including the calling thread):
+	// passing 0 will use std::thread::hardware_concurrency()
+	// passing 1 will create no workers, so everything runs on the caller
+	explicit ThreadPool(uint32_t threads = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool &operator=(ThreadPool const &) = delete;
+
+	//total threads that will run jobs (workers + the thread calling parallel_for):
+	uint32_t size() const { return uint32_t(workers.size()) + 1; }
+
+	//queue a job to be run by some worker at some point:
+	// (if there are no workers, the job runs immediately on the caller)
+	void enqueue(std::function< void() > const &job);
+
+	//call body(0) ... body(count-1), spread across all threads, and wait for them to finish:
+	// the calling thread also runs bodies, so it is fine to call this from within a job.
+	void parallel_for(uint32_t count, std::function< void(uint32_t) > const &body);
+
+	//internals:
+	std::vector< std::thread > workers;
+	std::deque< std::function< void() > > jobs;
+	std::mutex jobs_mutex;
+	std::condition_variable jobs_cv;
+	bool quit = false;
+};
@@ -0,0 +1,255 @@
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdlib>
+#include <cstdio>
+#include <stdint.h>
+
+#include <utime.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+//"bake_cached" runs a bake command only if its inputs or parameters have changed since its outputs were last made,
+// according to a manifest of content hashes. (Timestamps alone rebake after any checkout or touch.)
+//
+//Manifest lines are '<key> <output> <output hash>', where key hashes the command's arguments, the bytes of the
+// program that computes the outputs, and the bytes of every input. An output is up to date if its line has the current
+// key and the file still has the recorded hash.
+
+//FNV-1a, 64-bit:
+struct Hash {
+	uint64_t value = 0xcbf29ce484222325ULL;
+	void add(uint8_t const *data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			value = (value ^ data[i]) * 0x100000001b3ULL;
+		}
+	}
+	//length-prefixed, so that ("ab","c") and ("a","bc") differ:
+	void add(std::string const &str) {
+		uint64_t size = str.size();
+		add(reinterpret_cast< uint8_t const * >(&size), sizeof(size));
+		add(reinterpret_cast< uint8_t const * >(str.data()), str.size());
+	}
+	std::string hex() const {
+		std::ostringstream str;
+		str << std::hex << std::setw(16) << std::setfill('0') << value;
+		return str.str();
+	}
+};
+
+//hash of a file's bytes, or "" if it can't be read:
+std::string hash_file(std::string const &filename) {
+	if (!std::ifstream(filename)) return "";
+	try {
+		MappedFile file(filename);
+		Hash hash;
+		hash.add(file.data, file.size);
+		return hash.hex();
+	} catch (std::exception &) {
+		return "";
+	}
+}
+
+//the file whose bytes decide what a command computes: its first '.py' argument (for commands like
+// 'python3 script.py ...' or 'blender --python script.py ...', where the interpreter is just plumbing),
+// otherwise the program itself, found as the shell would find it:
+std::string program_file(std::vector< std::string > const &command) {
+	for (uint32_t i = 1; i < command.size(); ++i) {
+		std::string const &arg = command[i];
+		if (arg.size() > 3 && arg.substr(arg.size() - 3) == ".py" && std::ifstream(arg)) return arg;
+	}
+	std::string const &program = command[0];
+	if (program.find('/') != std::string::npos) return program;
+	char const *path = std::getenv("PATH");
+	std::istringstream dirs(path ? path : "");
+	std::string dir;
+	while (std::getline(dirs, dir, ':')) {
+		std::string candidate = (dir == "" ? "." : dir) + "/" + program;
+		if (access(candidate.c_str(), X_OK) == 0) return candidate;
+	}
+	return program;
+}
+
+//lock 'filename' (creating it if needed) against other bake_cached processes; returns a descriptor to close() to unlock:
+// (the manifest is replaced by rename, so re-check after locking that the locked file is still the one with that name)
+int lock_file(std::string const &filename) {
+	while (true) {
+		int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0) return -1;
+		if (flock(fd, LOCK_EX) != 0) {
+			close(fd);
+			return -1;
+		}
+		struct stat locked, named;
+		if (fstat(fd, &locked) == 0 && stat(filename.c_str(), &named) == 0
+		 && locked.st_dev == named.st_dev && locked.st_ino == named.st_ino) {
+			return fd;
+		}
+		close(fd); //(replaced while we waited; lock the new one)
+	}
+}
+
+//read a manifest as output -> (key, hash):
+std::map< std::string, std::pair< std::string, std::string > > read_manifest(std::string const &manifest_file) {
+	std::map< std::string, std::pair< std::string, std::string > > manifest;
+	std::ifstream in(manifest_file);
+	std::string line;
+	while (std::getline(in, line)) {
+		//(output names may hold spaces, so split at the first and last space)
+		auto first = line.find(' ');
+		auto last = line.rfind(' ');
+		if (first == std::string::npos || first == last) continue;
+		manifest[line.substr(first + 1, last - first - 1)] = std::make_pair(line.substr(0, first), line.substr(last + 1));
+	}
+	return manifest;
+}
+
+//quote a word for the shell (POSIX sh):
+std::string quote(std::string const &word) {
+	std::string ret = "'";
+	for (char c : word) {
+		if (c == '\'') ret += "'\\''";
+		else ret += c;
+	}
+	return ret + "'";
+}
+
+int main(int argc, char **argv) {
+	bool force = false;
+	std::string manifest_file;
+	std::vector< std::string > inputs, outputs, command;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (!command.empty()) {
+			command.emplace_back(arg);
+		} else if (arg == "--force") {
+			force = true;
+		} else if (arg == "--in" && i + 1 < argc) {
+			inputs.emplace_back(argv[i+1]);
+			++i;
+		} else if (arg == "--out" && i + 1 < argc) {
+			outputs.emplace_back(argv[i+1]);
+			++i;
+		} else if (manifest_file == "") {
+			manifest_file = arg;
+		} else {
+			command.emplace_back(arg);
+		}
+	}
+	if (manifest_file == "" || outputs.empty() || command.empty()) {
+		std::cerr << "Usage:\n\t./bake_cached [--force] <manifest> [--in input ...] --out output [--out output ...] <command ...>\nRun <command> unless every output is listed in <manifest> as made from the same inputs and arguments, and still has the bytes it was made with.\nThe key hashes the program's name and every later argument of <command> (not the program's path, so tools may live in different places), the bytes of the program (or, for interpreters, of its first '.py' argument), and the contents of every input.\nAfter a successful run, the outputs' hashes are recorded in <manifest>. Skipped outputs are touched, so make sees them as newer than their inputs." << std::endl;
+		return 1;
+	}
+
+	//key from arguments, program contents, and input contents:
+	Hash key_hash;
+	std::string program = command[0];
+	auto slash = program.find_last_of("/\\");
+	if (slash != std::string::npos) program = program.substr(slash + 1);
+	key_hash.add(program);
+	for (uint32_t i = 1; i < command.size(); ++i) {
+		key_hash.add(command[i]);
+	}
+	{ //(a rebuilt tool or an edited script that computes something different must rebake)
+		std::string file = program_file(command);
+		std::string hash = hash_file(file);
+		if (hash == "") {
+			std::cerr << "Can't read program '" << file << "'." << std::endl;
+			return 1;
+		}
+		key_hash.add(hash);
+	}
+	for (auto const &input : inputs) {
+		std::string hash = hash_file(input);
+		if (hash == "") {
+			std::cerr << "Can't read input '" << input << "'." << std::endl;
+			return 1;
+		}
+		key_hash.add(input);
+		key_hash.add(hash);
+	}
+	std::string key = key_hash.hex();
+
+	auto manifest = read_manifest(manifest_file);
+
+	bool up_to_date = !force;
+	for (auto const &output : outputs) {
+		if (!up_to_date) break;
+		auto f = manifest.find(output);
+		up_to_date = (f != manifest.end() && f->second.first == key && f->second.second == hash_file(output));
+	}
+
+	if (up_to_date) {
+		for (auto const &output : outputs) {
+			utime(output.c_str(), nullptr);
+		}
+		std::cout << "Up to date:";
+		for (auto const &output : outputs) std::cout << " '" << output << "'";
+		std::cout << " (key " << key << ")" << std::endl;
+		return 0;
+	}
+
+	std::string line;
+	for (auto const &word : command) {
+		if (line != "") line += ' ';
+		line += quote(word);
+	}
+	int result = std::system(line.c_str());
+	if (result != 0) {
+		std::cerr << "Bake command failed (" << result << "); manifest not updated." << std::endl;
+		return 1;
+	}
+
+	std::vector< std::string > hashes;
+	for (auto const &output : outputs) {
+		hashes.emplace_back(hash_file(output));
+		if (hashes.back() == "") {
+			std::cerr << "Bake command did not write '" << output << "'." << std::endl;
+			return 1;
+		}
+	}
+
+	//merge the new lines into the manifest as it is now (other bakes may have updated it while this one ran),
+	// holding a lock so that bakes sharing a manifest under 'make -j' take turns:
+	int lock = lock_file(manifest_file);
+	if (lock < 0) {
+		std::cerr << "Failed to lock '" << manifest_file << "'." << std::endl;
+		return 1;
+	}
+	manifest = read_manifest(manifest_file);
+	for (uint32_t i = 0; i < outputs.size(); ++i) {
+		manifest[outputs[i]] = std::make_pair(key, hashes[i]);
+	}
+
+	//rewrite the manifest via a temporary file of this process's own, so an interrupted write doesn't lose it:
+	std::string temp_file = manifest_file + "." + std::to_string(getpid()) + ".tmp";
+	{
+		std::ofstream out(temp_file);
+		for (auto const &entry : manifest) {
+			out << entry.second.first << ' ' << entry.first << ' ' << entry.second.second << '\n';
+		}
+		if (!out) {
+			std::cerr << "Failed to write '" << temp_file << "'." << std::endl;
+			std::remove(temp_file.c_str());
+			close(lock);
+			return 1;
+		}
+	}
+	if (std::rename(temp_file.c_str(), manifest_file.c_str()) != 0) {
+		std::cerr << "Failed to replace '" << manifest_file << "'." << std::endl;
+		std::remove(temp_file.c_str());
+		close(lock);
+		return 1;
+	}
+	close(lock);
+
+	return 0;
+}
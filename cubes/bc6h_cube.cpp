@@ -0,0 +1,165 @@
+#include "load_save_png.hpp"
+#include "rgbe_n.hpp"
+#include "rgb9e5.hpp"
+#include "bc6h.hpp"
+#include "cube_bc6h.hpp"
+#include "cube_e5.hpp"
+#include "ThreadPool.hpp"
+#include "cube_blur.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+//multi-exposure PSNR (as used to compare HDR texture codecs): both images are scaled by 2^c for
+// each stop c in [-6,6], gamma-compressed to 8 bits, and the squared error is averaged over all of them.
+double mpsnr(std::vector< glm::vec3 > const &a, std::vector< glm::vec3 > const &b) {
+	auto map = [](float v, float scale) {
+		return std::min(255.0f, std::max(0.0f, std::round(255.0f * std::pow(v * scale, 1.0f / 2.2f))));
+	};
+	double err = 0.0;
+	uint64_t count = 0;
+	for (int32_t c = -6; c <= 6; ++c) {
+		float scale = std::ldexp(1.0f, c);
+		for (size_t i = 0; i < a.size(); ++i) {
+			for (uint32_t ch = 0; ch < 3; ++ch) {
+				double d = map(a[i][ch], scale) - map(b[i][ch], scale);
+				err += d * d;
+			}
+		}
+		count += a.size() * 3;
+	}
+	double mse = err / double(count);
+	if (mse == 0.0) return std::numeric_limits< double >::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+int main(int argc, char **argv) {
+	int32_t threads = 0;
+	BC6HPreset preset = BC6HQuality;
+	std::vector< std::string > args;
+	bool usage = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[i+1]);
+			i += 1;
+		} else if (arg == "--preset" && i + 1 < argc) {
+			std::string name = argv[i+1];
+			i += 1;
+			if (name == "fast") preset = BC6HFast;
+			else if (name == "quality") preset = BC6HQuality;
+			else usage = true;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (usage || args.size() < 1 || args.size() > 2 || threads < 0) {
+		std::cerr << "Usage:\n\t./bc6h_cube [--threads N] [--preset fast|quality] <in.png|in.e5> [out.bc6]\nCompress a cubemap (an rgbe png, with faces stacked +x/-x/+y/-y/+z/-z top-to-bottom, or an .e5 file) to BC6H blocks, stored as a .bc6 file (see ../cube_bc6h.hpp).\nAn rgbe png input also brings along any mip levels stored next to it (in.1.png, in.2.png, ...); an .e5 input brings all of its levels. A single level (with power-of-two size) gets a box-filtered mip chain, since GL can't generate mipmaps for compressed textures.\nReports encode speed and multi-exposure PSNR (stops -6..+6) of the decoded blocks against the input; without an output file, only reports.\n(--preset quality, the default, tries every one-region mode with refined endpoints; --preset fast uses one mode and is several times quicker)\n(--threads 0, the default, uses all cores; output does not depend on thread count)" << std::endl;
+		return 1;
+	}
+	std::string in_file = args[0];
+	std::string out_file = (args.size() > 1 ? args[1] : "");
+
+	ThreadPool pool(threads);
+
+	//load input levels as linear floating point data:
+	uint32_t size = 0;
+	std::vector< std::vector< glm::vec3 > > levels;
+	if (in_file.size() >= 3 && in_file.substr(in_file.size() - 3) == ".e5") {
+		CubeE5File e5(in_file);
+		size = e5.size;
+		for (uint32_t l = 0; l < e5.levels; ++l) {
+			uint32_t s = e5.level_size(l);
+			uint32_t const *texels = e5.level_data(l);
+			levels.emplace_back(6 * s * s);
+			for (uint32_t i = 0; i < 6 * s * s; ++i) {
+				levels.back()[i] = rgb9e5_to_float(texels[i]);
+			}
+		}
+	} else {
+		for (uint32_t l = 0; ; ++l) {
+			std::string level_file = level_filename(in_file, l);
+			if (l > 0 && !std::ifstream(level_file)) break;
+			glm::uvec2 in_size;
+			std::vector< glm::u8vec4 > in_data_rgbe;
+			load_png(level_file, &in_size, &in_data_rgbe, LowerLeftOrigin);
+			if (in_size.x * 6 != in_size.y) {
+				std::cerr << "Expecting a 1x6 image in '" << level_file << "'." << std::endl;
+				return 1;
+			}
+			if (l == 0) size = in_size.x;
+			if (in_size.x != std::max(1U, size >> l)) {
+				std::cerr << "Expecting '" << level_file << "' to be level " << l << " of a " << size << " cube." << std::endl;
+				return 1;
+			}
+			levels.emplace_back(in_data_rgbe.size());
+			rgbe_to_float_n(in_data_rgbe.data(), in_data_rgbe.size(), levels.back().data());
+			if (in_size.x == 1) break;
+		}
+	}
+	std::cout << "Loaded a " << size << " cube with " << levels.size() << " level(s) from '" << in_file << "'" << std::endl;
+
+	//compressed textures can't have mipmaps generated by GL, so a lone level gets a box-filtered chain here:
+	if (levels.size() == 1 && size > 1) {
+		if ((size & (size - 1)) != 0) {
+			std::cerr << "Expecting a power-of-two size to build a mip chain (or a full chain of input levels)." << std::endl;
+			return 1;
+		}
+		std::cout << "Building mip chain..."; std::cout.flush();
+		CubeMips mips(size, levels[0]);
+		for (uint32_t l = 1; l < mips.levels.size(); ++l) {
+			levels.emplace_back(std::move(mips.levels[l].data));
+		}
+		std::cout << " done." << std::endl;
+	}
+	if ((size >> levels.size()) > 0) {
+		std::cerr << "Expecting a full chain of levels (have " << levels.size() << " for a " << size << " cube)." << std::endl;
+		return 1;
+	}
+
+	//encode every face of every level, spreading block rows over the pool:
+	std::cout << "Encoding with " << pool.size() << " threads..."; std::cout.flush();
+	auto before = std::chrono::high_resolution_clock::now();
+	std::vector< std::vector< uint8_t > > blocks(levels.size());
+	uint64_t texels = 0;
+	for (uint32_t l = 0; l < levels.size(); ++l) {
+		uint32_t s = std::max(1U, size >> l);
+		size_t face_bytes = bc6h_image_bytes(glm::uvec2(s));
+		uint32_t rows = (s + 3) / 4;
+		blocks[l].resize(6 * face_bytes);
+		pool.parallel_for(6 * rows, [&](uint32_t i){
+			uint32_t f = i / rows;
+			encode_bc6h_row(glm::uvec2(s), levels[l].data() + f * s * s, i % rows, preset, blocks[l].data() + f * face_bytes);
+		});
+		texels += 6 * s * s;
+	}
+	double seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count();
+	std::cout << " done in " << seconds * 1000.0 << "ms (" << (texels / 1.0e6) / seconds << " Mtexels/s)." << std::endl;
+
+	//measure quality, with the RGB9_E5 fallback (what the game uploads without BC6H support) for comparison:
+	for (uint32_t l = 0; l < levels.size(); ++l) {
+		uint32_t s = std::max(1U, size >> l);
+		size_t face_bytes = bc6h_image_bytes(glm::uvec2(s));
+		std::vector< glm::vec3 > decoded(levels[l].size());
+		std::vector< glm::vec3 > packed(levels[l].size());
+		for (uint32_t f = 0; f < 6; ++f) {
+			decode_bc6h_image(glm::uvec2(s), blocks[l].data() + f * face_bytes, decoded.data() + f * s * s);
+		}
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = rgb9e5_to_float(float_to_rgb9e5(levels[l][i]));
+		}
+		std::cout << "Level " << l << " (" << s << "x" << s << "): mPSNR " << mpsnr(levels[l], decoded) << " dB (RGB9_E5: " << mpsnr(levels[l], packed) << " dB)" << std::endl;
+	}
+
+	if (out_file != "") {
+		save_cube_bc6h(out_file, size, blocks);
+		std::cout << "Wrote '" << out_file << "'." << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+#!/bin/bash
+#Accuracy/speed benchmark for the cube tools.
+# Runs each mode of hdr_to_cube and blur_cube on one input, timing it and measuring its output
+# against a slow, high-quality reference with cube_compare, so every change to the tools can be read
+# as a quality/time trade-off. Every mode is deterministic (sample points are seeded per texel),
+# so repeated runs of the same code give the same errors.
+#
+#Each result is printed and appended to the results file as one line:
+#   <date> <commit> <tool> <mode> <seconds> <rmse> <psnr dB> <max rel>
+#(references are baked once per work directory; delete it after changing what a reference mode computes)
+
+set -e
+
+threads=0
+if [ "$1" == "--threads" ]; then
+	threads="$2"
+	shift 2
+fi
+if [ $# -lt 1 ] || [ $# -gt 3 ]; then
+	echo "Usage: ./bench_cubes.sh [--threads N] <latlon.hdr> [work dir (default bench/)] [results file (default <work dir>/results.txt)]" 1>&2
+	exit 1
+fi
+
+hdr="$1"
+work="${2:-bench}"
+results="${3:-$work/results.txt}"
+tools="$(cd "$(dirname "$0")" && pwd)"
+mkdir -p "$work"
+
+commit="$(git -C "$tools" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+stamp="$(date +%Y-%m-%dT%H:%M:%S)"
+
+SKY=256 #size of sky cubes
+BLURRED=32 #size of blurred cubes
+
+#run a command quietly (its output goes to <work>/<name>.log) and print its wall time in seconds:
+timed() {
+	local name="$1"
+	shift
+	local before after
+	before=$(date +%s.%N)
+	(cd "$work" && "$@") > "$work/$name.log" 2>&1 || { echo "'$*' failed; see $work/$name.log" 1>&2; exit 1; }
+	after=$(date +%s.%N)
+	awk "BEGIN { printf \"%.3f\", $after - $before }"
+}
+
+#bake a reference once (it is slow, and doesn't change unless the work directory is cleared):
+reference() {
+	local out="$1"
+	shift
+	if [ ! -f "$work/$out" ]; then
+		echo "Baking reference $out ..."
+		timed "ref-$out" "$@" > /dev/null
+	fi
+}
+
+#run one mode and record its time and error against a reference:
+# bench <tool> <mode name> <reference> <compared output> <command ...>
+bench() {
+	local tool="$1" mode="$2" ref="$3" out="$4"
+	shift 4
+	local seconds stats
+	seconds=$(timed "$tool-$mode" "$@")
+	stats=$("$tools/cube_compare" "$work/$ref" "$work/$out" | awk '$1 == "all" { print $2, $3, $4 }')
+	echo "$stamp $commit $tool $mode $seconds $stats" | tee -a "$results"
+}
+
+abs_hdr="$(cd "$(dirname "$hdr")" && pwd)/$(basename "$hdr")"
+H="$tools/hdr_to_cube --threads $threads"
+B="$tools/blur_cube --threads $threads"
+
+#references: a 4x supersampled sky (box-filtered down by cube_compare), and blurs with many random samples and exact lookups:
+reference sky-ref.png $H "$abs_hdr" $((SKY * 4)) sky-ref.png
+reference diffuse-ref.png $B --sampler random --lookup nearest sky-ref.png diffuse 4096 $BLURRED diffuse-ref.png
+reference ggx-ref.png $B --sampler random --lookup nearest sky-ref.png ggx 1024 $BLURRED ggx-ref.png
+
+echo "# date commit tool mode seconds rmse psnr max_rel" | tee -a "$results"
+
+bench hdr_to_cube point sky-ref.png sky-point.png $H "$abs_hdr" $SKY sky-point.png
+bench hdr_to_cube mip sky-ref.png sky-mip.png $H --sampling mip "$abs_hdr" $SKY sky-mip.png
+bench hdr_to_cube max-memory sky-ref.png sky-stream.png $H --max-memory 64 "$abs_hdr" $SKY sky-stream.png
+
+bench blur_cube diffuse-200 diffuse-ref.png diffuse-200.png $B sky-point.png diffuse 200 $BLURRED diffuse-200.png
+bench blur_cube diffuse-50 diffuse-ref.png diffuse-50.png $B sky-point.png diffuse 50 $BLURRED diffuse-50.png
+bench blur_cube diffuse-random-nearest-200 diffuse-ref.png diffuse-rn-200.png $B --sampler random --lookup nearest sky-point.png diffuse 200 $BLURRED diffuse-rn-200.png
+bench blur_cube sh9 diffuse-ref.png sh9.png $B sky-point.png sh9 1 $BLURRED sh9.png
+#(ggx level 2 is the first with a lobe wide enough for sample counts to matter at this size)
+bench blur_cube ggx-64 ggx-ref.2.png ggx-64.2.png $B sky-point.png ggx 64 $BLURRED ggx-64.png
+bench blur_cube ggx-256 ggx-ref.2.png ggx-256.2.png $B sky-point.png ggx 256 $BLURRED ggx-256.png
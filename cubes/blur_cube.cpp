@@ -1,292 +1,320 @@
-#include "load_save_png.hpp"
-#include "rgbe.hpp"
+#include "ibl.hpp"
+#include "ThreadPool.hpp"
+#include "cube_blur.hpp"
+#include "cube_shard.hpp"
 
 #include <iostream>
-#include <functional>
-#include <random>
+#include <chrono>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+
+//write the output: an .e5 holds every level; pngs get level 0 in <out.png> and level i in <out.i.png>:
+void save_output(std::string const &out_file, CubeImage const &out) {
+	if (is_e5_filename(out_file)) {
+		std::cout << "Writing final packed RGB9_E5 cube..."; std::cout.flush();
+	} else {
+		std::cout << "Writing final rgbe png";
+		if (out.levels.size() > 1) std::cout << " (and " << out.levels.size() - 1 << " level pngs)";
+		std::cout << "..."; std::cout.flush();
+	}
+	save_cube_image(out_file, out);
+	std::cout << " done." << std::endl;
 
-void save_tone_mapped_png(std::string const &filename, glm::uvec2 size, std::vector< glm::vec3 > const &data) {
-	std::vector< glm::u8vec4 > mapped;
-	mapped.reserve(data.size());
-	for (auto pix : data) {
-		//luminance (in lumens per steradian per square meter) of pixel:
-		// [according to picture file format docs]
-		//float lum = 179 * 0.265f * pix.r + 0.670f * pix.g + 0.065f * pix.b;
-
-		//gamma compression:
-		constexpr const float Gamma = 0.45f;
-		pix.r = std::pow(pix.r, Gamma);
-		pix.g = std::pow(pix.g, Gamma);
-		pix.b = std::pow(pix.b, Gamma);
+	{ //DEBUG: tone map and save again:
+		std::cout << "Writing tone-mapped png [DEBUG-blur-out.png]..."; std::cout.flush();
+		save_tone_mapped_png("DEBUG-blur-out.png", out.level_dims(0), out.levels[0]);
+		std::cout << " done." << std::endl;
+	}
+}
 
-		glm::ivec3 amt = glm::ivec3(255.0f * pix);
-		mapped.emplace_back(
-			std::min(255, std::max(0, amt.r)),
-			std::min(255, std::max(0, amt.g)),
-			std::min(255, std::max(0, amt.b)),
-			0xff
-		);
+//FNV-1a (64-bit) of the input's level 0 texels, so --merge can tell shards baked from different skies apart:
+std::string hash_level(std::vector< glm::vec3 > const &level) {
+	uint64_t value = 0xcbf29ce484222325ULL;
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(level.data());
+	for (size_t i = 0; i < level.size() * sizeof(glm::vec3); ++i) {
+		value = (value ^ data[i]) * 0x100000001b3ULL;
 	}
-	save_png(filename, size, mapped.data(), LowerLeftOrigin);
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)value);
+	return hex;
 }
 
-enum Face {
-	PositiveX = 0, NegativeX = 1,
-	PositiveY = 2, NegativeY = 3,
-	PositiveZ = 4, NegativeZ = 5,
-};
+//stitch shard files from 'blur_cube --shard i/N' runs into the output a single run would have written:
+int merge_shards(std::string const &out_file, std::vector< std::string > const &shard_files) {
+	CubeShard merged;
+	std::string args;
+	std::vector< bool > seen;
+	for (auto const &shard_file : shard_files) {
+		std::cout << "Reading shard [" << shard_file << "]..."; std::cout.flush();
+		load_cube_shard(shard_file, &merged);
+		std::cout << " done; shard " << merged.shard.index << "/" << merged.shard.count << "." << std::endl;
+		if (seen.empty()) {
+			seen.assign(merged.shard.count, false);
+			args = merged.args;
+		}
+		if (merged.shard.count != seen.size() || merged.args != args) {
+			std::cerr << "Shard '" << shard_file << "' (" << merged.args << ", " << merged.shard.count << " shards) is from a different run than '" << shard_files[0] << "' (" << args << ", " << seen.size() << " shards)." << std::endl;
+			return 1;
+		}
+		if (seen[merged.shard.index]) {
+			std::cerr << "Shard " << merged.shard.index << " is given more than once." << std::endl;
+			return 1;
+		}
+		seen[merged.shard.index] = true;
+	}
+	for (uint32_t i = 0; i < seen.size(); ++i) {
+		if (!seen[i]) {
+			std::cerr << "Shard " << i << "/" << seen.size() << " is missing." << std::endl;
+			return 1;
+		}
+	}
+	CubeImage out;
+	out.layout = (merged.faces == 1 ? LayoutOct : LayoutCube);
+	out.size = merged.size;
+	out.levels = std::move(merged.levels);
+	if (out.layout == LayoutOct && is_e5_filename(out_file)) {
+		std::cerr << "Octahedral maps are only written as rgbe pngs." << std::endl;
+		return 1;
+	}
+	save_output(out_file, out);
+	return 0;
+}
 
 int main(int argc, char **argv) {
-	if (argc != 6 && argc != 7) {
-		std::cerr << "Usage:\n\t./blur_cube <in.png> <diffuse|bokeh|...> <samples> <out size> <out.png> [brightest]\nBlur a cubemap (stored as an rgbe png, with faces stacked +x/-x/+y/-y/+z/-z top-to-bottom) into another cubemap (stored into the same format)" << std::endl;
+	//pull out options, leaving positional arguments:
+	std::vector< std::string > args;
+	BlurSettings settings;
+	int32_t threads = 0;
+	bool benchmark = false;
+	std::string layout_name = "cube";
+	std::string sampler_name = "sobol";
+	Shard shard;
+	bool sharded = false; //if set, write only this shard's rows, to a shard file
+	bool merge = false; //if set, stitch shard files together instead of blurring
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--sampler" && i + 1 < argc) {
+			std::string name = argv[i+1];
+			sampler_name = name;
+			if (name == "random") settings.sampler = SamplerRandom;
+			else if (name == "hammersley") settings.sampler = SamplerHammersley;
+			else if (name == "sobol") settings.sampler = SamplerSobol;
+			else {
+				std::cerr << "Sampler must be 'random', 'hammersley', or 'sobol'." << std::endl;
+				return 1;
+			}
+			++i;
+		} else if (arg == "--benchmark") {
+			benchmark = true;
+		} else if (arg == "--lookup" && i + 1 < argc) {
+			std::string lookup_mode = argv[i+1];
+			if (lookup_mode != "nearest" && lookup_mode != "mip") {
+				std::cerr << "Lookup must be 'nearest' or 'mip'." << std::endl;
+				return 1;
+			}
+			settings.mip_lookup = (lookup_mode == "mip");
+			++i;
+		} else if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[i+1]);
+			++i;
+		} else if (arg == "--layout" && i + 1 < argc) {
+			layout_name = argv[i+1];
+			++i;
+		} else if (arg == "--shard" && i + 1 < argc) {
+			std::string spec = argv[i+1];
+			auto slash = spec.find('/');
+			int32_t index = std::atoi(spec.substr(0, slash).c_str());
+			int32_t count = (slash == std::string::npos ? 0 : std::atoi(spec.substr(slash + 1).c_str()));
+			if (count < 1 || index < 0 || index >= count) {
+				std::cerr << "Shard must be 'i/N' with 0 <= i < N." << std::endl;
+				return 1;
+			}
+			shard.index = uint32_t(index);
+			shard.count = uint32_t(count);
+			sharded = true;
+			++i;
+		} else if (arg == "--merge") {
+			merge = true;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (merge && args.size() >= 2) {
+		return merge_shards(args[0], std::vector< std::string >(args.begin() + 1, args.end()));
+	}
+	if (merge || (args.size() != 5 && args.size() != 6)) {
+		std::cerr << "Usage:\n\t./blur_cube [--threads N] [--sampler random|hammersley|sobol] [--lookup nearest|mip] [--layout cube|oct] [--benchmark] [--shard i/N] <in.png|in.e5> <diffuse|bokeh|sharp|ggx|sh9|...> <samples> <out size> <out.png|out.e5> [brightest]\nBlur a cubemap (stored as an rgbe png, with faces stacked +x/-x/+y/-y/+z/-z top-to-bottom) into another cubemap (stored into the same format)\n'shN' modes (N = 1, 4, 9, 16, ...) project onto N spherical harmonics coefficients instead of sampling (samples and brightest are ignored), and also write the coefficients to <out.png>.sh.txt\n(--threads 0, the default, uses all cores; output does not depend on thread count)\n(--sampler sobol, the default, uses scrambled low-discrepancy points per texel; --lookup mip, the default, reads each sample from an input mip level matching the sample's share of the lobe, so far fewer samples are needed than with nearest)\n(--benchmark also times diffuse/bokeh/sharp sampling through std::function dispatch and reports the cost per sample of both)\n'ggx' mode writes a full mip chain (roughness = level / (levels-1)) to <out.png>, <out.1.png>, <out.2.png>, ...; samples may be a comma-separated list giving the count for levels 1, 2, ... (the last count repeats)\n(an output name ending in .e5 gets a packed RGB9_E5 cube file, see ../cube_e5.hpp, instead of an rgbe png; for 'ggx' it holds every level)\n(--layout oct writes an <out size> x <out size> octahedral map, see ../octahedral.hpp, instead of a cube; input is still a cube, and output must be a png)\n(--shard i/N samples only the i'th of N bands of output rows, and writes them to <out> as a shard file; then\n\t./blur_cube --merge <out.png|out.e5> <shard files...>\nwrites the output a single run would have, from all N shards)" << std::endl;
 		return 1;
 	}
-	std::string in_file = argv[1];
-	std::string mode = argv[2];
-	int32_t samples = std::atoi(argv[3]);
-	glm::ivec2 out_size;
-	out_size.x = std::atoi(argv[4]);
-	out_size.y = out_size.x * 6;
-	std::string out_file = argv[5];
-	int32_t brightest = 10000;
-	if (argc == 7) brightest = std::atoi(argv[6]);
-
-	struct BrightDirection {
-		glm::vec3 direction = glm::vec3(0.0f);
-		glm::vec3 light = glm::vec3(0.0f); //already multiplied by solid angle, I guess?
-	};
-	std::vector< BrightDirection > bright_directions;
-
-	std::function< glm::vec3() > make_sample; //returns an upper hemisphere direction
-	std::function< glm::vec3(glm::vec3) > sum_bright_directions; //run lighting for bright directions, given normal
+	std::string in_file = args[0];
+	std::string mode = args[1];
+	FilterJob job;
+	job.samples.clear();
+	for (std::string list = args[2]; ; ) {
+		auto comma = list.find(',');
+		int32_t count = std::atoi(list.substr(0, comma).c_str());
+		if (count < 1) {
+			std::cerr << "Samples per pixel must be at least 1." << std::endl;
+			return 1;
+		}
+		job.samples.emplace_back(uint32_t(count));
+		if (comma == std::string::npos) break;
+		list = list.substr(comma + 1);
+	}
+	if (layout_name != "cube" && layout_name != "oct") {
+		std::cerr << "Layout must be 'cube' or 'oct'." << std::endl;
+		return 1;
+	}
+	job.layout = (layout_name == "oct" ? LayoutOct : LayoutCube);
+	int32_t out_size = std::atoi(args[3].c_str());
+	std::string out_file = args[4];
+	if (args.size() == 6) settings.brightest = uint32_t(std::max(0, std::atoi(args[5].c_str())));
 
 	if (mode == "diffuse") {
-		make_sample = []() -> glm::vec3 {
-			//attempt to importance sample upper hemisphere (cos-weighted):
-			//based on: http://www.rorydriscoll.com/2009/01/07/better-sampling/
-			static std::mt19937 mt(0x12341234);
-			glm::vec2 rv(mt() / float(mt.max()), mt() / float(mt.max()));
-			float phi = rv.x * 2.0f * M_PI;
-			float r = std::sqrt(rv.y);
-			return glm::vec3(
-				std::cos(phi) * r,
-				std::sin(phi) * r,
-				std::sqrt(1.0f - rv.y)
-			);
-		};
-		sum_bright_directions = [&bright_directions](glm::vec3 n) -> glm::vec3 {
-			glm::vec3 ret = glm::vec3(0.0f);
-			for (auto const &bd : bright_directions) {
-				ret += std::max(0.0f, glm::dot(bd.direction, n)) * bd.light;
-			}
-			return ret;
-		};
+		job.kind = FilterJob::Diffuse;
 	} else if (mode == "bokeh") {
-		constexpr float angle = 0.7f / 180.0f * float(M_PI);
-		float max_r = std::sin(angle);
-		float min_y = std::sqrt(1.0f - max_r * max_r);
-		make_sample = [min_y]() -> glm::vec3 {
-			//try to uniformly sample a disc...
-			static std::mt19937 mt(0x12341234);
-			glm::vec2 rv(mt() / float(mt.max()), mt() / float(mt.max()));
-			float phi = rv.x * 2.0f * M_PI;
-			//float r = max_r * std::sqrt(rv.y);
-			rv.y = min_y + (1.0f - min_y) * rv.y;
-			float r = std::sqrt(1.0f - rv.y * rv.y);
-			return glm::vec3(
-				std::cos(phi) * r,
-				std::sin(phi) * r,
-				rv.y
-			);
-		};
-		float thresh = std::cos(angle); //hmmmmmmm
-		sum_bright_directions = [&bright_directions,thresh](glm::vec3 n) -> glm::vec3 {
-			glm::vec3 ret = glm::vec3(0.0f);
-			for (auto const &bd : bright_directions) {
-			 	if (glm::dot(bd.direction, n) > thresh) {
-					ret += bd.light;
-				}
-			}
-			return ret;
-		};
+		job.kind = FilterJob::Bokeh;
 	} else if (mode == "sharp") {
-		make_sample = []() -> glm::vec3 {
-			return glm::vec3(0.0f, 0.0f, 1.0f);
-		};
+		job.kind = FilterJob::Sharp;
+	} else if (mode == "ggx") {
+		job.kind = FilterJob::GGX;
+	} else if (mode.size() > 2 && mode.substr(0,2) == "sh") {
+		int32_t coefficients = std::atoi(mode.substr(2).c_str());
+		job.kind = FilterJob::SH;
+		job.sh_bands = uint32_t(std::round(std::sqrt(float(std::max(0, coefficients)))));
+		if (job.sh_bands < 1 || int32_t(job.sh_bands * job.sh_bands) != coefficients) {
+			std::cerr << "Spherical harmonics mode must be 'shN' with N a square (1, 4, 9, 16, ...)." << std::endl;
+			return 1;
+		}
 	} else {
-		std::cerr << "Blur must be 'diffuse', 'bokeh', or 'sharp'." << std::endl;
+		std::cerr << "Blur must be 'diffuse', 'bokeh', 'sharp', 'ggx', or 'shN'." << std::endl;
 		return 1;
 	}
-	if (out_size.x < 1) {
+	if (out_size < 1) {
 		std::cerr << "Output cube map size must be at least 1." << std::endl;
 		return 1;
 	}
-	if (samples < 1) {
-		std::cerr << "Samples per pixel must be at least 1." << std::endl;
+	job.size = uint32_t(out_size);
+	if (threads < 0) {
+		std::cerr << "Thread count must be non-negative." << std::endl;
+		return 1;
+	}
+	if (sharded && job.kind == FilterJob::SH) {
+		std::cerr << "Spherical harmonics modes take one pass over the input and can't be sharded." << std::endl;
+		return 1;
+	}
+	job.shard = shard;
+	if (is_e5_filename(out_file) && job.layout == LayoutOct && !sharded) {
+		std::cerr << "Octahedral maps are only written as rgbe pngs." << std::endl;
 		return 1;
 	}
 
-	glm::uvec2 in_size;
-	std::vector< glm::u8vec4 > in_data_rgbe;
-	load_png(in_file, &in_size, &in_data_rgbe, LowerLeftOrigin);
-
-	std::cout << "Loaded a " << in_size.x << " x " << in_size.y << " rgbe image from '" << in_file << "'" << std::endl;
+	ThreadPool pool(threads);
 
-	if (in_size.x * 6 != in_size.y) {
+	CubeImage sky = load_cube_image(in_file);
+	std::cout << "Loaded a " << sky.size << " x " << sky.size << " x " << sky.faces() << " (as linear floating point) from '" << in_file << "'" << std::endl;
+	if (sky.layout != LayoutCube) {
 		std::cerr << "Expecting a 1x6 image." << std::endl;
 		return 1;
 	}
+	sky.levels.resize(1); //(filters read level 0 only)
+	FilterSource source(sky, settings);
 
-	//convert rgbe data to linear floating point data:
-	std::cout << "Converting to linear floating point..."; std::cout.flush();
-	std::vector< glm::vec3 > in_data;
-	in_data.reserve(in_data_rgbe.size());
-	for (auto const &pix : in_data_rgbe) {
-		in_data.emplace_back( rgbe_to_float(pix) );
-	}
-	std::cout << " done." << std::endl;
+	FilterResult result;
 
-	if (sum_bright_directions) {
-		uint32_t bright = std::min< uint32_t >(in_data.size(), brightest);
-		std::cout << "Separating the brightest " << bright << " pixels..."; std::cout.flush();
-		std::vector< std::pair< float, uint32_t > > pixels;
-		pixels.reserve(in_data.size());
-		for (auto const &px : in_data) {
-			pixels.emplace_back(std::max(px.r, std::max(px.g, px.b)), pixels.size());
+	if (job.kind == FilterJob::SH) {
+		{ //DEBUG: tone map and save again:
+			std::cout << "Writing tone-mapped png [DEBUG-blur-in.png]..."; std::cout.flush();
+			save_tone_mapped_png("DEBUG-blur-in.png", sky.level_dims(0), sky.levels[0]);
+			std::cout << " done." << std::endl;
 		}
-		std::stable_sort(pixels.begin(), pixels.end());
-		for (uint32_t b = 0; b < bright; ++b) {
-			uint32_t i = pixels[pixels.size()-1-b].second;
-			uint32_t s = i % in_size.x;
-			uint32_t t = (i / in_size.x) % in_size.x;
-			uint32_t f = i / (in_size.x * in_size.x);
-
-			glm::vec3 sc; //maps to rightward axis on face
-			glm::vec3 tc; //maps to upward axis on face
-			glm::vec3 ma; //direction to face
-			//See OpenGL 4.4 Core Profile specification, Table 8.18:
-			if      (f == PositiveX) { sc = glm::vec3( 0.0f, 0.0f,-1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 1.0f, 0.0f, 0.0f); }
-			else if (f == NegativeX) { sc = glm::vec3( 0.0f, 0.0f, 1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3(-1.0f, 0.0f, 0.0f); }
-			else if (f == PositiveY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f, 1.0f); ma = glm::vec3( 0.0f, 1.0f, 0.0f); }
-			else if (f == NegativeY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f,-1.0f); ma = glm::vec3( 0.0f,-1.0f, 0.0f); }
-			else if (f == PositiveZ) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f, 1.0f); }
-			else if (f == NegativeZ) { sc = glm::vec3(-1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f,-1.0f); }
-			else assert(0 && "Invalid face.");
-
-			glm::vec3 dir = glm::normalize(ma
-			              + (2.0f * (s + 0.5f) / in_size.x - 1.0f) * sc
-			              + (2.0f * (t + 0.5f) / in_size.x - 1.0f) * tc);
-
-			bright_directions.emplace_back();
-			bright_directions.back().direction = dir;
-			float solid_angle = 4.0f * M_PI / float(6.0f * in_size.x * in_size.x); // approximate, since pixels on cube actually take up different amounts depending on position
-			bright_directions.back().light = in_data[i] * solid_angle;
 
-			in_data[i] = glm::vec3(0.0f, 0.0f, 0.0f); //remove from input data
-		}
+		std::cout << "Projecting onto " << job.sh_bands * job.sh_bands << " spherical harmonics coefficients and reconstructing..."; std::cout.flush();
+		result = filter_cube(source, job, &pool);
 		std::cout << " done." << std::endl;
-	}
 
-	{ //DEBUG: tone map and save again:
-		std::cout << "Writing tone-mapped png [DEBUG-blur-in.png]..."; std::cout.flush();
-		save_tone_mapped_png("DEBUG-blur-in.png", in_size, in_data);
+		//write coefficients next to the output, for use in shaders:
+		std::string sh_file = out_file + ".sh.txt";
+		std::cout << "Writing coefficients [" << sh_file << "]..."; std::cout.flush();
+		save_sh(sh_file, result.sh);
 		std::cout << " done." << std::endl;
-	}
-
-
-/*
-	//check the conversion by dumping tone-mapped values:
-	std::cout << "Writing tone-mapped png [DEBUG-latlon.png]..."; std::cout.flush();
-	save_tone_mapped_png("DEBUG-latlon.png", size, data);
-	std::cout << " done." << std::endl;
-*/
-
-	//function for sampling a given direction from cubemap:
-	auto lookup = [&in_data,&in_size](glm::vec3 const &dir) -> glm::vec3 {
-		float sc, tc, ma;
-		uint32_t f;
-		if (std::abs(dir.x) >= std::abs(dir.y) && std::abs(dir.x) >= std::abs(dir.z)) {
-			if (dir.x >= 0) { sc = -dir.z; tc = -dir.y; ma = dir.x; f = PositiveX; }
-			else            { sc =  dir.z; tc = -dir.y; ma =-dir.x; f = NegativeX; }
-		} else if (std::abs(dir.y) >= std::abs(dir.z)) {
-			if (dir.y >= 0) { sc =  dir.x; tc =  dir.z; ma = dir.y; f = PositiveY; }
-			else            { sc =  dir.x; tc = -dir.z; ma =-dir.y; f = NegativeY; }
+	} else {
+		//build the input up front (filter_cube would on first use), to report on it:
+		if (job.separates_bright()) {
+			std::cout << "Separating the brightest " << std::min< size_t >(sky.levels[0].size(), settings.brightest) << " pixels";
 		} else {
-			if (dir.z >= 0) { sc =  dir.x; tc = -dir.y; ma = dir.z; f = PositiveZ; }
-			else            { sc = -dir.x; tc = -dir.y; ma =-dir.z; f = NegativeZ; }
+			std::cout << "Preparing input";
 		}
+		if (settings.mip_lookup) std::cout << " and building input mip pyramid";
+		std::cout << "..."; std::cout.flush();
+		BlurInput const &input = source.input(job.separates_bright());
+		std::cout << " done." << std::endl;
 
-		int32_t s = std::floor(0.5f * (sc / ma + 1.0f) * in_size.x);
-		s = std::max(0, std::min(int32_t(in_size.x)-1, s));
-		int32_t t = std::floor(0.5f * (tc / ma + 1.0f) * in_size.x);
-		t = std::max(0, std::min(int32_t(in_size.x)-1, t));
-
-		return in_data[(f*in_size.x+t)*in_size.x+s];
-	};
-
-	std::vector< glm::vec3 > out_data;
-	out_data.reserve(out_size.x * out_size.y);
-
-	std::cout << "Using " << samples << " samples per texel." << std::endl;
-
-	for (uint32_t f = 0; f < 6; ++f) {
-		std::cout << "Sampling face " << f << "/6 ..."; std::cout.flush();
-		glm::vec3 sc; //maps to rightward axis on face
-		glm::vec3 tc; //maps to upward axis on face
-		glm::vec3 ma; //direction to face
-		//See OpenGL 4.4 Core Profile specification, Table 8.18:
-		if      (f == PositiveX) { sc = glm::vec3( 0.0f, 0.0f,-1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 1.0f, 0.0f, 0.0f); }
-		else if (f == NegativeX) { sc = glm::vec3( 0.0f, 0.0f, 1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3(-1.0f, 0.0f, 0.0f); }
-		else if (f == PositiveY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f, 1.0f); ma = glm::vec3( 0.0f, 1.0f, 0.0f); }
-		else if (f == NegativeY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f,-1.0f); ma = glm::vec3( 0.0f,-1.0f, 0.0f); }
-		else if (f == PositiveZ) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f, 1.0f); }
-		else if (f == NegativeZ) { sc = glm::vec3(-1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f,-1.0f); }
-		else assert(0 && "Invalid face.");
-	
-		for (uint32_t t = 0; t < uint32_t(out_size.x); ++t) {
-			for (uint32_t s = 0; s < uint32_t(out_size.x); ++s) {
-				glm::vec3 N = glm::normalize(ma
-				            + (2.0f * (s + 0.5f) / out_size.x - 1.0f) * sc
-				            + (2.0f * (t + 0.5f) / out_size.x - 1.0f) * tc);
-				glm::vec3 temp = (abs(N.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f));
-				glm::vec3 TX = glm::normalize(glm::cross(N, temp));
-				glm::vec3 TY = glm::cross(N, TX);
-
-				glm::vec3 acc = glm::vec3(0.0f);
-				for (uint32_t i = 0; i < uint32_t(samples); ++i) {
-					//very inspired by the SampleGGX code in "Real Shading in Unreal" (https://cdn2.unrealengine.com/Resources/files/2013SiggraphPresentationsNotes-26915738.pdf):
-			
-
-					glm::vec3 dir = make_sample();
+		if (!sharded) { //DEBUG: tone map and save again:
+			// (not for shards, which may be running side by side in one directory)
+			std::cout << "Writing tone-mapped png [DEBUG-blur-in.png]..."; std::cout.flush();
+			save_tone_mapped_png("DEBUG-blur-in.png", sky.level_dims(0), input.data);
+			std::cout << " done." << std::endl;
+		}
 
-					acc += lookup( dir.x * TX + dir.y * TY + dir.z * N );
-					//acc += (dir.x * TX + dir.y * TY + dir.z * N) * 0.5f + 0.5f; //DEBUG
-				}
-				acc *= 1.0f / float(samples);
-				if (sum_bright_directions) {
-					acc += sum_bright_directions(N);
-				}
-				out_data.emplace_back(acc);
+		uint32_t rows = job.size * layout_faces(job.layout);
+		if (sharded) {
+			std::cout << "Computing shard " << shard.index << "/" << shard.count << ": rows " << shard.begin(rows) << " to " << shard.end(rows) << " of " << rows << " (and the same share of smaller levels)." << std::endl;
+		}
 
+		if (job.kind == FilterJob::GGX) {
+			//pre-filtered specular mip chain, with roughness increasing linearly per level:
+			uint32_t levels = ggx_levels(job.size);
+			auto level_done = [&](uint32_t level) {
+				uint32_t size = std::max(1U, job.size >> level);
+				float roughness = (levels > 1 ? float(level) / float(levels - 1) : 0.0f);
+				std::cout << "Level " << level << " (" << size << "x" << size << ", roughness " << roughness << ", " << job.level_samples(level) << " samples) done." << std::endl;
+			};
+			result = filter_cube(source, job, &pool, level_done);
+		} else {
+			uint32_t samples = job.level_samples(0);
+			std::cout << "Using " << samples << " samples per texel." << std::endl;
+
+			double total = double(shard.end(rows) - shard.begin(rows)) * double(job.size) * double(samples);
+			auto time = [&](FilterSource &from, FilterResult *out) -> double {
+				auto before = std::chrono::high_resolution_clock::now();
+				*out = filter_cube(from, job, &pool);
+				auto after = std::chrono::high_resolution_clock::now();
+				return std::chrono::duration< double >(after - before).count();
+			};
+			if (benchmark) {
+				std::cout << "Sampling through std::function kernel..."; std::cout.flush();
+				BlurSettings erased_settings = settings;
+				erased_settings.function_dispatch = true;
+				FilterSource erased(sky, erased_settings);
+				erased.input(job.separates_bright()); //(built outside the timing, as for the main run)
+				FilterResult erased_result;
+				double seconds = time(erased, &erased_result);
+				std::cout << " done; " << (seconds / total * 1e9) << " ns per sample." << std::endl;
 			}
+			std::cout << "Sampling with " << pool.size() << " threads..."; std::cout.flush();
+			double seconds = time(source, &result);
+			std::cout << " done; " << (seconds / total * 1e9) << " ns per sample." << std::endl;
 		}
-		std::cout << " done." << std::endl;
-	}
-
-	//write a single +x/-x/+y/-y/+z/-z (all stacked in a column with +x at the bottom) file for storage:
-	std::cout << "Writing final rgbe png..."; std::cout.flush();
-	std::vector< glm::u8vec4 > out_data_rgbe;
-	out_data_rgbe.reserve(out_size.x * 6 * out_size.y);
-	for (auto const &pix : out_data) {
-		out_data_rgbe.emplace_back( float_to_rgbe( pix ) );
 	}
-	std::cout << " done." << std::endl;
-	save_png(out_file, out_size, out_data_rgbe.data(), LowerLeftOrigin);
 
-	{ //DEBUG: tone map and save again:
-		std::cout << "Writing tone-mapped png [DEBUG-blur-out.png]..."; std::cout.flush();
-		save_tone_mapped_png("DEBUG-blur-out.png", out_size, out_data);
+	if (sharded) {
+		//everything that changes what gets computed, so --merge can refuse shards from different runs:
+		CubeShard out;
+		out.shard = shard;
+		out.size = job.size;
+		out.faces = layout_faces(job.layout);
+		out.args = "in " + std::to_string(sky.size) + " " + hash_level(sky.levels[0]) + ", " + mode + " " + args[2] + ", layout " + layout_name
+			+ ", sampler " + sampler_name + ", lookup " + (settings.mip_lookup ? "mip" : "nearest")
+			+ ", brightest " + std::to_string(settings.brightest);
+		out.levels = std::move(result.cube.levels);
+		std::cout << "Writing shard [" << out_file << "]..."; std::cout.flush();
+		save_cube_shard(out_file, out);
 		std::cout << " done." << std::endl;
+		return 0;
 	}
+
+	save_output(out_file, result.cube);
 }
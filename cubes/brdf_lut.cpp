@@ -0,0 +1,155 @@
+#include "load_save_png.hpp"
+#include "ThreadPool.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//Bakes the split-sum environment BRDF (see "Real Shading in Unreal Engine 4", Karis 2013):
+// texel (x,y) holds (scale, bias) for n.v = (x + 0.5) / size and roughness = (y + 0.5) / size,
+// so that specular = prefiltered_env(roughness, r) * (F0 * scale + bias)
+
+//i-th of n points of the Hammersley set:
+glm::vec2 hammersley(uint32_t i, uint32_t n) {
+	uint32_t bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	return glm::vec2(float(i) / float(n), float(bits) * 2.3283064365386963e-10f);
+}
+
+//integrate GGX specular (with Smith-Schlick visibility, k = alpha / 2) against Schlick fresnel:
+glm::vec2 integrate_brdf(float NoV, float roughness, uint32_t samples) {
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float k = alpha / 2.0f;
+	glm::vec3 V = glm::vec3(std::sqrt(1.0f - NoV * NoV), 0.0f, NoV);
+
+	glm::vec2 acc = glm::vec2(0.0f);
+	for (uint32_t i = 0; i < samples; ++i) {
+		glm::vec2 rv = hammersley(i, samples);
+		float phi = rv.x * 2.0f * float(M_PI);
+		float cos_theta = std::sqrt((1.0f - rv.y) / (1.0f + (alpha2 - 1.0f) * rv.y));
+		float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+		glm::vec3 H = glm::vec3(std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta);
+		float VoH = glm::dot(V, H);
+		glm::vec3 L = 2.0f * VoH * H - V;
+
+		float NoL = L.z;
+		float NoH = H.z;
+		if (NoL <= 0.0f || VoH <= 0.0f) continue;
+
+		float G = (NoV / (NoV * (1.0f - k) + k)) * (NoL / (NoL * (1.0f - k) + k));
+		float G_vis = G * VoH / (NoH * NoV);
+		float Fc = std::pow(1.0f - VoH, 5.0f);
+		acc.x += (1.0f - Fc) * G_vis;
+		acc.y += Fc * G_vis;
+	}
+	return acc / float(samples);
+}
+
+//IEEE half-float bits for a (finite, non-negative, small) float, rounded to nearest:
+uint16_t float_to_half(float f) {
+	uint32_t bits;
+	std::memcpy(&bits, &f, 4);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exp = int32_t((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = bits & 0x7fffff;
+	if (exp >= 31) return uint16_t(sign | 0x7c00); //overflow -> inf
+	if (exp <= 0) {
+		//denormal (or zero):
+		if (exp < -10) return uint16_t(sign);
+		mant |= 0x800000;
+		uint32_t shift = uint32_t(14 - exp);
+		uint32_t half = mant >> shift;
+		if ((mant >> (shift - 1)) & 1) half += 1;
+		return uint16_t(sign | half);
+	}
+	uint32_t half = sign | (uint32_t(exp) << 10) | (mant >> 13);
+	if (mant & 0x1000) half += 1; //round (carry into exponent is fine)
+	return uint16_t(half);
+}
+
+int main(int argc, char **argv) {
+	//pull out options, leaving positional arguments:
+	std::vector< std::string > args;
+	int32_t threads = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[i+1]);
+			++i;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (args.size() != 3) {
+		std::cerr << "Usage:\n\t./brdf_lut [--threads N] <size> <samples> <lut.png|lut.half>\nBake the split-sum BRDF table (x: n.v, y: roughness; channels: scale, bias for F0)\n(.png output is 16-bit gray+alpha with scale in gray and bias in alpha; any other name gets raw little-endian half-float (scale, bias) pairs, rows bottom-to-top)\n(--threads 0, the default, uses all cores; output does not depend on thread count)" << std::endl;
+		return 1;
+	}
+	int32_t size = std::atoi(args[0].c_str());
+	int32_t samples = std::atoi(args[1].c_str());
+	std::string out_file = args[2];
+
+	if (size < 1) {
+		std::cerr << "Table size must be positive." << std::endl;
+		return 1;
+	}
+	if (samples < 1) {
+		std::cerr << "Samples per texel must be at least 1." << std::endl;
+		return 1;
+	}
+	if (threads < 0) {
+		std::cerr << "Thread count must be non-negative." << std::endl;
+		return 1;
+	}
+
+	ThreadPool pool(threads);
+
+	std::vector< glm::vec2 > lut(size * size);
+	std::cout << "Integrating " << size << "x" << size << " table with " << samples << " samples per texel..."; std::cout.flush();
+	auto before = std::chrono::high_resolution_clock::now();
+	pool.parallel_for(uint32_t(size), [&](uint32_t y) {
+		float roughness = (y + 0.5f) / float(size);
+		for (uint32_t x = 0; x < uint32_t(size); ++x) {
+			float NoV = (x + 0.5f) / float(size);
+			lut[y * size + x] = integrate_brdf(NoV, roughness, uint32_t(samples));
+		}
+	});
+	auto after = std::chrono::high_resolution_clock::now();
+	std::cout << " done in " << std::chrono::duration< double >(after - before).count() << " seconds on " << pool.size() << " threads." << std::endl;
+
+	if (out_file.size() >= 4 && out_file.substr(out_file.size() - 4) == ".png") {
+		std::vector< glm::u16vec2 > data;
+		data.reserve(lut.size());
+		for (auto const &v : lut) {
+			data.emplace_back(
+				uint16_t(std::round(glm::clamp(v.x, 0.0f, 1.0f) * 65535.0f)),
+				uint16_t(std::round(glm::clamp(v.y, 0.0f, 1.0f) * 65535.0f))
+			);
+		}
+		save_png(out_file, glm::uvec2(size, size), data.data(), LowerLeftOrigin);
+	} else {
+		std::vector< uint8_t > data;
+		data.reserve(lut.size() * 4);
+		for (auto const &v : lut) {
+			for (uint16_t h : {float_to_half(v.x), float_to_half(v.y)}) {
+				data.emplace_back(uint8_t(h & 0xff));
+				data.emplace_back(uint8_t(h >> 8));
+			}
+		}
+		std::ofstream out(out_file, std::ios::binary);
+		out.write(reinterpret_cast< char const * >(data.data()), data.size());
+		if (!out) {
+			throw std::runtime_error("Failed to write '" + out_file + "'.");
+		}
+	}
+	std::cout << "Wrote '" << out_file << "'." << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,737 @@
+#include "cube_blur.hpp"
+#include "cube_faces.hpp"
+#include "cube_lookup.hpp"
+#include "ThreadPool.hpp"
+
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <cassert>
+#include <cmath>
+
+//(integral of the projected area element; see, e.g., "Cubemap Texel Solid Angle" by Rory Driscoll)
+float texel_solid_angle(uint32_t s, uint32_t t, uint32_t size) {
+	auto area = [](float x, float y) -> float {
+		return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+	};
+	float x0 = 2.0f * s / size - 1.0f;
+	float x1 = 2.0f * (s + 1) / size - 1.0f;
+	float y0 = 2.0f * t / size - 1.0f;
+	float y1 = 2.0f * (t + 1) / size - 1.0f;
+	return area(x0, y0) - area(x0, y1) - area(x1, y0) + area(x1, y1);
+}
+
+//real, orthonormal spherical harmonics for bands [0,bands), evaluated at a (unit) direction:
+// output is indexed by l*(l+1)+m, for m in [-l,l]; z is the polar axis.
+void eval_sh(uint32_t bands, glm::vec3 const &dir, float *out) {
+	//cm + i*sm tracks (x + i*y)^m, which is sin(theta)^m * (cos(m*phi) + i*sin(m*phi)):
+	float cm = 1.0f;
+	float sm = 0.0f;
+	float p_mm = 1.0f; //(2m-1)!!, the polynomial part of the associated Legendre P_m^m
+	for (uint32_t m = 0; m < bands; ++m) {
+		float p_l2 = 0.0f; //P_{l-2}^m
+		float p_l1 = 0.0f; //P_{l-1}^m
+		for (uint32_t l = m; l < bands; ++l) {
+			float p;
+			if (l == m) p = p_mm;
+			else if (l == m + 1) p = dir.z * (2 * m + 1) * p_mm;
+			else p = ((2 * l - 1) * dir.z * p_l1 - (l + m - 1) * p_l2) / float(l - m);
+			p_l2 = p_l1;
+			p_l1 = p;
+
+			//normalization, sqrt( (2l+1)/(4pi) * (l-m)!/(l+m)! ):
+			double k = (2 * l + 1) / (4.0 * M_PI);
+			for (uint32_t i = l - m + 1; i <= l + m; ++i) k /= double(i);
+			k = std::sqrt(k);
+
+			if (m == 0) {
+				out[l * (l + 1)] = float(k) * p;
+			} else {
+				out[l * (l + 1) + m] = float(std::sqrt(2.0) * k) * p * cm;
+				out[l * (l + 1) - m] = float(std::sqrt(2.0) * k) * p * sm;
+			}
+		}
+		p_mm *= float(2 * m + 1);
+		float c = cm * dir.x - sm * dir.y;
+		sm = cm * dir.y + sm * dir.x;
+		cm = c;
+	}
+}
+
+//scale applied to band l by convolving with a clamped cosine lobe and dividing by pi
+// (that is, turns radiance coefficients into coefficients of the exit radiance of a white lambertian surface):
+// see Ramamoorthi and Hanrahan, "An Efficient Representation for Irradiance Environment Maps"
+double sh_cosine_band_scale(uint32_t l) {
+	if (l == 0) return 1.0;
+	if (l == 1) return 2.0 / 3.0;
+	if (l % 2 == 1) return 0.0;
+	//2 * (-1)^(l/2-1) / ((l+2)(l-1)) * l! / (2^l ((l/2)!)^2):
+	double ret = 2.0 / double((l + 2) * (l - 1));
+	if ((l / 2) % 2 == 0) ret = -ret;
+	for (uint32_t i = 1; i <= l; ++i) ret *= double(i) / 2.0;
+	for (uint32_t i = 1; i <= l / 2; ++i) ret /= double(i) * double(i);
+	return ret;
+}
+
+std::string level_filename(std::string const &filename, uint32_t level) {
+	if (level == 0) return filename;
+	auto dot = filename.rfind('.');
+	if (dot == std::string::npos || filename.find('/', dot) != std::string::npos) dot = filename.size();
+	return filename.substr(0, dot) + "." + std::to_string(level) + filename.substr(dot);
+}
+
+//integer hash (a.k.a. "lowbias32" from https://nullprogram.com/blog/2018/07/31/):
+uint32_t hash_u32(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+uint32_t reverse_bits(uint32_t bits) {
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555U) << 1) | ((bits & 0xAAAAAAAAU) >> 1);
+	bits = ((bits & 0x33333333U) << 2) | ((bits & 0xCCCCCCCCU) >> 2);
+	bits = ((bits & 0x0F0F0F0FU) << 4) | ((bits & 0xF0F0F0F0U) >> 4);
+	bits = ((bits & 0x00FF00FFU) << 8) | ((bits & 0xFF00FF00U) >> 8);
+	return bits;
+}
+
+glm::vec2 sample_point(Sampler sampler, uint32_t i, uint32_t count, uint32_t seed) {
+	//keep 24 bits so results stay below 1.0f:
+	auto to_unit = [](uint32_t bits) -> float {
+		return float(bits >> 8) * (1.0f / float(1 << 24));
+	};
+	uint32_t sx = hash_u32(seed);
+	uint32_t sy = hash_u32(sx ^ 0x9e3779b9U);
+	if (sampler == SamplerRandom) {
+		uint32_t h = hash_u32(sx + i);
+		return glm::vec2(to_unit(h), to_unit(hash_u32(h ^ sy)));
+	} else if (sampler == SamplerHammersley) {
+		//Cranley-Patterson rotation of i/count, random digit scrambling of the radical inverse:
+		float x = float(i) / float(count) + to_unit(sx);
+		if (x >= 1.0f) x -= 1.0f;
+		return glm::vec2(x, to_unit(reverse_bits(i) ^ sy));
+	} else if (sampler == SamplerSobol) {
+		//dimension 0 is the radical inverse; dimension 1 uses direction numbers v_k = v_{k-1} ^ (v_{k-1} >> 1):
+		uint32_t y = 0;
+		uint32_t v = 0x80000000U;
+		for (uint32_t b = i; b; b >>= 1) {
+			if (b & 1) y ^= v;
+			v ^= v >> 1;
+		}
+		return glm::vec2(to_unit(reverse_bits(i) ^ sx), to_unit(y ^ sy));
+	} else {
+		assert(0 && "Invalid sampler.");
+		return glm::vec2(0.0f);
+	}
+}
+
+CubeMips::CubeMips(uint32_t size, std::vector< glm::vec3 > const &data) {
+	levels.emplace_back();
+	levels.back().size = size;
+	levels.back().data = data;
+	while (levels.back().size > 1) {
+		Level const &src = levels.back();
+		Level dst;
+		dst.size = (src.size + 1) / 2;
+		dst.data.reserve(6 * dst.size * dst.size);
+		for (uint32_t f = 0; f < 6; ++f) {
+			glm::vec3 const *face = src.data.data() + f * src.size * src.size;
+			for (uint32_t t = 0; t < dst.size; ++t) {
+				uint32_t t0 = 2 * t;
+				uint32_t t1 = std::min(2 * t + 1, src.size - 1);
+				for (uint32_t s = 0; s < dst.size; ++s) {
+					uint32_t s0 = 2 * s;
+					uint32_t s1 = std::min(2 * s + 1, src.size - 1);
+					dst.data.emplace_back(0.25f * (
+						  face[t0 * src.size + s0] + face[t0 * src.size + s1]
+						+ face[t1 * src.size + s0] + face[t1 * src.size + s1]
+					));
+				}
+			}
+		}
+		levels.emplace_back(std::move(dst));
+	}
+}
+
+glm::vec3 CubeMips::lookup(glm::vec3 const &dir, float lod) const {
+	glm::vec2 st;
+	uint32_t f = direction_to_face(dir, &st);
+	return lookup(f, st, lod);
+}
+
+void CubeMips::lookup_n(float const *x, float const *y, float const *z, float const *lod, size_t count, glm::vec3 *out) const {
+	//faces and positions for a batch at a time, then the (per-lane) filtering:
+	uint32_t face[LookupBatch];
+	float s[LookupBatch], t[LookupBatch];
+	for (size_t i = 0; i < count; i += LookupBatch) {
+		size_t n = std::min< size_t >(LookupBatch, count - i);
+		direction_to_face_n(x + i, y + i, z + i, n, face, s, t);
+		for (size_t j = 0; j < n; ++j) {
+			out[i + j] = lookup(face[j], glm::vec2(s[j], t[j]), lod[i + j]);
+		}
+	}
+}
+
+glm::vec3 CubeMips::lookup(uint32_t f, glm::vec2 st, float lod) const {
+	lod = std::max(0.0f, std::min(float(levels.size() - 1), lod));
+	uint32_t l0 = uint32_t(lod);
+	uint32_t l1 = std::min(l0 + 1, uint32_t(levels.size() - 1));
+	float a = lod - float(l0);
+	glm::vec3 ret = bilinear(levels[l0], f, st);
+	if (a > 0.0f) ret = (1.0f - a) * ret + a * bilinear(levels[l1], f, st);
+	return ret;
+}
+
+glm::vec3 CubeMips::bilinear(Level const &l, uint32_t f, glm::vec2 st) {
+	int32_t size = int32_t(l.size);
+	glm::vec3 const *face = l.data.data() + f * l.size * l.size;
+	float fx = st.x * size - 0.5f;
+	float fy = st.y * size - 0.5f;
+	float ax = fx - std::floor(fx);
+	float ay = fy - std::floor(fy);
+	int32_t x0 = std::max(0, std::min(size - 1, int32_t(std::floor(fx))));
+	int32_t x1 = std::max(0, std::min(size - 1, int32_t(std::floor(fx)) + 1));
+	int32_t y0 = std::max(0, std::min(size - 1, int32_t(std::floor(fy))));
+	int32_t y1 = std::max(0, std::min(size - 1, int32_t(std::floor(fy)) + 1));
+	return (1.0f - ay) * ((1.0f - ax) * face[y0 * size + x0] + ax * face[y0 * size + x1])
+	     +         ay  * ((1.0f - ax) * face[y1 * size + x0] + ax * face[y1 * size + x1]);
+}
+
+//see Krivanek and Colbert, "Real-time Shading with Filtered Importance Sampling" (2008)
+float CubeMips::lod_for(float pdf, uint32_t count) const {
+	if (!(pdf > 0.0f)) return 0.0f; //delta distribution; no filtering
+	float sample_solid_angle = 1.0f / (float(count) * pdf);
+	float texel_solid_angle = 4.0f * float(M_PI) / (6.0f * levels[0].size * levels[0].size);
+	return std::max(0.0f, 0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f);
+}
+
+void LightTree::build(std::vector< BrightDirection > const &from) {
+	//key each light by face and (interleaved) finest cell:
+	std::vector< std::pair< uint64_t, uint32_t > > keys;
+	keys.reserve(from.size());
+	for (auto const &bd : from) {
+		glm::vec3 const &dir = bd.direction;
+		glm::vec2 st;
+		uint32_t f = direction_to_face(dir, &st);
+		constexpr int32_t Cells = 1 << MaxDepth;
+		int32_t s = std::max(0, std::min(Cells - 1, int32_t(std::floor(st.x * Cells))));
+		int32_t t = std::max(0, std::min(Cells - 1, int32_t(std::floor(st.y * Cells))));
+		uint64_t key = uint64_t(f) << (2 * MaxDepth);
+		for (uint32_t b = 0; b < MaxDepth; ++b) {
+			key |= uint64_t((s >> b) & 1) << (2 * b);
+			key |= uint64_t((t >> b) & 1) << (2 * b + 1);
+		}
+		keys.emplace_back(key, uint32_t(keys.size()));
+	}
+	std::sort(keys.begin(), keys.end());
+	lights.clear();
+	lights.reserve(from.size());
+	for (auto const &k : keys) {
+		lights.emplace_back(from[k.second]);
+	}
+
+	nodes.assign(6, Node());
+	uint32_t at = 0;
+	for (uint32_t f = 0; f < 6; ++f) {
+		uint32_t end = at;
+		while (end < keys.size() && (keys[end].first >> (2 * MaxDepth)) == f) ++end;
+		build_node(f, f, 0, 0, 0, at, end, keys);
+		at = end;
+	}
+	glm::vec3 total = glm::vec3(0.0f);
+	for (uint32_t f = 0; f < 6; ++f) total += nodes[f].light;
+	max_total = std::max(total.r, std::max(total.g, total.b));
+}
+
+void LightTree::build_node(uint32_t index, uint32_t f, uint32_t depth, uint32_t s, uint32_t t, uint32_t begin, uint32_t end, std::vector< std::pair< uint64_t, uint32_t > > const &keys) {
+	{ //bounding cone of the cell's patch of the face (farthest point from center is a corner):
+		glm::vec3 sc, tc, ma;
+		face_basis(f, &sc, &tc, &ma);
+		float cell = 2.0f / float(1 << depth);
+		float u0 = -1.0f + s * cell, v0 = -1.0f + t * cell;
+		Node &node = nodes[index];
+		node.center = glm::normalize(ma + (u0 + 0.5f * cell) * sc + (v0 + 0.5f * cell) * tc);
+		node.cos_radius = 1.0f;
+		for (uint32_t c = 0; c < 4; ++c) {
+			glm::vec3 corner = glm::normalize(ma + (u0 + (c & 1) * cell) * sc + (v0 + (c >> 1) * cell) * tc);
+			node.cos_radius = std::min(node.cos_radius, glm::dot(node.center, corner));
+		}
+		node.sin_radius = std::sqrt(std::max(0.0f, 1.0f - node.cos_radius * node.cos_radius));
+		node.begin = begin;
+		node.end = end;
+		for (uint32_t i = begin; i < end; ++i) {
+			node.r_dir += lights[i].light.r * lights[i].direction;
+			node.g_dir += lights[i].light.g * lights[i].direction;
+			node.b_dir += lights[i].light.b * lights[i].direction;
+			node.light += lights[i].light;
+		}
+	}
+	if (end - begin <= LeafSize || depth == MaxDepth) return;
+
+	uint32_t first_child = uint32_t(nodes.size());
+	nodes[index].first_child = first_child;
+	nodes.resize(nodes.size() + 4);
+	//children split [begin,end) by the next two key bits (t, s) below this depth:
+	uint32_t shift = 2 * (MaxDepth - depth - 1);
+	uint32_t at = begin;
+	for (uint32_t c = 0; c < 4; ++c) {
+		uint32_t child_end = at;
+		while (child_end < end && ((keys[child_end].first >> shift) & 3) == c) ++child_end;
+		build_node(first_child + c, f, depth + 1, 2 * s + (c & 1), 2 * t + (c >> 1), at, child_end, keys);
+		at = child_end;
+	}
+}
+
+glm::vec3 LightTree::sum_cosine(glm::vec3 const &n) const {
+	glm::vec3 ret = glm::vec3(0.0f);
+	uint32_t stack[4 * MaxDepth + 6];
+	uint32_t top = 0;
+	for (uint32_t f = 0; f < 6; ++f) stack[top++] = f;
+	while (top) {
+		Node const &node = nodes[stack[--top]];
+		if (node.begin == node.end) continue;
+		float c = glm::dot(n, node.center);
+		if (c <= -node.sin_radius) continue; //entirely below horizon
+		if (c >= node.sin_radius) { //entirely above horizon
+			ret += glm::vec3(glm::dot(node.r_dir, n), glm::dot(node.g_dir, n), glm::dot(node.b_dir, n));
+		} else if (node.first_child) {
+			for (uint32_t i = 0; i < 4; ++i) stack[top++] = node.first_child + i;
+		} else {
+			for (uint32_t i = node.begin; i < node.end; ++i) {
+				ret += std::max(0.0f, glm::dot(lights[i].direction, n)) * lights[i].light;
+			}
+		}
+	}
+	return ret;
+}
+
+glm::vec3 LightTree::sum_cone(glm::vec3 const &n, float cos_angle, float sin_angle) const {
+	glm::vec3 ret = glm::vec3(0.0f);
+	uint32_t stack[4 * MaxDepth + 6];
+	uint32_t top = 0;
+	for (uint32_t f = 0; f < 6; ++f) stack[top++] = f;
+	while (top) {
+		Node const &node = nodes[stack[--top]];
+		if (node.begin == node.end) continue;
+		//cos(angle + radius):
+		if (glm::dot(n, node.center) < cos_angle * node.cos_radius - sin_angle * node.sin_radius) continue;
+		if (node.first_child) {
+			for (uint32_t i = 0; i < 4; ++i) stack[top++] = node.first_child + i;
+		} else {
+			for (uint32_t i = node.begin; i < node.end; ++i) {
+				if (glm::dot(lights[i].direction, n) > cos_angle) {
+					ret += lights[i].light;
+				}
+			}
+		}
+	}
+	return ret;
+}
+
+//Blur kernels describe one output texel's lobe, in a frame where the normal is +z:
+//  sample(rv) maps a point in [0,1)^2 to a direction
+//  weight(dir) is how much that sample counts (samples with weight <= 0 are skipped)
+//  pdf(dir) is the density (per steradian) of sample directions, or zero if not filterable
+//  bright(n, mean_weight) is the contribution of separated bright directions at (world space) normal n
+// They are plain structs so that blur_faces<> compiles each one into its own inner loop.
+
+struct DiffuseKernel {
+	LightTree const &bright_tree;
+	explicit DiffuseKernel(LightTree const &bright_tree_) : bright_tree(bright_tree_) { }
+	glm::vec3 sample(glm::vec2 rv) const {
+		//attempt to importance sample upper hemisphere (cos-weighted):
+		//based on: http://www.rorydriscoll.com/2009/01/07/better-sampling/
+		float phi = rv.x * 2.0f * M_PI;
+		float r = std::sqrt(rv.y);
+		return glm::vec3(
+			std::cos(phi) * r,
+			std::sin(phi) * r,
+			std::sqrt(1.0f - rv.y)
+		);
+	}
+	float weight(glm::vec3 const &) const { return 1.0f; }
+	float pdf(glm::vec3 const &dir) const { return dir.z / float(M_PI); }
+	glm::vec3 bright(glm::vec3 const &n, float) const { return bright_tree.sum_cosine(n); }
+};
+
+struct BokehKernel {
+	LightTree const &bright_tree;
+	float min_y;
+	float thresh; //hmmmmmmm
+	float sin_thresh;
+	BokehKernel(LightTree const &bright_tree_, float angle) : bright_tree(bright_tree_) {
+		float max_r = std::sin(angle);
+		min_y = std::sqrt(1.0f - max_r * max_r);
+		thresh = std::cos(angle);
+		sin_thresh = std::sin(angle);
+	}
+	glm::vec3 sample(glm::vec2 rv) const {
+		//try to uniformly sample a disc...
+		float phi = rv.x * 2.0f * M_PI;
+		//float r = max_r * std::sqrt(rv.y);
+		rv.y = min_y + (1.0f - min_y) * rv.y;
+		float r = std::sqrt(1.0f - rv.y * rv.y);
+		return glm::vec3(
+			std::cos(phi) * r,
+			std::sin(phi) * r,
+			rv.y
+		);
+	}
+	float weight(glm::vec3 const &) const { return 1.0f; }
+	float pdf(glm::vec3 const &) const { return 1.0f / (2.0f * float(M_PI) * (1.0f - min_y)); }
+	glm::vec3 bright(glm::vec3 const &n, float) const { return bright_tree.sum_cone(n, thresh, sin_thresh); }
+};
+
+struct SharpKernel {
+	glm::vec3 sample(glm::vec2) const { return glm::vec3(0.0f, 0.0f, 1.0f); }
+	float weight(glm::vec3 const &) const { return 1.0f; }
+	float pdf(glm::vec3 const &) const { return 0.0f; }
+	glm::vec3 bright(glm::vec3 const &, float) const { return glm::vec3(0.0f); }
+};
+
+//split-sum pre-filtered specular (see "Real Shading in Unreal Engine 4", Karis 2013):
+// integrates the GGX lobe for a given roughness assuming n = v = r, weighted by n.l
+struct GGXKernel {
+	LightTree const &bright_tree;
+	float alpha2;
+	//bright tree nodes are skipped when they can add at most LightTolerance of the all-light total (weighted by the lobe's peak):
+	static constexpr float LightTolerance = 1e-6f;
+	float skip_below;
+	GGXKernel(LightTree const &bright_tree_, float roughness) : bright_tree(bright_tree_) {
+		float alpha = roughness * roughness;
+		alpha2 = alpha * alpha;
+		skip_below = LightTolerance * D(1.0f) * bright_tree.max_total;
+	}
+	float D(float NoH) const {
+		float d = NoH * NoH * (alpha2 - 1.0f) + 1.0f;
+		return alpha2 / (float(M_PI) * d * d);
+	}
+	glm::vec3 sample(glm::vec2 rv) const {
+		//importance sample the half vector from the GGX distribution:
+		float phi = rv.x * 2.0f * M_PI;
+		float cos_theta = std::sqrt((1.0f - rv.y) / (1.0f + (alpha2 - 1.0f) * rv.y));
+		float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+		glm::vec3 H = glm::vec3(std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta);
+		//reflect view (= normal) about half vector:
+		return 2.0f * H.z * H - glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+	float weight(glm::vec3 const &L) const { return L.z; }
+	float pdf(glm::vec3 const &L) const {
+		//density of L is D(h) / 4 (since n = v), and n.h^2 = (1 + n.l) / 2:
+		return 0.25f * D(std::sqrt(0.5f * (1.0f + L.z)));
+	}
+	glm::vec3 bright(glm::vec3 const &n, float mean_weight) const {
+		//bright directions, weighted the same way as the samples would weight them:
+		// sample density is D(h) / 4 per steradian, so each light adds D(h) / 4 * n.l * light,
+		// divided by the expected n.l of a sample:
+		glm::vec3 ret = glm::vec3(0.0f);
+		uint32_t stack[4 * LightTree::MaxDepth + 6];
+		uint32_t top = 0;
+		for (uint32_t f = 0; f < 6; ++f) stack[top++] = f;
+		while (top) {
+			LightTree::Node const &node = bright_tree.nodes[stack[--top]];
+			if (node.begin == node.end) continue;
+			float c = glm::dot(n, node.center);
+			if (c <= -node.sin_radius) continue; //entirely below horizon
+			//the lobe falls off away from n, so no light under the node is weighted more than one at the node's nearest point:
+			// (n.l there is cos(angle to center - radius), or 1 if n is inside the node's cone)
+			float near_NoL = 1.0f;
+			if (c < node.cos_radius) {
+				near_NoL = c * node.cos_radius + std::sqrt(std::max(0.0f, 1.0f - c * c)) * node.sin_radius;
+			}
+			float most = D(std::sqrt(0.5f * (1.0f + near_NoL))) * near_NoL * std::max(node.light.r, std::max(node.light.g, node.light.b));
+			if (most < skip_below) continue;
+			if (node.first_child) {
+				for (uint32_t i = 0; i < 4; ++i) stack[top++] = node.first_child + i;
+			} else {
+				for (uint32_t i = node.begin; i < node.end; ++i) {
+					BrightDirection const &bd = bright_tree.lights[i];
+					float NoL = glm::dot(n, bd.direction);
+					if (NoL <= 0.0f) continue;
+					float NoH = glm::dot(n, glm::normalize(n + bd.direction));
+					ret += (0.25f * D(NoH) * NoL / mean_weight) * bd.light;
+				}
+			}
+		}
+		return ret;
+	}
+};
+
+//type-erased kernel that dispatches through std::function (as blur_cube once did); kept for --benchmark comparisons:
+struct FunctionKernel {
+	template< typename Kernel >
+	explicit FunctionKernel(Kernel const &kernel) :
+		sample_fn([&kernel](glm::vec2 rv) { return kernel.sample(rv); }),
+		weight_fn([&kernel](glm::vec3 const &dir) { return kernel.weight(dir); }),
+		pdf_fn([&kernel](glm::vec3 const &dir) { return kernel.pdf(dir); }),
+		bright_fn([&kernel](glm::vec3 const &n, float mean_weight) { return kernel.bright(n, mean_weight); }) { }
+	std::function< glm::vec3(glm::vec2) > sample_fn;
+	std::function< float(glm::vec3 const &) > weight_fn;
+	std::function< float(glm::vec3 const &) > pdf_fn;
+	std::function< glm::vec3(glm::vec3 const &, float) > bright_fn;
+	glm::vec3 sample(glm::vec2 rv) const { return sample_fn(rv); }
+	float weight(glm::vec3 const &dir) const { return weight_fn(dir); }
+	float pdf(glm::vec3 const &dir) const { return pdf_fn(dir); }
+	glm::vec3 bright(glm::vec3 const &n, float mean_weight) const { return bright_fn(n, mean_weight); }
+};
+//sample every texel of a size x size cube (or octahedral map) with 'kernel', filling *out (faces in order):
+// lookup(n, x, y, z, pdf, count, out) reads the input for n of a texel's 'count' samples at once,
+//  given their directions (as arrays, see cube_lookup.hpp) and the densities 'pdf' they were drawn with
+// seeds for sample_point() are seed_base + texel index, so results do not depend on how rows are scheduled (or sharded)
+// only rows in 'shard' are sampled; the rest stay zero
+template< typename Kernel, typename Lookup >
+void blur_faces(Kernel const &kernel, Lookup const &lookup, Sampler sampler, uint32_t size, uint32_t samples, uint32_t seed_base, std::vector< glm::vec3 > *out_, ThreadPool *pool, Layout layout, Shard shard) {
+	assert(out_);
+	auto &out = *out_;
+	TexelDirections directions(layout, size);
+	uint32_t rows = directions.faces * size;
+	out.assign(rows * size, glm::vec3(0.0f));
+	uint32_t row_begin = shard.begin(rows);
+	uint32_t row_end = shard.end(rows);
+
+	auto blur_row = [&](uint32_t row) {
+		uint32_t f = row / size;
+		uint32_t t = row % size;
+		for (uint32_t s = 0; s < size; ++s) {
+			glm::vec3 N = glm::normalize(directions(f, s + 0.5f, t + 0.5f));
+			glm::vec3 temp = (std::abs(N.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f));
+			glm::vec3 TX = glm::normalize(glm::cross(N, temp));
+			glm::vec3 TY = glm::cross(N, TX);
+
+			uint32_t seed = seed_base + row * size + s;
+			glm::vec3 acc = glm::vec3(0.0f);
+			float weight = 0.0f;
+			//samples are drawn a batch at a time, then looked up together:
+			float x[LookupBatch], y[LookupBatch], z[LookupBatch], pdf[LookupBatch], w[LookupBatch];
+			glm::vec3 value[LookupBatch];
+			for (uint32_t i = 0; i < samples; /* later */) {
+				uint32_t n = 0;
+				for (; i < samples && n < LookupBatch; ++i) {
+					//very inspired by the SampleGGX code in "Real Shading in Unreal" (https://cdn2.unrealengine.com/Resources/files/2013SiggraphPresentationsNotes-26915738.pdf):
+					glm::vec3 dir = kernel.sample(sample_point(sampler, i, samples, seed));
+					w[n] = kernel.weight(dir);
+					if (w[n] <= 0.0f) continue;
+					glm::vec3 world = dir.x * TX + dir.y * TY + dir.z * N;
+					x[n] = world.x;
+					y[n] = world.y;
+					z[n] = world.z;
+					pdf[n] = kernel.pdf(dir);
+					++n;
+				}
+				lookup(n, x, y, z, pdf, samples, value);
+				for (uint32_t j = 0; j < n; ++j) {
+					acc += value[j] * w[j];
+					weight += w[j];
+				}
+			}
+			if (weight > 0.0f) {
+				acc *= 1.0f / weight;
+				acc += kernel.bright(N, weight / float(samples));
+			}
+			out[row * size + s] = acc;
+		}
+	};
+
+	if (pool) {
+		pool->parallel_for(row_end - row_begin, [&](uint32_t i) { blur_row(row_begin + i); });
+	} else {
+		for (uint32_t row = row_begin; row < row_end; ++row) blur_row(row);
+	}
+}
+
+//center direction of texel (s,t) on face f of a size x size cube:
+static glm::vec3 texel_direction(uint32_t f, uint32_t s, uint32_t t, uint32_t size) {
+	return glm::normalize(TexelDirections(LayoutCube, size)(f, s + 0.5f, t + 0.5f));
+}
+
+BlurInput::BlurInput(uint32_t size_, std::vector< glm::vec3 > const &sharp_, bool separate_bright, BlurSettings const &settings_)
+	: size(size_), settings(settings_), sharp(sharp_), data(separate_bright ? separated : sharp_) {
+	assert(sharp.size() == 6 * size * size);
+
+	if (separate_bright) {
+		separated = sharp;
+		uint32_t bright = std::min< uint32_t >(separated.size(), settings.brightest);
+		std::vector< std::pair< float, uint32_t > > pixels;
+		pixels.reserve(separated.size());
+		for (auto const &px : separated) {
+			pixels.emplace_back(std::max(px.r, std::max(px.g, px.b)), pixels.size());
+		}
+		//only the brightest need to be found (not fully sorted):
+		std::nth_element(pixels.begin(), pixels.begin() + bright, pixels.end(), std::greater< std::pair< float, uint32_t > >());
+		for (uint32_t b = 0; b < bright; ++b) {
+			uint32_t i = pixels[b].second;
+			uint32_t s = i % size;
+			uint32_t t = (i / size) % size;
+			uint32_t f = i / (size * size);
+
+			bright_directions.emplace_back();
+			bright_directions.back().direction = texel_direction(f, s, t, size);
+			float solid_angle = 4.0f * M_PI / float(6.0f * size * size); // approximate, since pixels on cube actually take up different amounts depending on position
+			bright_directions.back().light = separated[i] * solid_angle;
+
+			separated[i] = glm::vec3(0.0f, 0.0f, 0.0f); //remove from input data
+		}
+		bright_tree.build(bright_directions);
+	}
+
+	//filtered lookups read from a mip pyramid of the (bright-pixel-removed) input:
+	if (settings.mip_lookup) {
+		mips.reset(new CubeMips(size, data));
+	}
+}
+
+glm::vec3 BlurInput::nearest(std::vector< glm::vec3 > const &from, glm::vec3 const &dir) const {
+	glm::vec2 st;
+	uint32_t f = direction_to_face(dir, &st);
+	return from[cube_texel_index(size, f, st)];
+}
+
+//run blur_faces with 'kernel' (or its type-erased version), reading samples from 'input':
+template< typename Kernel >
+static void blur_with(BlurInput const &input, Kernel const &kernel, uint32_t samples, uint32_t size, uint32_t seed_base, std::vector< glm::vec3 > *out, ThreadPool *pool, Layout layout, Shard shard) {
+	//function for looking up n of 'count' samples drawn with densities 'pdf':
+	auto lookup_sample = [&input](uint32_t n, float const *x, float const *y, float const *z, float const *pdf, uint32_t count, glm::vec3 *out) {
+		if (input.mips) {
+			float lod[LookupBatch];
+			for (uint32_t i = 0; i < n; ++i) lod[i] = input.mips->lod_for(pdf[i], count);
+			input.mips->lookup_n(x, y, z, lod, n, out);
+		} else {
+			cube_nearest_n(input.data.data(), input.size, x, y, z, n, out);
+		}
+	};
+	if (input.settings.function_dispatch) {
+		blur_faces(FunctionKernel(kernel), lookup_sample, input.settings.sampler, size, samples, seed_base, out, pool, layout, shard);
+	} else {
+		blur_faces(kernel, lookup_sample, input.settings.sampler, size, samples, seed_base, out, pool, layout, shard);
+	}
+}
+
+void blur_cube(BlurInput const &input, BlurMode mode, uint32_t samples, uint32_t out_size, std::vector< glm::vec3 > *out, ThreadPool *pool, Layout layout, Shard shard) {
+	if (mode == BlurDiffuse) blur_with(input, DiffuseKernel(input.bright_tree), samples, out_size, 0, out, pool, layout, shard);
+	else if (mode == BlurBokeh) blur_with(input, BokehKernel(input.bright_tree, 0.7f / 180.0f * float(M_PI)), samples, out_size, 0, out, pool, layout, shard);
+	else if (mode == BlurSharp) blur_with(input, SharpKernel(), samples, out_size, 0, out, pool, layout, shard);
+	else assert(0 && "Invalid blur mode.");
+}
+
+uint32_t ggx_levels(uint32_t out_size) {
+	uint32_t levels = 1;
+	while ((out_size >> levels) > 0) ++levels;
+	return levels;
+}
+
+void blur_ggx_level(BlurInput const &input, uint32_t level, uint32_t samples, uint32_t out_size, std::vector< glm::vec3 > *out_, ThreadPool *pool, Layout layout, Shard shard) {
+	assert(out_);
+	auto &out = *out_;
+	//roughness increases linearly per level:
+	uint32_t levels = ggx_levels(out_size);
+	assert(level < levels);
+	uint32_t size = std::max(1U, out_size >> level);
+	float roughness = (levels > 1 ? float(level) / float(levels - 1) : 0.0f);
+
+	if (level == 0) {
+		//level 0 is a mirror, so it samples the input before bright pixels are removed:
+		TexelDirections directions(layout, size);
+		uint32_t rows = directions.faces * size;
+		out.assign(rows * size, glm::vec3(0.0f));
+		for (uint32_t row = shard.begin(rows); row < shard.end(rows); ++row) {
+			uint32_t f = row / size;
+			uint32_t t = row % size;
+			for (uint32_t s = 0; s < size; ++s) {
+				out[row * size + s] = input.nearest(input.sharp, glm::normalize(directions(f, s + 0.5f, t + 0.5f)));
+			}
+		}
+	} else {
+		blur_with(input, GGXKernel(input.bright_tree, roughness), samples, size, level * 6 * size * size, &out, pool, layout, shard);
+	}
+}
+
+void project_sh(uint32_t bands, uint32_t size, std::vector< glm::vec3 > const &data, std::vector< glm::dvec3 > *coefs_, ThreadPool *pool) {
+	assert(coefs_);
+	auto &coefs = *coefs_;
+	assert(data.size() == 6 * size * size);
+	uint32_t count = bands * bands;
+
+	//project radiance onto the basis, weighting each texel by the solid angle it actually covers:
+	// (rows are summed separately then added up in order, so results do not depend on thread count)
+	std::vector< glm::dvec3 > row_coefs(6 * size * count, glm::dvec3(0.0));
+	auto project_row = [&](uint32_t row) {
+		uint32_t f = row / size;
+		uint32_t t = row % size;
+		std::vector< float > Y(count);
+		glm::dvec3 *acc = row_coefs.data() + row * count;
+		for (uint32_t s = 0; s < size; ++s) {
+			eval_sh(bands, texel_direction(f, s, t, size), Y.data());
+			glm::dvec3 px = glm::dvec3(data[row * size + s]) * double(texel_solid_angle(s, t, size));
+			for (uint32_t i = 0; i < count; ++i) {
+				acc[i] += px * double(Y[i]);
+			}
+		}
+	};
+	if (pool) {
+		pool->parallel_for(6 * size, project_row);
+	} else {
+		for (uint32_t row = 0; row < 6 * size; ++row) project_row(row);
+	}
+
+	coefs.assign(count, glm::dvec3(0.0));
+	for (uint32_t row = 0; row < 6 * size; ++row) {
+		for (uint32_t i = 0; i < count; ++i) {
+			coefs[i] += row_coefs[row * count + i];
+		}
+	}
+	//convolve with the cosine lobe (scaled to match 'diffuse' mode):
+	for (uint32_t l = 0; l < bands; ++l) {
+		for (uint32_t i = l * l; i < (l + 1) * (l + 1); ++i) {
+			coefs[i] *= sh_cosine_band_scale(l);
+		}
+	}
+}
+
+void save_sh(std::string const &filename, std::vector< glm::dvec3 > const &coefs) {
+	std::ofstream sh_out(filename);
+	sh_out << "#" << coefs.size() << " real spherical harmonics coefficients (index l*(l+1)+m, z is polar axis)\n";
+	sh_out << "#of cosine-convolved radiance divided by pi (the same scale as 'diffuse' blur output)\n";
+	sh_out << coefs.size() << "\n";
+	sh_out.precision(9);
+	for (auto const &c : coefs) {
+		sh_out << c.r << " " << c.g << " " << c.b << "\n";
+	}
+	if (!sh_out) {
+		throw std::runtime_error("Failed to write '" + filename + "'.");
+	}
+}
+
+void reconstruct_sh(std::vector< glm::dvec3 > const &coefs, uint32_t out_size, std::vector< glm::vec3 > *out_, ThreadPool *pool, Layout layout) {
+	assert(out_);
+	auto &out = *out_;
+	uint32_t bands = uint32_t(std::round(std::sqrt(double(coefs.size()))));
+	assert(bands * bands == coefs.size());
+	uint32_t count = bands * bands;
+
+	std::vector< glm::vec3 > fcoefs(coefs.begin(), coefs.end());
+	TexelDirections directions(layout, out_size);
+	uint32_t rows = directions.faces * out_size;
+	out.assign(rows * out_size, glm::vec3(0.0f));
+	auto reconstruct_row = [&](uint32_t row) {
+		uint32_t f = row / out_size;
+		uint32_t t = row % out_size;
+		std::vector< float > Y(count);
+		for (uint32_t s = 0; s < out_size; ++s) {
+			eval_sh(bands, glm::normalize(directions(f, s + 0.5f, t + 0.5f)), Y.data());
+			glm::vec3 acc = glm::vec3(0.0f);
+			for (uint32_t i = 0; i < count; ++i) {
+				acc += fcoefs[i] * Y[i];
+			}
+			out[row * out_size + s] = glm::max(acc, glm::vec3(0.0f));
+		}
+	};
+	if (pool) {
+		pool->parallel_for(rows, reconstruct_row);
+	} else {
+		for (uint32_t row = 0; row < rows; ++row) reconstruct_row(row);
+	}
+}
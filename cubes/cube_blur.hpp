@@ -0,0 +1,162 @@
+#pragma once
+
+#include "cube_faces.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct ThreadPool;
+
+//Blurring of cube maps held as linear floating point data (faces stacked as in cube_faces.hpp).
+// Used by blur_cube (one blur per run) and ibl_bake (many blurs of one input).
+
+//solid angle covered by texel (s,t) of a face with size x size texels:
+float texel_solid_angle(uint32_t s, uint32_t t, uint32_t size);
+
+//filename for mip level 'level' of a cube stored in 'filename':
+// level 0 is 'filename' itself, others get '.level' inserted before the extension (e.g. out.png -> out.3.png)
+std::string level_filename(std::string const &filename, uint32_t level);
+
+//sample point generators for per-texel integration:
+enum Sampler {
+	SamplerRandom, //hashed white noise
+	SamplerHammersley, //Hammersley set, rotated/scrambled per texel
+	SamplerSobol, //first two Sobol dimensions, scrambled per texel
+};
+
+//i-th of 'count' points in [0,1)^2 from 'sampler':
+// 'seed' should differ per texel, so that neighboring texels don't share (structured) error
+glm::vec2 sample_point(Sampler sampler, uint32_t i, uint32_t count, uint32_t seed);
+
+//box-filtered mip pyramid over a cube, for filtered importance sampling:
+// (faces are filtered independently; lookups clamp at face edges)
+struct CubeMips {
+	struct Level {
+		uint32_t size;
+		std::vector< glm::vec3 > data; //faces stacked as in the input
+	};
+	std::vector< Level > levels;
+
+	CubeMips(uint32_t size, std::vector< glm::vec3 > const &data);
+
+	//bilinear lookup of direction 'dir', blending between the two levels nearest 'lod':
+	glm::vec3 lookup(glm::vec3 const &dir, float lod) const;
+	//same, for 'count' directions (as arrays, see cube_lookup.hpp), each with its own lod:
+	void lookup_n(float const *x, float const *y, float const *z, float const *lod, size_t count, glm::vec3 *out) const;
+	//same, for a position st on face f:
+	glm::vec3 lookup(uint32_t f, glm::vec2 st, float lod) const;
+
+	static glm::vec3 bilinear(Level const &l, uint32_t f, glm::vec2 st);
+
+	//level to read so that one texel covers the solid angle of one sample drawn with density 'pdf' out of 'count':
+	float lod_for(float pdf, uint32_t count) const;
+};
+
+//a pixel pulled out of the input to be handled as a point light:
+struct BrightDirection {
+	glm::vec3 direction = glm::vec3(0.0f);
+	glm::vec3 light = glm::vec3(0.0f); //already multiplied by solid angle, I guess?
+};
+
+//bright directions sorted into a quadtree over each cube face, so that lighting a normal can
+// skip lights that can't contribute and sum whole groups of lights at once:
+struct LightTree {
+	struct Node {
+		glm::vec3 center = glm::vec3(0.0f); //all directions under the node are within a cone around 'center'...
+		float cos_radius = 1.0f; //... of this half-angle
+		float sin_radius = 0.0f;
+		//sum over lights of light.r * direction (and .g, .b), so sum of light * dot(direction, n) is (dot(r_dir, n), ...):
+		glm::vec3 r_dir = glm::vec3(0.0f);
+		glm::vec3 g_dir = glm::vec3(0.0f);
+		glm::vec3 b_dir = glm::vec3(0.0f);
+		glm::vec3 light = glm::vec3(0.0f); //sum of light
+		uint32_t first_child = 0; //index of first of four children, or 0 for leaves
+		uint32_t begin = 0, end = 0; //range of 'lights' under this node
+	};
+	std::vector< Node > nodes; //nodes[0..5] are the face roots
+	std::vector< BrightDirection > lights; //ordered so that each node's lights are contiguous
+	float max_total = 0.0f; //largest channel of the sum of all light
+
+	static constexpr uint32_t MaxDepth = 6; //finest cells are (1 << MaxDepth)^2 per face
+	static constexpr uint32_t LeafSize = 16; //stop splitting at this many lights
+
+	void build(std::vector< BrightDirection > const &from);
+	void build_node(uint32_t index, uint32_t f, uint32_t depth, uint32_t s, uint32_t t, uint32_t begin, uint32_t end, std::vector< std::pair< uint64_t, uint32_t > > const &keys);
+
+	//sum of max(0, dot(direction, n)) * light over all lights:
+	// (nodes fully above the horizon of n are summed without visiting their lights)
+	glm::vec3 sum_cosine(glm::vec3 const &n) const;
+
+	//sum of light over lights with dot(direction, n) > cos_angle:
+	// (nodes whose bounding cone doesn't reach the cone around n are skipped; assumes angle + node radius < pi)
+	glm::vec3 sum_cone(glm::vec3 const &n, float cos_angle, float sin_angle) const;
+};
+
+struct BlurSettings {
+	Sampler sampler = SamplerSobol;
+	bool mip_lookup = true; //read each sample from an input mip level matching its share of the lobe (otherwise, from the nearest input texel)
+	uint32_t brightest = 10000; //pixels to pull out of the input and handle as point lights (when separating)
+	bool function_dispatch = false; //call kernels through std::function (as blur_cube once did; only useful for benchmarking)
+};
+
+//an input cube, prepared for (any number of) blurs:
+struct BlurInput {
+	//note: 'sharp' is referenced (not copied), so it must outlive the BlurInput;
+	// if 'separate_bright' is set, the brightest pixels are moved from (a copy of) the input into 'bright_tree'
+	BlurInput(uint32_t size, std::vector< glm::vec3 > const &sharp, bool separate_bright, BlurSettings const &settings);
+	BlurInput(BlurInput const &) = delete;
+	BlurInput &operator=(BlurInput const &) = delete;
+
+	uint32_t size;
+	BlurSettings settings;
+	std::vector< glm::vec3 > const &sharp; //input as given
+	std::vector< glm::vec3 > separated; //input with bright pixels removed (empty if not separating)
+	std::vector< glm::vec3 > const &data; //input to be sampled by blurs (either 'separated' or 'sharp')
+	std::vector< BrightDirection > bright_directions;
+	LightTree bright_tree;
+	std::unique_ptr< CubeMips > mips; //mip pyramid of 'data' (if settings.mip_lookup)
+
+	//value of the input texel nearest 'dir' in 'from' (which should be 'sharp' or 'data'):
+	glm::vec3 nearest(std::vector< glm::vec3 > const &from, glm::vec3 const &dir) const;
+};
+
+//a share of an output's rows, for splitting one blur over several processes (see 'blur_cube --shard'):
+// rows (faces * size of them, in output order) are cut into 'count' contiguous bands, and shard 'index' gets band 'index'
+struct Shard {
+	uint32_t index = 0;
+	uint32_t count = 1;
+	uint32_t begin(uint32_t rows) const { return uint32_t(uint64_t(rows) * index / count); }
+	uint32_t end(uint32_t rows) const { return uint32_t(uint64_t(rows) * (index + 1) / count); }
+};
+
+enum BlurMode {
+	BlurDiffuse, //cosine-weighted hemisphere (wants an input with bright pixels separated)
+	BlurBokeh, //small uniform disc (wants an input with bright pixels separated)
+	BlurSharp, //single sample straight along the normal
+};
+
+//blur every texel of an out_size cube using 'samples' samples per texel, filling *out (faces stacked):
+// (if 'pool' is given, rows are sampled in parallel on it; results do not depend on thread count)
+// (the input is always a cube; with LayoutOct, the output is an out_size x out_size octahedral map instead)
+// (with a 'shard', only its rows are sampled and the rest of *out is zero; sampled rows match an unsharded run)
+void blur_cube(BlurInput const &input, BlurMode mode, uint32_t samples, uint32_t out_size, std::vector< glm::vec3 > *out, ThreadPool *pool = nullptr, Layout layout = LayoutCube, Shard shard = Shard());
+
+//pre-filtered GGX specular chain for an out_size cube (wants an input with bright pixels separated):
+// there are ggx_levels(out_size) levels; level i is (out_size >> i) texels on a side with roughness i / (levels - 1)
+// level 0 is a mirror of the sharp input and ignores 'samples'
+uint32_t ggx_levels(uint32_t out_size);
+void blur_ggx_level(BlurInput const &input, uint32_t level, uint32_t samples, uint32_t out_size, std::vector< glm::vec3 > *out, ThreadPool *pool = nullptr, Layout layout = LayoutCube, Shard shard = Shard());
+
+//project a cube onto the real spherical harmonics of bands [0,bands) (indexed by l*(l+1)+m, z is the polar axis),
+// convolved with a clamped cosine lobe and divided by pi (the same scale as BlurDiffuse output):
+void project_sh(uint32_t bands, uint32_t size, std::vector< glm::vec3 > const &data, std::vector< glm::dvec3 > *coefs, ThreadPool *pool = nullptr);
+
+//write coefficients as text, for use in shaders (will throw on error):
+void save_sh(std::string const &filename, std::vector< glm::dvec3 > const &coefs);
+
+//evaluate coefficients (clamped to non-negative) at every texel of an out_size cube (or octahedral map):
+void reconstruct_sh(std::vector< glm::dvec3 > const &coefs, uint32_t out_size, std::vector< glm::vec3 > *out, ThreadPool *pool = nullptr, Layout layout = LayoutCube);
@@ -0,0 +1,181 @@
+#include "load_save_png.hpp"
+#include "rgbe_n.hpp"
+#include "rgb9e5.hpp"
+#include "cube_e5.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+//"cube_compare" measures how far a cube (or octahedral map) is from a reference, in linear radiance,
+// so changes to the baking tools can be checked for accuracy as well as speed.
+//
+//Relative error is |test - reference| / max(reference, RelativeFloor) per channel: below the floor
+// (a dark texel in an 8-bit-mantissa format) absolute error is what counts.
+constexpr float RelativeFloor = 1.0f / 256.0f;
+
+//level 0 of an rgbe png (faces stacked, or one square octahedral map) or an .e5 cube, as linear floats:
+struct Image {
+	uint32_t size = 0; //texels on a side of each face
+	uint32_t faces = 0; //6 for cubes, 1 for octahedral maps
+	std::vector< glm::vec3 > data;
+};
+
+Image load_image(std::string const &filename) {
+	Image image;
+	if (filename.size() >= 3 && filename.substr(filename.size() - 3) == ".e5") {
+		CubeE5File e5(filename);
+		image.size = e5.size;
+		image.faces = 6;
+		uint32_t const *texels = e5.level_data(0);
+		image.data.reserve(6 * e5.size * e5.size);
+		for (uint32_t i = 0; i < 6 * e5.size * e5.size; ++i) {
+			image.data.emplace_back(rgb9e5_to_float(texels[i]));
+		}
+	} else {
+		glm::uvec2 size;
+		std::vector< glm::u8vec4 > rgbe;
+		load_png(filename, &size, &rgbe, LowerLeftOrigin);
+		if (size.y == size.x * 6) image.faces = 6;
+		else if (size.y == size.x) image.faces = 1;
+		else throw std::runtime_error("Expecting stacked faces or a square octahedral map in '" + filename + "'.");
+		image.size = size.x;
+		image.data.resize(rgbe.size());
+		rgbe_to_float_n(rgbe.data(), rgbe.size(), image.data.data());
+	}
+	return image;
+}
+
+//average k x k blocks of every face (so a reference baked at a multiple of the test size can be used):
+Image box_down(Image const &from, uint32_t k) {
+	Image to;
+	to.size = from.size / k;
+	to.faces = from.faces;
+	to.data.assign(to.faces * to.size * to.size, glm::vec3(0.0f));
+	float scale = 1.0f / float(k * k);
+	for (uint32_t f = 0; f < from.faces; ++f) {
+		for (uint32_t t = 0; t < from.size; ++t) {
+			for (uint32_t s = 0; s < from.size; ++s) {
+				to.data[(f * to.size + t / k) * to.size + s / k] += scale * from.data[(f * from.size + t) * from.size + s];
+			}
+		}
+	}
+	return to;
+}
+
+struct Stats {
+	double sum_sq = 0.0;
+	uint64_t count = 0;
+	float peak = 0.0f; //largest reference value
+	float max_rel = 0.0f;
+	uint32_t max_rel_texel = 0;
+
+	double rmse() const { return count ? std::sqrt(sum_sq / double(count)) : 0.0; }
+	//peak signal is the reference's largest value, so PSNR is comparable between tools on the same input:
+	double psnr() const {
+		double e = rmse();
+		if (e == 0.0) return std::numeric_limits< double >::infinity();
+		return 20.0 * std::log10(double(peak) / e);
+	}
+};
+
+int main(int argc, char **argv) {
+	//pull out options, leaving positional arguments:
+	std::vector< std::string > args;
+	double max_rmse = -1.0;
+	double min_psnr = -1.0;
+	double max_rel = -1.0;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--max-rmse" && i + 1 < argc) {
+			max_rmse = std::atof(argv[i+1]);
+			++i;
+		} else if (arg == "--min-psnr" && i + 1 < argc) {
+			min_psnr = std::atof(argv[i+1]);
+			++i;
+		} else if (arg == "--max-rel" && i + 1 < argc) {
+			max_rel = std::atof(argv[i+1]);
+			++i;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (args.size() != 2) {
+		std::cerr << "Usage:\n\t./cube_compare [--max-rmse E] [--min-psnr dB] [--max-rel R] <reference.png|reference.e5> <test.png|test.e5>\nCompare level 0 of two cubes (rgbe pngs with faces stacked +x/-x/+y/-y/+z/-z, or .e5 files) or two octahedral maps (square rgbe pngs) in linear radiance.\nReports RMSE, PSNR (peak = largest reference value) and max relative error (|test - ref| / max(ref, 1/256)) per face and overall; the last line is 'all <rmse> <psnr> <max rel>' for scripts.\nA reference whose size is a whole multiple of the test's is box-filtered down to match.\nExits with status 1 if any given limit is exceeded (overall), so it can be used as a check." << std::endl;
+		return 1;
+	}
+
+	Image ref = load_image(args[0]);
+	Image test = load_image(args[1]);
+	if (ref.faces != test.faces) {
+		std::cerr << "'" << args[0] << "' has " << ref.faces << " faces but '" << args[1] << "' has " << test.faces << "." << std::endl;
+		return 1;
+	}
+	if (ref.size != test.size) {
+		if (ref.size < test.size || ref.size % test.size != 0) {
+			std::cerr << "Reference size " << ref.size << " is not a multiple of test size " << test.size << "." << std::endl;
+			return 1;
+		}
+		std::cout << "Box-filtering " << ref.size << " reference down to " << test.size << "." << std::endl;
+		ref = box_down(ref, ref.size / test.size);
+	}
+
+	uint32_t size = test.size;
+	std::vector< Stats > faces(test.faces);
+	Stats all;
+	for (uint32_t f = 0; f < test.faces; ++f) {
+		Stats &stats = faces[f];
+		for (uint32_t i = f * size * size; i < (f + 1) * size * size; ++i) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				float r = ref.data[i][c];
+				float d = std::abs(test.data[i][c] - r);
+				stats.sum_sq += double(d) * double(d);
+				stats.peak = std::max(stats.peak, r);
+				float rel = d / std::max(r, RelativeFloor);
+				if (rel > stats.max_rel) {
+					stats.max_rel = rel;
+					stats.max_rel_texel = i;
+				}
+			}
+			stats.count += 3;
+		}
+		all.sum_sq += stats.sum_sq;
+		all.count += stats.count;
+		all.peak = std::max(all.peak, stats.peak);
+		if (stats.max_rel >= all.max_rel) {
+			all.max_rel = stats.max_rel;
+			all.max_rel_texel = stats.max_rel_texel;
+		}
+	}
+
+	static char const *FaceNames[6] = {"+x", "-x", "+y", "-y", "+z", "-z"};
+	std::cout << std::setprecision(6);
+	for (uint32_t f = 0; f < test.faces; ++f) {
+		std::cout << (test.faces == 6 ? FaceNames[f] : "oct") << " rmse " << faces[f].rmse() << " psnr " << faces[f].psnr() << " dB, max rel " << faces[f].max_rel << std::endl;
+	}
+	{
+		uint32_t i = all.max_rel_texel;
+		std::cout << "Largest relative error is at face " << i / (size * size) << ", texel (" << i % size << ", " << (i / size) % size << "): "
+		          << "reference (" << ref.data[i].r << ", " << ref.data[i].g << ", " << ref.data[i].b << "), "
+		          << "test (" << test.data[i].r << ", " << test.data[i].g << ", " << test.data[i].b << ")." << std::endl;
+	}
+	std::cout << "all " << all.rmse() << " " << all.psnr() << " " << all.max_rel << std::endl;
+
+	bool pass = true;
+	if (max_rmse >= 0.0 && all.rmse() > max_rmse) {
+		std::cout << "FAIL: rmse " << all.rmse() << " is above " << max_rmse << "." << std::endl;
+		pass = false;
+	}
+	if (min_psnr >= 0.0 && all.psnr() < min_psnr) {
+		std::cout << "FAIL: psnr " << all.psnr() << " dB is below " << min_psnr << " dB." << std::endl;
+		pass = false;
+	}
+	if (max_rel >= 0.0 && all.max_rel > max_rel) {
+		std::cout << "FAIL: max relative error " << all.max_rel << " is above " << max_rel << "." << std::endl;
+		pass = false;
+	}
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#include "cube_faces.hpp"
+
+#include <cassert>
+#include <cmath>
+
+void face_basis(uint32_t f, glm::vec3 *sc_, glm::vec3 *tc_, glm::vec3 *ma_) {
+	assert(sc_ && tc_ && ma_);
+	glm::vec3 &sc = *sc_;
+	glm::vec3 &tc = *tc_;
+	glm::vec3 &ma = *ma_;
+	//See OpenGL 4.4 Core Profile specification, Table 8.18:
+	if      (f == PositiveX) { sc = glm::vec3( 0.0f, 0.0f,-1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 1.0f, 0.0f, 0.0f); }
+	else if (f == NegativeX) { sc = glm::vec3( 0.0f, 0.0f, 1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3(-1.0f, 0.0f, 0.0f); }
+	else if (f == PositiveY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f, 1.0f); ma = glm::vec3( 0.0f, 1.0f, 0.0f); }
+	else if (f == NegativeY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f,-1.0f); ma = glm::vec3( 0.0f,-1.0f, 0.0f); }
+	else if (f == PositiveZ) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f, 1.0f); }
+	else if (f == NegativeZ) { sc = glm::vec3(-1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f,-1.0f); }
+	else assert(0 && "Invalid face.");
+}
+
+uint32_t direction_to_face(glm::vec3 const &dir, glm::vec2 *st) {
+	assert(st);
+	float sc, tc, ma;
+	uint32_t f;
+	if (std::abs(dir.x) >= std::abs(dir.y) && std::abs(dir.x) >= std::abs(dir.z)) {
+		if (dir.x >= 0) { sc = -dir.z; tc = -dir.y; ma = dir.x; f = PositiveX; }
+		else            { sc =  dir.z; tc = -dir.y; ma =-dir.x; f = NegativeX; }
+	} else if (std::abs(dir.y) >= std::abs(dir.z)) {
+		if (dir.y >= 0) { sc =  dir.x; tc =  dir.z; ma = dir.y; f = PositiveY; }
+		else            { sc =  dir.x; tc = -dir.z; ma =-dir.y; f = NegativeY; }
+	} else {
+		if (dir.z >= 0) { sc =  dir.x; tc = -dir.y; ma = dir.z; f = PositiveZ; }
+		else            { sc = -dir.x; tc = -dir.y; ma =-dir.z; f = NegativeZ; }
+	}
+	*st = glm::vec2(0.5f * (sc / ma + 1.0f), 0.5f * (tc / ma + 1.0f));
+	return f;
+}
+
+TexelDirections::TexelDirections(Layout layout_, uint32_t size_) : layout(layout_), size(size_), faces(layout_faces(layout_)) {
+	for (uint32_t f = 0; f < 6; ++f) {
+		face_basis(f, &sc[f], &tc[f], &ma[f]);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "octahedral.hpp"
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+//Cubes in the utilities are stored as faces stacked +x/-x/+y/-y/+z/-z,
+// each face size x size texels with rows bottom-to-top (as in the stored pngs).
+
+enum Face {
+	PositiveX = 0, NegativeX = 1,
+	PositiveY = 2, NegativeY = 3,
+	PositiveZ = 4, NegativeZ = 5,
+};
+
+//directions spanning a cube face:
+// sc maps to rightward axis on face, tc maps to upward axis on face, ma is direction to face
+void face_basis(uint32_t f, glm::vec3 *sc, glm::vec3 *tc, glm::vec3 *ma);
+
+//face containing a direction, and position on that face (in [0,1]^2):
+uint32_t direction_to_face(glm::vec3 const &dir, glm::vec2 *st);
+
+//Outputs may instead be laid out as a single-'face' octahedral map (see ../octahedral.hpp),
+// which the tools store as a size x size image:
+enum Layout {
+	LayoutCube, //six faces, as above
+	LayoutOct, //one face, octahedral
+};
+
+inline uint32_t layout_faces(Layout layout) {
+	return (layout == LayoutOct ? 1 : 6);
+}
+
+//directions through points of the faces of a size x size output in 'layout':
+struct TexelDirections {
+	TexelDirections(Layout layout, uint32_t size);
+	Layout layout;
+	uint32_t size;
+	uint32_t faces;
+	glm::vec3 sc[6], tc[6], ma[6]; //face_basis() of each face (cube layout)
+
+	//direction (not normalized) through (s,t) of face f, with s and t in texels (so texel centers are at +0.5):
+	glm::vec3 operator()(uint32_t f, float s, float t) const {
+		if (layout == LayoutOct) return octahedral_to_direction(glm::vec2(s, t) / float(size));
+		return ma[f] + (2.0f * s / size - 1.0f) * sc[f] + (2.0f * t / size - 1.0f) * tc[f];
+	}
+};
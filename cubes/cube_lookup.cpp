@@ -0,0 +1,217 @@
+#include "cube_lookup.hpp"
+
+#include "../rgbe_n.hpp"
+
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CUBE_LOOKUP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define CUBE_LOOKUP_AVX2
+#else
+#define CUBE_LOOKUP_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 is tightly packed");
+
+//Why the AVX2 code matches direction_to_face() exactly:
+// the face tests are the same comparisons (>=, false for NaN) made with ordered compares, and every
+// branch's sc / tc / ma is computed and blended in; negation is a sign flip in both versions,
+// and the remaining math is the same IEEE operations in the same order (no FMA contraction).
+
+namespace {
+
+//---------- scalar ----------
+
+void direction_to_face_scalar(float const *x, float const *y, float const *z, size_t count, uint32_t *face, float *s, float *t) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec2 st;
+		face[i] = direction_to_face(glm::vec3(x[i], y[i], z[i]), &st);
+		s[i] = st.x;
+		t[i] = st.y;
+	}
+}
+
+void cube_nearest_scalar(glm::vec3 const *cube, uint32_t size, float const *x, float const *y, float const *z, size_t count, glm::vec3 *out) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec2 st;
+		uint32_t f = direction_to_face(glm::vec3(x[i], y[i], z[i]), &st);
+		out[i] = cube[cube_texel_index(size, f, st)];
+	}
+}
+
+void texel_directions_scalar(TexelDirections const &directions, uint32_t f, float const *s, float const *t, size_t count, float *x, float *y, float *z) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 dir = directions(f, s[i], t[i]);
+		x[i] = dir.x;
+		y[i] = dir.y;
+		z[i] = dir.z;
+	}
+}
+
+#ifdef CUBE_LOOKUP_X86
+
+//---------- AVX2 ----------
+
+//direction_to_face() for eight directions:
+CUBE_LOOKUP_AVX2
+inline void faces_avx2(__m256 x, __m256 y, __m256 z, __m256i *face, __m256 *s, __m256 *t) {
+	__m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 ax = _mm256_andnot_ps(sign, x);
+	__m256 ay = _mm256_andnot_ps(sign, y);
+	__m256 az = _mm256_andnot_ps(sign, z);
+	__m256 nx = _mm256_xor_ps(x, sign);
+	__m256 ny = _mm256_xor_ps(y, sign);
+	__m256 nz = _mm256_xor_ps(z, sign);
+
+	//which axis is major (in direction_to_face()'s order), and which way it points:
+	__m256 is_x = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GE_OQ), _mm256_cmp_ps(ax, az, _CMP_GE_OQ));
+	__m256 is_y = _mm256_andnot_ps(is_x, _mm256_cmp_ps(ay, az, _CMP_GE_OQ));
+	__m256 px = _mm256_cmp_ps(x, zero, _CMP_GE_OQ);
+	__m256 py = _mm256_cmp_ps(y, zero, _CMP_GE_OQ);
+	__m256 pz = _mm256_cmp_ps(z, zero, _CMP_GE_OQ);
+
+	//(_mm256_blendv_ps(a, b, mask) is mask ? b : a)
+	__m256 sc = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(nx, x, pz), x, is_y), _mm256_blendv_ps(z, nz, px), is_x);
+	__m256 tc = _mm256_blendv_ps(_mm256_blendv_ps(ny, _mm256_blendv_ps(nz, z, py), is_y), ny, is_x);
+	__m256 ma = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(nz, z, pz), _mm256_blendv_ps(ny, y, py), is_y), _mm256_blendv_ps(nx, x, px), is_x);
+	__m256 positive = _mm256_blendv_ps(_mm256_blendv_ps(pz, py, is_y), px, is_x);
+
+	//face is 2 * axis + (negative ? 1 : 0):
+	__m256i axis = _mm256_castps_si256(_mm256_blendv_ps(_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_set1_epi32(PositiveZ)), _mm256_castsi256_ps(_mm256_set1_epi32(PositiveY)), is_y), _mm256_castsi256_ps(_mm256_set1_epi32(PositiveX)), is_x));
+	*face = _mm256_add_epi32(axis, _mm256_andnot_si256(_mm256_castps_si256(positive), _mm256_set1_epi32(1)));
+
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 one = _mm256_set1_ps(1.0f);
+	*s = _mm256_mul_ps(half, _mm256_add_ps(_mm256_div_ps(sc, ma), one));
+	*t = _mm256_mul_ps(half, _mm256_add_ps(_mm256_div_ps(tc, ma), one));
+}
+
+CUBE_LOOKUP_AVX2
+void direction_to_face_avx2(float const *x, float const *y, float const *z, size_t count, uint32_t *face, float *s, float *t) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i f;
+		__m256 fs, ft;
+		faces_avx2(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i), &f, &fs, &ft);
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(face + i), f);
+		_mm256_storeu_ps(s + i, fs);
+		_mm256_storeu_ps(t + i, ft);
+	}
+	direction_to_face_scalar(x + i, y + i, z + i, count - i, face + i, s + i, t + i);
+}
+
+CUBE_LOOKUP_AVX2
+void cube_nearest_avx2(glm::vec3 const *cube, uint32_t size, float const *x, float const *y, float const *z, size_t count, glm::vec3 *out) {
+	float const *base = reinterpret_cast< float const * >(cube);
+	__m256 fsize = _mm256_set1_ps(float(size));
+	__m256i isize = _mm256_set1_epi32(int32_t(size));
+	__m256i last = _mm256_set1_epi32(int32_t(size) - 1);
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i f;
+		__m256 fs, ft;
+		faces_avx2(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i), &f, &fs, &ft);
+
+		//cube_texel_index():
+		__m256i s = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(fs, fsize)));
+		__m256i t = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(ft, fsize)));
+		s = _mm256_max_epi32(zero, _mm256_min_epi32(last, s));
+		t = _mm256_max_epi32(zero, _mm256_min_epi32(last, t));
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(f, isize), t), isize), s);
+
+		//gather each channel of the (tightly packed) vec3 texels:
+		__m256i offset = _mm256_add_epi32(index, _mm256_add_epi32(index, index));
+		alignas(32) float r[8], g[8], b[8];
+		_mm256_store_ps(r, _mm256_i32gather_ps(base + 0, offset, 4));
+		_mm256_store_ps(g, _mm256_i32gather_ps(base + 1, offset, 4));
+		_mm256_store_ps(b, _mm256_i32gather_ps(base + 2, offset, 4));
+		for (uint32_t j = 0; j < 8; ++j) {
+			out[i + j] = glm::vec3(r[j], g[j], b[j]);
+		}
+	}
+	cube_nearest_scalar(cube, size, x + i, y + i, z + i, count - i, out + i);
+}
+
+CUBE_LOOKUP_AVX2
+void texel_directions_avx2(TexelDirections const &directions, uint32_t f, float const *s, float const *t, size_t count, float *x, float *y, float *z) {
+	glm::vec3 const &sc = directions.sc[f];
+	glm::vec3 const &tc = directions.tc[f];
+	glm::vec3 const &ma = directions.ma[f];
+	__m256 two = _mm256_set1_ps(2.0f);
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 fsize = _mm256_set1_ps(float(directions.size));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		//ma + (2s / size - 1) * sc + (2t / size - 1) * tc, a component at a time:
+		__m256 u = _mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(two, _mm256_loadu_ps(s + i)), fsize), one);
+		__m256 v = _mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(two, _mm256_loadu_ps(t + i)), fsize), one);
+		float *dst[3] = {x + i, y + i, z + i};
+		for (uint32_t c = 0; c < 3; ++c) {
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(ma[c]), _mm256_mul_ps(u, _mm256_set1_ps(sc[c]))), _mm256_mul_ps(v, _mm256_set1_ps(tc[c])));
+			_mm256_storeu_ps(dst[c], d);
+		}
+	}
+	texel_directions_scalar(directions, f, s + i, t + i, count - i, x + i, y + i, z + i);
+}
+
+#endif //CUBE_LOOKUP_X86
+
+LookupPath resolve(LookupPath path) {
+	if (path == LookupPathBest) {
+		static LookupPath best = lookup_path_supported(LookupPathAVX2) ? LookupPathAVX2 : LookupPathScalar;
+		return best;
+	}
+	if (!lookup_path_supported(path)) return LookupPathScalar;
+	return path;
+}
+
+} //namespace
+
+bool lookup_path_supported(LookupPath path) {
+	if (path == LookupPathScalar || path == LookupPathBest) return true;
+	#ifdef CUBE_LOOKUP_X86
+	if (path == LookupPathAVX2) {
+		static bool avx2 = cpu_has_avx2();
+		return avx2;
+	}
+	#endif
+	return false;
+}
+
+char const *lookup_path_name(LookupPath path) {
+	if (path == LookupPathScalar) return "scalar";
+	if (path == LookupPathAVX2) return "avx2";
+	if (path == LookupPathBest) return lookup_path_name(resolve(path));
+	return "(unknown)";
+}
+
+void direction_to_face_n(float const *x, float const *y, float const *z, size_t count, uint32_t *face, float *s, float *t, LookupPath path) {
+	path = resolve(path);
+	#ifdef CUBE_LOOKUP_X86
+	if (path == LookupPathAVX2) { direction_to_face_avx2(x, y, z, count, face, s, t); return; }
+	#endif
+	direction_to_face_scalar(x, y, z, count, face, s, t);
+}
+
+void cube_nearest_n(glm::vec3 const *cube, uint32_t size, float const *x, float const *y, float const *z, size_t count, glm::vec3 *out, LookupPath path) {
+	assert(size > 0);
+	path = resolve(path);
+	#ifdef CUBE_LOOKUP_X86
+	if (path == LookupPathAVX2) { cube_nearest_avx2(cube, size, x, y, z, count, out); return; }
+	#endif
+	cube_nearest_scalar(cube, size, x, y, z, count, out);
+}
+
+void texel_directions_n(TexelDirections const &directions, uint32_t f, float const *s, float const *t, size_t count, float *x, float *y, float *z, LookupPath path) {
+	assert(f < directions.faces);
+	path = resolve(path);
+	#ifdef CUBE_LOOKUP_X86
+	if (path == LookupPathAVX2 && directions.layout == LayoutCube) { texel_directions_avx2(directions, f, s, t, count, x, y, z); return; }
+	#endif
+	texel_directions_scalar(directions, f, s, t, count, x, y, z);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cube_faces.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+//Batched versions of the per-direction cube math in cube_faces.hpp, shared by the tools.
+// Directions are passed as structure-of-arrays (separate x, y, z arrays) so that eight can be
+// handled at once with AVX2 (face selection by compare-and-blend, coordinates, and texel gathers).
+// Every path produces exactly the same bits as the one-direction-at-a-time code.
+
+enum LookupPath {
+	LookupPathScalar, //one direction at a time
+	LookupPathAVX2,   //eight directions at a time
+	LookupPathBest    //fastest path supported by the running CPU
+};
+
+//is a given path supported by this build + CPU?
+bool lookup_path_supported(LookupPath path);
+char const *lookup_path_name(LookupPath path);
+
+//callers batch up this many directions (or more) at a time:
+constexpr uint32_t LookupBatch = 8;
+
+//index (in a size x size cube, faces stacked) of the texel containing position st of face f, clamped to the face:
+inline uint32_t cube_texel_index(uint32_t size, uint32_t f, glm::vec2 st) {
+	int32_t s = int32_t(std::floor(st.x * size));
+	s = std::max(0, std::min(int32_t(size)-1, s));
+	int32_t t = int32_t(std::floor(st.y * size));
+	t = std::max(0, std::min(int32_t(size)-1, t));
+	return (f * size + uint32_t(t)) * size + uint32_t(s);
+}
+
+//direction_to_face() for 'count' directions, writing face and position (st) on face:
+void direction_to_face_n(float const *x, float const *y, float const *z, size_t count,
+	uint32_t *face, float *s, float *t, LookupPath path = LookupPathBest);
+
+//texel nearest each of 'count' directions in a size x size cube (faces stacked), as cube[cube_texel_index(...)]:
+void cube_nearest_n(glm::vec3 const *cube, uint32_t size, float const *x, float const *y, float const *z, size_t count,
+	glm::vec3 *out, LookupPath path = LookupPathBest);
+
+//directions(f, s[i], t[i]) for 'count' points of face f (not normalized; s and t in texels, see TexelDirections):
+// (octahedral layouts are mapped one point at a time)
+void texel_directions_n(TexelDirections const &directions, uint32_t f, float const *s, float const *t, size_t count,
+	float *x, float *y, float *z, LookupPath path = LookupPathBest);
@@ -0,0 +1,149 @@
+#include "cube_shard.hpp"
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <cassert>
+
+namespace {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	struct ShardHeader {
+		uint32_t index = 0;
+		uint32_t count = 0;
+		uint32_t size = 0;
+		uint32_t faces = 0;
+		uint32_t levels = 0;
+	};
+	static_assert(sizeof(ShardHeader) == 20, "header is packed");
+
+	//first texel and texel count of a shard's rows within a level:
+	void shard_span(Shard shard, uint32_t faces, uint32_t size, size_t *first, size_t *count) {
+		uint32_t rows = faces * size;
+		*first = size_t(shard.begin(rows)) * size;
+		*count = size_t(shard.end(rows) - shard.begin(rows)) * size;
+	}
+}
+
+void save_cube_shard(std::string const &filename, CubeShard const &shard) {
+	ShardHeader info;
+	info.index = shard.shard.index;
+	info.count = shard.shard.count;
+	info.size = shard.size;
+	info.faces = shard.faces;
+	info.levels = uint32_t(shard.levels.size());
+
+	size_t texels = 0;
+	for (uint32_t level = 0; level < shard.levels.size(); ++level) {
+		uint32_t size = shard.level_size(level);
+		if (shard.levels[level].size() != size_t(shard.faces) * size * size) {
+			throw std::runtime_error("Level " + std::to_string(level) + " of shard for '" + filename + "' has the wrong number of texels.");
+		}
+		size_t first, count;
+		shard_span(shard.shard, shard.faces, size, &first, &count);
+		texels += count;
+	}
+	if (texels * sizeof(glm::vec3) > 0xffffffffULL) {
+		throw std::runtime_error("Shard for '" + filename + "' is too large for one chunk; use more shards.");
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	ChunkHeader header;
+	std::memcpy(header.magic, "shrd", 4);
+	header.size = sizeof(info);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(reinterpret_cast< char const * >(&info), sizeof(info));
+	std::memcpy(header.magic, "args", 4);
+	header.size = uint32_t(shard.args.size());
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(shard.args.data(), shard.args.size());
+	std::memcpy(header.magic, "rows", 4);
+	header.size = uint32_t(texels * sizeof(glm::vec3));
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	for (uint32_t level = 0; level < shard.levels.size(); ++level) {
+		size_t first, count;
+		shard_span(shard.shard, shard.faces, shard.level_size(level), &first, &count);
+		out.write(reinterpret_cast< char const * >(shard.levels[level].data() + first), count * sizeof(glm::vec3));
+	}
+	if (!out) {
+		throw std::runtime_error("Failed to write '" + filename + "'.");
+	}
+}
+
+void load_cube_shard(std::string const &filename, CubeShard *shard_) {
+	assert(shard_);
+	auto &shard = *shard_;
+
+	MappedFile file(filename);
+	uint8_t const *at = file.data;
+	uint8_t const *end = file.data + file.size;
+
+	auto read_header = [&](char const *magic) -> ChunkHeader {
+		ChunkHeader header;
+		if (size_t(end - at) < sizeof(header)) {
+			throw std::runtime_error("Shard file '" + filename + "' is truncated.");
+		}
+		std::memcpy(&header, at, sizeof(header));
+		at += sizeof(header);
+		if (std::string(header.magic, 4) != magic) {
+			throw std::runtime_error("Shard file '" + filename + "' has unexpected magic number (expecting '" + magic + "').");
+		}
+		if (size_t(end - at) < header.size) {
+			throw std::runtime_error("Shard file '" + filename + "' is truncated.");
+		}
+		return header;
+	};
+
+	ChunkHeader header = read_header("shrd");
+	if (header.size != sizeof(ShardHeader)) {
+		throw std::runtime_error("Shard file '" + filename + "' has an unexpected header size.");
+	}
+	ShardHeader info;
+	std::memcpy(&info, at, sizeof(info));
+	at += header.size;
+	if (info.count == 0 || info.index >= info.count || info.size == 0 || (info.faces != 6 && info.faces != 1)
+	 || info.levels == 0 || info.levels > 32 || (info.levels > 1 && (info.size >> (info.levels - 1)) == 0)) {
+		throw std::runtime_error("Shard file '" + filename + "' has a bad header.");
+	}
+
+	if (!shard.levels.empty() && (shard.levels.size() != info.levels || shard.size != info.size || shard.faces != info.faces)) {
+		throw std::runtime_error("Shard file '" + filename + "' has different sizes than the shards before it.");
+	}
+	shard.shard.index = info.index;
+	shard.shard.count = info.count;
+	shard.size = info.size;
+	shard.faces = info.faces;
+
+	header = read_header("args");
+	shard.args = std::string(reinterpret_cast< char const * >(at), header.size);
+	at += header.size;
+
+	header = read_header("rows");
+	size_t expected = 0;
+	for (uint32_t level = 0; level < info.levels; ++level) {
+		size_t first, count;
+		shard_span(shard.shard, shard.faces, shard.level_size(level), &first, &count);
+		expected += count;
+	}
+	if (header.size != expected * sizeof(glm::vec3)) {
+		throw std::runtime_error("Shard file '" + filename + "' has " + std::to_string(header.size) + " bytes of rows; expecting " + std::to_string(expected * sizeof(glm::vec3)) + ".");
+	}
+	if (shard.levels.empty()) {
+		shard.levels.resize(info.levels);
+		for (uint32_t level = 0; level < info.levels; ++level) {
+			uint32_t size = shard.level_size(level);
+			shard.levels[level].assign(size_t(shard.faces) * size * size, glm::vec3(0.0f));
+		}
+	}
+	for (uint32_t level = 0; level < info.levels; ++level) {
+		size_t first, count;
+		shard_span(shard.shard, shard.faces, shard.level_size(level), &first, &count);
+		std::memcpy(shard.levels[level].data() + first, at, count * sizeof(glm::vec3));
+		at += count * sizeof(glm::vec3);
+	}
+}
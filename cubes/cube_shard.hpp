@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cube_blur.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+//'blur_cube --shard i/N' samples only shard i's rows of each output level (see Shard in cube_blur.hpp)
+// and saves them to a shard file; 'blur_cube --merge' reads all N shard files back into whole levels.
+//
+//Shard files are three chunks in the style of read_chunk.hpp (4-byte magic, 4-byte size, data):
+// 'shrd': uint32_t index, count, size (of level 0), faces (6 for cubes, 1 for octahedral maps), levels
+// 'args': char; the blur settings of the run, which must match between shards of one output
+// 'rows': float rgb texels of the shard's rows of each level in turn
+//   (level l has faces * max(1, size >> l) rows of max(1, size >> l) texels; the shard holds Shard::begin..end of them)
+//(all values are little-endian)
+
+struct CubeShard {
+	Shard shard;
+	uint32_t size = 0;
+	uint32_t faces = 6;
+	std::string args;
+	//whole levels; only the rows of this shard (or of every shard loaded so far) are filled in:
+	std::vector< std::vector< glm::vec3 > > levels;
+
+	uint32_t level_size(uint32_t level) const { return std::max(1U, size >> level); }
+};
+
+//write the shard's rows of 'levels' (will throw on error):
+void save_cube_shard(std::string const &filename, CubeShard const &shard);
+
+//read a shard file into 'shard' (will throw on error):
+// shard, size, faces, and args are replaced by the file's; its rows are copied into 'levels',
+// which are allocated if empty and must otherwise already have the file's sizes,
+// so the shards of one output can be loaded one after another into the same CubeShard.
+void load_cube_shard(std::string const &filename, CubeShard *shard);
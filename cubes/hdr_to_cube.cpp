@@ -1,187 +1,241 @@
+#include "ibl.hpp"
 #include "load_hdr.hpp"
 #include "load_save_png.hpp"
 #include "rgbe.hpp"
+#include "rgbe_n.hpp"
+#include "ThreadPool.hpp"
+#include "cube_e5.hpp"
+#include "rgb9e5.hpp"
 
 #include <iostream>
-
-void save_tone_mapped_png(std::string const &filename, glm::uvec2 size, std::vector< glm::vec3 > const &data) {
-	std::vector< glm::u8vec4 > mapped;
-	mapped.reserve(data.size());
-	for (auto pix : data) {
-		//luminance (in lumens per steradian per square meter) of pixel:
-		// [according to picture file format docs]
-		//float lum = 179 * 0.265f * pix.r + 0.670f * pix.g + 0.065f * pix.b;
-
-		//gamma compression:
-		constexpr const float Gamma = 0.45f;
-		pix.r = std::pow(pix.r, Gamma);
-		pix.g = std::pow(pix.g, Gamma);
-		pix.b = std::pow(pix.b, Gamma);
-
-		glm::ivec3 amt = glm::ivec3(255.0f * pix);
-		mapped.emplace_back(
-			std::min(255, std::max(0, amt.r)),
-			std::min(255, std::max(0, amt.g)),
-			std::min(255, std::max(0, amt.b)),
-			0xff
-		);
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+//report the most memory the process has had resident, where the platform says:
+void report_peak_memory() {
+	#if !defined(_WIN32)
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		#if defined(__APPLE__)
+		double mb = usage.ru_maxrss / (1024.0 * 1024.0); //bytes
+		#else
+		double mb = usage.ru_maxrss / 1024.0; //kilobytes
+		#endif
+		std::cout << "Peak resident memory: " << mb << " MB." << std::endl;
 	}
-	save_png(filename, size, mapped.data(), LowerLeftOrigin);
+	#endif
 }
 
-enum Face {
-	PositiveX = 0, NegativeX = 1,
-	PositiveY = 2, NegativeY = 3,
-	PositiveZ = 4, NegativeZ = 5,
-};
-
 int main(int argc, char **argv) {
-	if (argc != 4) {
-		std::cerr << "Usage:\n\t./hdr_to_cube <latlon.hdr> <cube size> <cube.png>" << std::endl;
+	//pull out options, leaving positional arguments:
+	std::vector< std::string > args;
+	int32_t threads = 0;
+	std::string sampling = "point";
+	int32_t max_memory = 0; //in megabytes; if non-zero, stream the input in bands of rows
+	std::string layout_name = "cube";
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[i+1]);
+			++i;
+		} else if (arg == "--max-memory" && i + 1 < argc) {
+			max_memory = std::atoi(argv[i+1]);
+			++i;
+		} else if (arg == "--sampling" && i + 1 < argc) {
+			sampling = argv[i+1];
+			++i;
+		} else if (arg == "--layout" && i + 1 < argc) {
+			layout_name = argv[i+1];
+			++i;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (args.size() != 3) {
+		std::cerr << "Usage:\n\t./hdr_to_cube [--threads N] [--sampling point|mip] [--max-memory MB] [--layout cube|oct] <latlon.hdr> <cube size> <cube.png|cube.e5>\n(a name ending in .e5 gets a packed RGB9_E5 cube file, see ../cube_e5.hpp, instead of an rgbe png)\n(--layout oct writes a <cube size> x <cube size> octahedral map, see ../octahedral.hpp, as an rgbe png instead of a cube)\n(--threads 0, the default, uses all cores; output does not depend on thread count)\n(--sampling point, the default, takes 36 nearest-pixel samples per texel; mip integrates each texel's footprint using a mip pyramid)\n(--max-memory MB decodes the input in bands of rows, holding only as many as fit in MB along with the packed output, instead of the whole image; output is the same; point sampling only)" << std::endl;
 		return 1;
 	}
-	std::string hdr_file = argv[1];
-	int32_t cube_size = std::atoi(argv[2]);
-	std::string png_file = argv[3];
+	std::string hdr_file = args[0];
+	int32_t cube_size = std::atoi(args[1].c_str());
+	std::string png_file = args[2];
 
 	if (cube_size < 1) {
 		std::cerr << "Cube map size must be positive." << std::endl;
 		return 1;
 	}
+	if (threads < 0) {
+		std::cerr << "Thread count must be non-negative." << std::endl;
+		return 1;
+	}
+	if (sampling != "point" && sampling != "mip") {
+		std::cerr << "Sampling must be 'point' or 'mip'." << std::endl;
+		return 1;
+	}
+	if (max_memory < 0 || (max_memory > 0 && sampling != "point")) {
+		std::cerr << "Memory limit must be non-negative, and only works with point sampling." << std::endl;
+		return 1;
+	}
+	if (layout_name != "cube" && layout_name != "oct") {
+		std::cerr << "Layout must be 'cube' or 'oct'." << std::endl;
+		return 1;
+	}
+	Layout layout = (layout_name == "oct" ? LayoutOct : LayoutCube);
 
-	glm::uvec2 size;
-	std::vector< glm::u8vec4 > data_rgbe;
-	load_hdr(hdr_file, &size, &data_rgbe);
+	bool e5 = is_e5_filename(png_file);
 
-	std::cout << "Loaded a " << size.x << " x " << size.y << " hdr image from '" << hdr_file << "'" << std::endl;
+	if (layout == LayoutOct && (e5 || max_memory > 0)) {
+		std::cerr << "Octahedral maps are only written as rgbe pngs, without --max-memory." << std::endl;
+		return 1;
+	}
 
-	//convert rgbe data to linear floating point data:
-	std::cout << "Converting to linear floating point..."; std::cout.flush();
-	std::vector< glm::vec3 > data;
-	data.reserve(data_rgbe.size());
-	for (auto const &pix : data_rgbe) {
-		data.emplace_back( rgbe_to_float(pix) );
+	ThreadPool pool(threads);
+
+	if (max_memory > 0) {
+		//streaming: rows of the input are decoded in bands, as the tiles being sampled need them,
+		// and finished texels are packed straight into the output format, so neither the whole input nor a float cube is ever held.
+		HDRFile file(hdr_file, true);
+		glm::uvec2 size = file.size;
+		if (file.transpose) {
+			std::cerr << "'" << hdr_file << "' stores columns rather than rows, so it can't be streamed; run without --max-memory." << std::endl;
+			return 1;
+		}
+		std::cout << "Streaming a " << size.x << " x " << size.y << " hdr image from '" << hdr_file << "'." << std::endl;
+
+		//budget: packed output, then per input row: float texels, rgbe staging, and (roughly) its compressed bytes:
+		size_t output_bytes = 6 * size_t(cube_size) * size_t(cube_size) * 4;
+		size_t row_bytes = size_t(size.x) * (sizeof(glm::vec3) + sizeof(glm::u8vec4) + 4);
+		size_t budget = size_t(max_memory) << 20;
+		size_t max_rows = (budget > output_bytes ? (budget - output_bytes) / row_bytes : 0);
+		if (max_rows < 1) {
+			std::cerr << "A memory limit of " << max_memory << " MB doesn't fit the " << (output_bytes >> 20) << " MB packed output and any input rows." << std::endl;
+			return 1;
+		}
+		max_rows = std::min(max_rows, size_t(size.y));
+		std::cout << "Holding up to " << max_rows << " input rows (" << ((max_rows * row_bytes) >> 20) << " MB) and " << (output_bytes >> 20) << " MB of packed output." << std::endl;
+
+		std::vector< glm::u8vec4 > staging;
+		uint32_t bands = 0;
+		auto read_rows = [&](uint32_t y0, uint32_t y1, glm::vec3 *rows) {
+			staging.resize(size_t(y1 - y0) * size.x);
+			file.read_rows(y0, y1, staging.data(), &pool);
+			rgbe_to_float_n(staging.data(), staging.size(), rows);
+			file.release_rows(y0, y1);
+			++bands;
+		};
+
+		std::vector< uint32_t > packed_e5;
+		std::vector< glm::u8vec4 > packed_rgbe;
+		if (e5) packed_e5.resize(6 * size_t(cube_size) * size_t(cube_size));
+		else packed_rgbe.resize(6 * size_t(cube_size) * size_t(cube_size));
+		auto write_texels = [&](uint32_t f, uint32_t t, uint32_t s0, uint32_t s1, glm::vec3 const *texels) {
+			size_t at = (size_t(f) * cube_size + t) * cube_size + s0;
+			if (e5) {
+				for (uint32_t s = s0; s < s1; ++s) packed_e5[at + s - s0] = float_to_rgb9e5(texels[s - s0]);
+			} else {
+				float_to_rgbe_n(texels, s1 - s0, packed_rgbe.data() + at);
+			}
+		};
+
+		std::cout << "Using 36 samples per texel." << std::endl;
+		std::cout << "Sampling with " << pool.size() << " threads..."; std::cout.flush();
+		auto before = std::chrono::high_resolution_clock::now();
+		latlon_to_cube_banded(size, uint32_t(max_rows), read_rows, uint32_t(cube_size), write_texels, &pool);
+		auto after = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration< double >(after - before).count();
+		std::cout << " done (input read in " << bands << " bands)." << std::endl;
+		std::cout << "Sampled " << 6 * size_t(cube_size) * size_t(cube_size) << " texels in " << seconds << " seconds ("
+		          << (6.0 * cube_size * cube_size) / seconds << " texels/sec on " << pool.size() << " threads)." << std::endl;
+
+		if (e5) {
+			std::cout << "Writing final packed RGB9_E5 cube..."; std::cout.flush();
+			save_cube_e5_packed(png_file, uint32_t(cube_size), 1, packed_e5.data());
+			std::cout << " done." << std::endl;
+		} else {
+			uint32_t overflow = 0;
+			for (auto const &pix : packed_rgbe) {
+				if (pix == glm::u8vec4(0xff, 0xff, 0xff, 0xff)) ++overflow;
+			}
+			std::cout << "Output contains " << overflow << " bright-white (likely overflow) pixels." << std::endl;
+			std::cout << "Writing final rgbe png..."; std::cout.flush();
+			save_png(png_file, glm::uvec2(cube_size, 6 * cube_size), packed_rgbe.data(), LowerLeftOrigin);
+			std::cout << " done." << std::endl;
+		}
+		report_peak_memory();
+		return 0;
 	}
-	std::cout << " done." << std::endl;
+
+	auto load_before = std::chrono::high_resolution_clock::now();
+	LatLonImage latlon = load_latlon(hdr_file, &pool);
+	auto load_after = std::chrono::high_resolution_clock::now();
+
+	std::cout << "Loaded a " << latlon.size.x << " x " << latlon.size.y << " hdr image from '" << hdr_file << "' (as linear floating point) in "
+	          << std::chrono::duration< double >(load_after - load_before).count() << " seconds." << std::endl;
 
 /*
 	//check the conversion by dumping tone-mapped values:
 	std::cout << "Writing tone-mapped png [DEBUG-latlon.png]..."; std::cout.flush();
-	save_tone_mapped_png("DEBUG-latlon.png", size, data);
+	save_tone_mapped_png("DEBUG-latlon.png", latlon.size, latlon.data);
 	std::cout << " done." << std::endl;
 */
 
 /*
 	//round trip through conversion funcs again:
-	for (auto &pix : data) {
+	for (auto &pix : latlon.data) {
 		pix = rgbe_to_float( float_to_rgbe( pix ) );
 	}
 	std::cout << "Writing tone-mapped png [DEBUG-latlon-2.png]..."; std::cout.flush();
-	save_tone_mapped_png("DEBUG-latlon-2.png", size, data);
+	save_tone_mapped_png("DEBUG-latlon-2.png", latlon.size, latlon.data);
 	std::cout << " done." << std::endl;
 */
 
-	//function for sampling a given direction from latlon map:
-	auto lookup = [&data,&size](glm::vec3 const &dir) -> glm::vec3 {
-		float lon = std::atan2(dir.y, dir.x);
-		float lat = std::atan2(dir.z, glm::length(glm::vec2(dir)));
-		float s = ((lon / M_PI) + 1.0f) / 2.0f;
-		float t = ((lat / (0.5f * M_PI)) + 1.0f) / 2.0f;
-		//clamp (shouldn't be needed?):
-		s = std::max(0.0f, std::min(1.0f, s));
-		t = std::max(0.0f, std::min(1.0f, t));
-
-		//return value from nearest pixel center:
-		glm::ivec2 px = glm::ivec2(std::floor(size.x*s), std::floor(size.y*t));
-		//clamp (may be needed if sampling exactly the right or left edge):
-		px.x = std::max(0, std::min(int32_t(size.x)-1, px.x));
-		px.y = std::max(0, std::min(int32_t(size.y)-1, px.y));
-
-		return data[px.y*size.x+px.x];
-	};
-
-	//accumulate color into cubemap pixels:
-	std::vector< glm::vec3 > faces[6]; //+x, -x, +y, -y, +z, -z
-
-	//will sample multiple times per direction:
-	std::vector< glm::vec3 > samples;
-	{ //even sampling over texel area:
-		constexpr uint32_t Count = 6; //6x6 = 36 samples
-		for (uint32_t t = 0; t < Count; ++t) {
-			for (uint32_t s = 0; s < Count; ++s) {
-				samples.emplace_back(
-					(s + 0.5f) / float(Count),
-					(t + 0.5f) / float(Count),
-					1.0f / float(Count * Count)
-				);
-			}
-		}
-	}
-	std::cout << "Using " << samples.size() << " samples per texel." << std::endl;
-
-	for (uint32_t f = 0; f < 6; ++f) {
-		std::cout << "Sampling face " << f << "/6 ..."; std::cout.flush();
-		glm::vec3 sc; //maps to rightward axis on face
-		glm::vec3 tc; //maps to upward axis on face
-		glm::vec3 ma; //direction to face
-		//See OpenGL 4.4 Core Profile specification, Table 8.18:
-		if      (f == PositiveX) { sc = glm::vec3( 0.0f, 0.0f,-1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 1.0f, 0.0f, 0.0f); }
-		else if (f == NegativeX) { sc = glm::vec3( 0.0f, 0.0f, 1.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3(-1.0f, 0.0f, 0.0f); }
-		else if (f == PositiveY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f, 1.0f); ma = glm::vec3( 0.0f, 1.0f, 0.0f); }
-		else if (f == NegativeY) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f, 0.0f,-1.0f); ma = glm::vec3( 0.0f,-1.0f, 0.0f); }
-		else if (f == PositiveZ) { sc = glm::vec3( 1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f, 1.0f); }
-		else if (f == NegativeZ) { sc = glm::vec3(-1.0f, 0.0f, 0.0f); tc = glm::vec3( 0.0f,-1.0f, 0.0f); ma = glm::vec3( 0.0f, 0.0f,-1.0f); }
-		else assert(0 && "Invalid face.");
-	
-		std::vector< glm::vec3 > &face = faces[f];
-		face.reserve(cube_size * cube_size);
-		for (uint32_t t = 0; t < uint32_t(cube_size); ++t) {
-			for (uint32_t s = 0; s < uint32_t(cube_size); ++s) {
-				glm::vec3 acc = glm::vec3(0.0f);
-				for (auto const &sample : samples) {
-					glm::vec3 dir = ma
-					              + (2.0f * (s + 0.5f + sample.x) / cube_size - 1.0f) * sc
-					              + (2.0f * (t + 0.5f + sample.y) / cube_size - 1.0f) * tc;
-					acc += sample.z * lookup(dir);
-				}
-				face.emplace_back(acc);
-			}
-		}
-		std::cout << " done." << std::endl;
+	LatLonSampling mode = (sampling == "mip" ? LatLonMip : LatLonPoint);
+	if (mode == LatLonMip) {
+		std::cout << "Using 16 bilinear mip lookups per texel." << std::endl;
+	} else {
+		std::cout << "Using 36 samples per texel." << std::endl;
 	}
 
-	//write faces out to separate files:
-	std::cout << "Writing tone-mapped pngs [DEBUG-(pos|neg)[XYZ].png]..."; std::cout.flush();
-	save_tone_mapped_png("DEBUG-posX.png", glm::uvec2(cube_size, cube_size), faces[PositiveX]);
-	save_tone_mapped_png("DEBUG-negX.png", glm::uvec2(cube_size, cube_size), faces[NegativeX]);
-	save_tone_mapped_png("DEBUG-posY.png", glm::uvec2(cube_size, cube_size), faces[PositiveY]);
-	save_tone_mapped_png("DEBUG-negY.png", glm::uvec2(cube_size, cube_size), faces[NegativeY]);
-	save_tone_mapped_png("DEBUG-posZ.png", glm::uvec2(cube_size, cube_size), faces[PositiveZ]);
-	save_tone_mapped_png("DEBUG-negZ.png", glm::uvec2(cube_size, cube_size), faces[NegativeZ]);
+	std::cout << "Sampling with " << pool.size() << " threads..."; std::cout.flush();
+	auto before = std::chrono::high_resolution_clock::now();
+
+	CubeImage cube = bake_sky(latlon, uint32_t(cube_size), mode, &pool, layout);
+
+	auto after = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration< double >(after - before).count();
 	std::cout << " done." << std::endl;
+	std::cout << "Sampled " << cube.levels[0].size() << " texels in " << seconds << " seconds ("
+	          << double(cube.levels[0].size()) / seconds << " texels/sec on " << pool.size() << " threads)." << std::endl;
 
-	//write a single +x/-x/+y/-y/+z/-z (all stacked in a column with +x at the bottom) file for storage:
-	std::cout << "Writing final rgbe png..."; std::cout.flush();
-	std::vector< glm::u8vec4 > cube_data;
-	std::vector< glm::vec3 > cube_data_float; //DEBUG
-	cube_data.reserve(6 * cube_size * cube_size);
-	uint32_t overflow = 0;
-	for (auto const &face : faces) {
-		for (auto const &pix : face) {
-			cube_data.emplace_back( float_to_rgbe( pix ) );
-			cube_data_float.emplace_back( pix );
-			if (cube_data.back() == glm::u8vec4(0xff, 0xff, 0xff, 0xff)) ++overflow;
+	if (layout == LayoutOct) {
+		std::cout << "Writing tone-mapped png [DEBUG-oct.png]..."; std::cout.flush();
+		save_tone_mapped_png("DEBUG-oct.png", cube.level_dims(0), cube.levels[0]);
+		std::cout << " done." << std::endl;
+	} else {
+		//write faces out to separate files:
+		std::cout << "Writing tone-mapped pngs [DEBUG-(pos|neg)[XYZ].png]..."; std::cout.flush();
+		static char const *names[6] = { "posX", "negX", "posY", "negY", "posZ", "negZ" };
+		for (uint32_t f = 0; f < 6; ++f) {
+			auto face = cube.levels[0].begin() + f * cube_size * cube_size;
+			save_tone_mapped_png(std::string("DEBUG-") + names[f] + ".png", glm::uvec2(cube_size, cube_size), std::vector< glm::vec3 >(face, face + cube_size * cube_size));
 		}
+		std::cout << " done." << std::endl;
 	}
-	assert(cube_data.size() == 6 * cube_size * cube_size);
+
+	//e5: all levels in one packed RGB9_E5 file; otherwise, a single +x/-x/+y/-y/+z/-z (all stacked in a column with +x at the bottom) rgbe png:
+	std::cout << "Writing final " << (e5 ? "packed RGB9_E5 cube" : "rgbe png") << "..."; std::cout.flush();
+	uint32_t overflow = save_cube_image(png_file, cube);
 	std::cout << " done." << std::endl;
-	std::cout << "Output contains " << overflow << " bright-white (likely overflow) pixels." << std::endl;
-	save_png(png_file, glm::uvec2(cube_size, 6 * cube_size), cube_data.data(), LowerLeftOrigin);
+	if (!e5) {
+		std::cout << "Output contains " << overflow << " bright-white (likely overflow) pixels." << std::endl;
+	}
+	report_peak_memory();
 
 	/*{ //DEBUG: tone map and save again:
-		assert(cube_data_float.size() == cube_size * 6 * cube_size);
 		std::cout << "Writing tone-mapped png [DEBUG-stack.png]..."; std::cout.flush();
-		save_tone_mapped_png("DEBUG-stack.png", glm::uvec2(cube_size, 6 * cube_size), cube_data_float);
+		save_tone_mapped_png("DEBUG-stack.png", cube.level_dims(0), cube.levels[0]);
 		std::cout << " done." << std::endl;
 	}*/
 }
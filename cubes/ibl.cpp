@@ -0,0 +1,165 @@
+#include "ibl.hpp"
+#include "load_hdr.hpp"
+#include "ThreadPool.hpp"
+#include "load_save_png.hpp"
+#include "rgbe_n.hpp"
+#include "rgb9e5.hpp"
+#include "cube_e5.hpp"
+
+#include <stdexcept>
+#include <cassert>
+#include <cmath>
+
+CubeImage bake_sky(LatLonImage const &latlon, uint32_t size, LatLonSampling sampling, ThreadPool *pool, Layout layout, LatLonMips const *mips) {
+	if (size < 1) throw std::runtime_error("Cube map size must be positive.");
+	if (latlon.data.size() != size_t(latlon.size.x) * latlon.size.y) throw std::runtime_error("Latlon image data doesn't match its size.");
+	CubeImage cube;
+	cube.layout = layout;
+	cube.size = size;
+	cube.levels.emplace_back();
+	latlon_to_cube(latlon.size, latlon.data, size, sampling, &cube.levels[0], pool, mips, layout);
+	return cube;
+}
+
+uint32_t FilterJob::level_samples(uint32_t level) const {
+	assert(!samples.empty());
+	if (kind == GGX) {
+		return (level == 0 ? 1 : samples[std::min< size_t >(level, samples.size()) - 1]);
+	}
+	return samples[0];
+}
+
+FilterSource::FilterSource(CubeImage const &sky_, BlurSettings const &settings_) : sky(sky_), settings(settings_) {
+	if (sky.layout != LayoutCube || sky.levels.empty() || sky.levels[0].size() != 6 * size_t(sky.size) * sky.size) {
+		throw std::runtime_error("Filters read a cube (not an octahedral map) with level 0 present.");
+	}
+}
+
+BlurInput const &FilterSource::input(bool separate_bright) {
+	std::unique_lock< std::mutex > lock(inputs_mutex);
+	std::unique_ptr< BlurInput > &input = (separate_bright ? separated_input : sharp_input);
+	if (!input) input.reset(new BlurInput(sky.size, sky.levels[0], separate_bright, settings));
+	return *input;
+}
+
+FilterResult filter_cube(FilterSource &source, FilterJob const &job, ThreadPool *pool, std::function< void(uint32_t) > const &level_done) {
+	if (job.size < 1) throw std::runtime_error("Output cube map size must be at least 1.");
+	if (job.samples.empty() || std::find(job.samples.begin(), job.samples.end(), 0U) != job.samples.end()) {
+		throw std::runtime_error("Samples per pixel must be at least 1.");
+	}
+	if (job.shard.count < 1 || job.shard.index >= job.shard.count) throw std::runtime_error("Bad shard.");
+
+	FilterResult result;
+	result.cube.layout = job.layout;
+	result.cube.size = job.size;
+
+	if (job.kind == FilterJob::SH) {
+		if (job.sh_bands < 1) throw std::runtime_error("Spherical harmonics need at least one band.");
+		if (job.shard.count != 1) throw std::runtime_error("Spherical harmonics take one pass over the input and can't be sharded.");
+		project_sh(job.sh_bands, source.sky.size, source.sky.levels[0], &result.sh, pool);
+		result.cube.levels.emplace_back();
+		reconstruct_sh(result.sh, job.size, &result.cube.levels[0], pool, job.layout);
+		if (level_done) level_done(0);
+	} else if (job.kind == FilterJob::GGX) {
+		BlurInput const &input = source.input(true);
+		uint32_t levels = ggx_levels(job.size);
+		for (uint32_t level = 0; level < levels; ++level) {
+			result.cube.levels.emplace_back();
+			blur_ggx_level(input, level, job.level_samples(level), job.size, &result.cube.levels.back(), pool, job.layout, job.shard);
+			if (level_done) level_done(level);
+		}
+	} else {
+		BlurMode mode = (job.kind == FilterJob::Diffuse ? BlurDiffuse : job.kind == FilterJob::Bokeh ? BlurBokeh : BlurSharp);
+		BlurInput const &input = source.input(job.separates_bright());
+		result.cube.levels.emplace_back();
+		blur_cube(input, mode, job.level_samples(0), job.size, &result.cube.levels[0], pool, job.layout, job.shard);
+		if (level_done) level_done(0);
+	}
+	return result;
+}
+
+LatLonImage load_latlon(std::string const &filename, ThreadPool *pool) {
+	LatLonImage image;
+	std::vector< glm::u8vec4 > rgbe;
+	load_hdr(filename, &image.size, &rgbe, pool);
+	image.data.resize(rgbe.size());
+	rgbe_to_float_n(rgbe.data(), rgbe.size(), image.data.data());
+	return image;
+}
+
+bool is_e5_filename(std::string const &filename) {
+	return filename.size() >= 3 && filename.substr(filename.size() - 3) == ".e5";
+}
+
+CubeImage load_cube_image(std::string const &filename) {
+	CubeImage cube;
+	if (is_e5_filename(filename)) {
+		CubeE5File file(filename);
+		cube.size = file.size;
+		for (uint32_t level = 0; level < file.levels; ++level) {
+			uint32_t const *texels = file.level_data(level);
+			size_t count = 6 * size_t(file.level_size(level)) * file.level_size(level);
+			cube.levels.emplace_back();
+			cube.levels.back().reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				cube.levels.back().emplace_back(rgb9e5_to_float(texels[i]));
+			}
+		}
+	} else {
+		glm::uvec2 size;
+		std::vector< glm::u8vec4 > rgbe;
+		load_png(filename, &size, &rgbe, LowerLeftOrigin);
+		if (size.y == size.x * 6) cube.layout = LayoutCube;
+		else if (size.y == size.x) cube.layout = LayoutOct;
+		else throw std::runtime_error("Expecting stacked faces or a square octahedral map in '" + filename + "'.");
+		cube.size = size.x;
+		cube.levels.emplace_back(rgbe.size());
+		rgbe_to_float_n(rgbe.data(), rgbe.size(), cube.levels[0].data());
+	}
+	return cube;
+}
+
+uint32_t save_cube_image(std::string const &filename, CubeImage const &cube) {
+	if (is_e5_filename(filename)) {
+		if (cube.layout != LayoutCube) throw std::runtime_error("Octahedral maps are only written as rgbe pngs.");
+		save_cube_e5(filename, cube.size, cube.levels);
+		return 0;
+	}
+	uint32_t overflow = 0;
+	for (uint32_t level = 0; level < cube.levels.size(); ++level) {
+		std::vector< glm::u8vec4 > rgbe(cube.levels[level].size());
+		float_to_rgbe_n(cube.levels[level].data(), cube.levels[level].size(), rgbe.data());
+		if (level == 0) {
+			for (auto const &pix : rgbe) {
+				if (pix == glm::u8vec4(0xff, 0xff, 0xff, 0xff)) ++overflow;
+			}
+		}
+		save_png(level == 0 ? filename : level_filename(filename, level), cube.level_dims(level), rgbe.data(), LowerLeftOrigin);
+	}
+	return overflow;
+}
+
+void save_tone_mapped_png(std::string const &filename, glm::uvec2 size, std::vector< glm::vec3 > const &data) {
+	std::vector< glm::u8vec4 > mapped;
+	mapped.reserve(data.size());
+	for (auto pix : data) {
+		//luminance (in lumens per steradian per square meter) of pixel:
+		// [according to picture file format docs]
+		//float lum = 179 * 0.265f * pix.r + 0.670f * pix.g + 0.065f * pix.b;
+
+		//gamma compression:
+		constexpr const float Gamma = 0.45f;
+		pix.r = std::pow(pix.r, Gamma);
+		pix.g = std::pow(pix.g, Gamma);
+		pix.b = std::pow(pix.b, Gamma);
+
+		glm::ivec3 amt = glm::ivec3(255.0f * pix);
+		mapped.emplace_back(
+			std::min(255, std::max(0, amt.r)),
+			std::min(255, std::max(0, amt.g)),
+			std::min(255, std::max(0, amt.b)),
+			0xff
+		);
+	}
+	save_png(filename, size, mapped.data(), LowerLeftOrigin);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "cube_faces.hpp"
+#include "latlon_to_cube.hpp"
+#include "cube_blur.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <stdint.h>
+
+struct ThreadPool;
+
+//In-process IBL baking: what hdr_to_cube, blur_cube, and ibl_bake compute between reading their
+// inputs and writing their outputs, as functions on in-memory images, so the game (or another tool)
+// can bake or refilter an environment without going through files or a separate process.
+//
+//Every function takes a ThreadPool to spread its work over (nullptr runs it all on the calling thread),
+// prints nothing, and throws std::runtime_error on bad arguments. Results don't depend on thread count,
+// and match the command-line tools bit-for-bit.
+
+//a latlon ("equirectangular") image, in linear floating point, rows bottom-to-top:
+struct LatLonImage {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::vec3 > data;
+};
+
+//a cube map (or octahedral map), in linear floating point, with any number of mip levels:
+struct CubeImage {
+	Layout layout = LayoutCube;
+	uint32_t size = 0; //texels on a side of each face of level 0
+	std::vector< std::vector< glm::vec3 > > levels; //level 0, then any pre-filtered levels; faces stacked as in cube_faces.hpp
+
+	uint32_t faces() const { return layout_faces(layout); }
+	uint32_t level_size(uint32_t level) const { return std::max(1U, size >> level); }
+	//dimensions of a level stored as one image (faces stacked in a column):
+	glm::uvec2 level_dims(uint32_t level) const { return glm::uvec2(level_size(level), level_size(level) * faces()); }
+};
+
+//---- sky (as hdr_to_cube) ----
+
+//resample a latlon image to a size x size cube (or octahedral map):
+// (if 'mips' is given in LatLonMip mode, it is used instead of building a pyramid for this call)
+CubeImage bake_sky(LatLonImage const &latlon, uint32_t size, LatLonSampling sampling, ThreadPool *pool, Layout layout = LayoutCube, LatLonMips const *mips = nullptr);
+
+//---- filters (as blur_cube) ----
+
+//one filtered output of a sky cube:
+struct FilterJob {
+	enum Kind {
+		Diffuse, //cosine-weighted (irradiance / pi)
+		Bokeh, //small disc
+		Sharp, //resampled, unblurred
+		GGX, //pre-filtered specular mip chain, roughness level / (levels-1)
+		SH, //projected onto spherical harmonics and reconstructed
+	} kind = Diffuse;
+	std::vector< uint32_t > samples = {200}; //per texel; for GGX, per level 1, 2, ... (the last count repeats)
+	uint32_t sh_bands = 3; //for SH: bands of coefficients (3 bands are 9 coefficients)
+	uint32_t size = 16; //of level 0 of the output
+	Layout layout = LayoutCube;
+	Shard shard; //only this share of each level's rows is computed (see cube_blur.hpp; not for SH)
+
+	//does this kind of filter pull the brightest pixels out of the input and add them analytically?
+	bool separates_bright() const { return kind == Diffuse || kind == Bokeh || kind == GGX; }
+	//samples for a level (of a GGX chain; other filters use level 0):
+	uint32_t level_samples(uint32_t level) const;
+};
+
+//a sky cube prepared for filtering:
+// the blur inputs (with and without bright pixels separated, plus their mip pyramids) are built
+// the first time a job needs them and then shared, so one source serves any number of jobs, from any threads.
+struct FilterSource {
+	//note: 'sky' is referenced (not copied), so it must outlive the source; it must be a single-level cube:
+	FilterSource(CubeImage const &sky, BlurSettings const &settings = BlurSettings());
+	FilterSource(FilterSource const &) = delete;
+	FilterSource &operator=(FilterSource const &) = delete;
+
+	CubeImage const &sky;
+	BlurSettings settings;
+
+	//input for jobs that do (or don't) separate bright pixels (built on first call):
+	BlurInput const &input(bool separate_bright);
+
+	//internals:
+	std::mutex inputs_mutex;
+	std::unique_ptr< BlurInput > separated_input, sharp_input;
+};
+
+struct FilterResult {
+	CubeImage cube; //(levels hold only the job's shard of rows; the rest are zero)
+	std::vector< glm::dvec3 > sh; //coefficients, for SH jobs
+};
+
+//run one job on a source; 'level_done(level)', if given, is called as each level finishes:
+FilterResult filter_cube(FilterSource &source, FilterJob const &job, ThreadPool *pool, std::function< void(uint32_t) > const &level_done = nullptr);
+
+//---- files ----
+
+//load an .hdr as linear floating point:
+LatLonImage load_latlon(std::string const &filename, ThreadPool *pool = nullptr);
+
+//load an rgbe png (stacked faces, or a square octahedral map; level 0 only) or an .e5 cube (every level):
+CubeImage load_cube_image(std::string const &filename);
+
+//write an .e5 (cubes only; every level in one file) or rgbe pngs (level 0 to 'filename', level i to level_filename(filename, i)):
+// returns the number of level 0 texels too bright for rgbe (written as white; pngs only)
+uint32_t save_cube_image(std::string const &filename, CubeImage const &cube);
+
+//is 'filename' an .e5 cube?
+bool is_e5_filename(std::string const &filename);
+
+//write a gamma-compressed 8-bit copy of linear data, for looking at:
+void save_tone_mapped_png(std::string const &filename, glm::uvec2 size, std::vector< glm::vec3 > const &data);
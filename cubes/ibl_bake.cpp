@@ -0,0 +1,232 @@
+#include "ibl.hpp"
+#include "ThreadPool.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+//ibl_bake runs the whole hdr_to_cube + blur_cube pipeline for one environment in one process:
+// the hdr is decoded once, every output is computed from the same in-memory (floating point) data,
+// and all jobs share one thread pool, so a slow job (e.g. a big png write) overlaps with the others.
+
+//write a cube (see save_cube_image), and (if asked) tone-mapped copies of each level:
+void save_cube(std::string const &filename, CubeImage const &cube, bool debug) {
+	save_cube_image(filename, cube);
+	if (debug) {
+		for (uint32_t level = 0; level < cube.levels.size(); ++level) {
+			std::string level_file = level_filename(filename, level);
+			if (is_e5_filename(level_file)) level_file += ".png";
+			auto slash = level_file.rfind('/');
+			std::string base = (slash == std::string::npos ? level_file : level_file.substr(slash + 1));
+			save_tone_mapped_png("DEBUG-" + base, cube.level_dims(level), cube.levels[level]);
+		}
+	}
+}
+
+struct Job {
+	std::string kind; //"sky", "diffuse", "bokeh", "sharp", "ggx", or "shN"
+	FilterJob filter; //for everything but "sky" (for which only .size is used)
+	std::string out_file;
+	CubeImage cube; //result of a "sky" job
+};
+
+int main(int argc, char **argv) {
+	//pull out options, leaving positional arguments:
+	std::vector< std::string > args;
+	int32_t threads = 0;
+	bool debug = false;
+	LatLonSampling sampling = LatLonPoint;
+	BlurSettings settings;
+	int32_t source_size = 512;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[i+1]);
+			++i;
+		} else if (arg == "--debug") {
+			debug = true;
+		} else if (arg == "--sampling" && i + 1 < argc) {
+			std::string name = argv[i+1];
+			if (name == "point") sampling = LatLonPoint;
+			else if (name == "mip") sampling = LatLonMip;
+			else {
+				std::cerr << "Sampling must be 'point' or 'mip'." << std::endl;
+				return 1;
+			}
+			++i;
+		} else if (arg == "--sampler" && i + 1 < argc) {
+			std::string name = argv[i+1];
+			if (name == "random") settings.sampler = SamplerRandom;
+			else if (name == "hammersley") settings.sampler = SamplerHammersley;
+			else if (name == "sobol") settings.sampler = SamplerSobol;
+			else {
+				std::cerr << "Sampler must be 'random', 'hammersley', or 'sobol'." << std::endl;
+				return 1;
+			}
+			++i;
+		} else if (arg == "--lookup" && i + 1 < argc) {
+			std::string name = argv[i+1];
+			if (name != "nearest" && name != "mip") {
+				std::cerr << "Lookup must be 'nearest' or 'mip'." << std::endl;
+				return 1;
+			}
+			settings.mip_lookup = (name == "mip");
+			++i;
+		} else if (arg == "--brightest" && i + 1 < argc) {
+			settings.brightest = uint32_t(std::max(0, std::atoi(argv[i+1])));
+			++i;
+		} else if (arg == "--source-size" && i + 1 < argc) {
+			source_size = std::atoi(argv[i+1]);
+			++i;
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./ibl_bake [--threads N] [--debug] [--sampling point|mip] [--sampler random|hammersley|sobol] [--lookup nearest|mip] [--brightest N] [--source-size N] <latlon.hdr> <job> [<job> ...]\n"
+		             "Bake several cube maps from one hdr in one run. Jobs are:\n"
+		             "\tsky <size> <out.png>                        (as hdr_to_cube)\n"
+		             "\tdiffuse|bokeh|sharp <samples> <size> <out.png>  (as blur_cube)\n"
+		             "\tggx <samples[,..]> <size> <out.png>         (as blur_cube; also writes <out.N.png> levels)\n"
+		             "\tshN <size> <out.png>                        (as blur_cube; also writes <out.png>.sh.txt)\n"
+		             "Blurs read the (floating point) cube of the first sky job, or a --source-size cube (default 512) if there is none.\n"
+		             "(--threads 0, the default, uses all cores; output does not depend on thread count)\n"
+		             "Output names ending in .e5 get packed RGB9_E5 cube files (see ../cube_e5.hpp) instead of rgbe pngs; a ggx .e5 holds every level.\n"
+		             "(--debug also writes tone-mapped DEBUG-<out>.png copies of each output; other options are as for hdr_to_cube and blur_cube)" << std::endl;
+	};
+
+	if (args.size() < 2) {
+		usage();
+		return 1;
+	}
+	std::string hdr_file = args[0];
+
+	std::vector< Job > jobs;
+	for (uint32_t a = 1; a < args.size(); /* later */) {
+		Job job;
+		job.kind = args[a];
+		bool blur = (job.kind == "diffuse" || job.kind == "bokeh" || job.kind == "sharp" || job.kind == "ggx");
+		if (job.kind == "diffuse") job.filter.kind = FilterJob::Diffuse;
+		else if (job.kind == "bokeh") job.filter.kind = FilterJob::Bokeh;
+		else if (job.kind == "sharp") job.filter.kind = FilterJob::Sharp;
+		else if (job.kind == "ggx") job.filter.kind = FilterJob::GGX;
+		if (job.kind.size() > 2 && job.kind.substr(0,2) == "sh" && job.kind != "sharp") {
+			int32_t coefficients = std::atoi(job.kind.substr(2).c_str());
+			job.filter.kind = FilterJob::SH;
+			job.filter.sh_bands = uint32_t(std::round(std::sqrt(float(std::max(0, coefficients)))));
+			if (job.filter.sh_bands < 1 || int32_t(job.filter.sh_bands * job.filter.sh_bands) != coefficients) {
+				std::cerr << "Spherical harmonics jobs must be 'shN' with N a square (1, 4, 9, 16, ...)." << std::endl;
+				return 1;
+			}
+		} else if (job.kind != "sky" && !blur) {
+			std::cerr << "Unknown job '" << job.kind << "'." << std::endl;
+			usage();
+			return 1;
+		}
+		uint32_t params = (blur ? 3 : 2);
+		if (a + params >= args.size()) {
+			std::cerr << "Job '" << job.kind << "' needs " << params << " parameters." << std::endl;
+			usage();
+			return 1;
+		}
+		if (blur) {
+			job.filter.samples.clear();
+			for (std::string list = args[a+1]; ; ) {
+				auto comma = list.find(',');
+				int32_t count = std::atoi(list.substr(0, comma).c_str());
+				if (count < 1) {
+					std::cerr << "Samples per pixel must be at least 1." << std::endl;
+					return 1;
+				}
+				job.filter.samples.emplace_back(uint32_t(count));
+				if (comma == std::string::npos) break;
+				list = list.substr(comma + 1);
+			}
+		}
+		int32_t size = std::atoi(args[a + params - 1].c_str());
+		if (size < 1) {
+			std::cerr << "Cube map size must be positive." << std::endl;
+			return 1;
+		}
+		job.filter.size = uint32_t(size);
+		job.out_file = args[a + params];
+		jobs.emplace_back(std::move(job));
+		a += params + 1;
+	}
+	if (threads < 0) {
+		std::cerr << "Thread count must be non-negative." << std::endl;
+		return 1;
+	}
+	if (source_size < 1) {
+		std::cerr << "Source size must be positive." << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto since_start = [&start]() -> double {
+		return std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	ThreadPool pool(threads);
+
+	//decode once:
+	LatLonImage latlon = load_latlon(hdr_file, &pool);
+	std::cout << "Loaded a " << latlon.size.x << " x " << latlon.size.y << " hdr image from '" << hdr_file << "' in " << since_start() << " seconds." << std::endl;
+
+	//sky cubes (and the blur source, if no sky job is given):
+	std::vector< Job * > skies;
+	bool any_blur = false;
+	for (auto &job : jobs) {
+		if (job.kind == "sky") skies.emplace_back(&job);
+		else any_blur = true;
+	}
+	Job source_job;
+	if (any_blur && skies.empty()) {
+		source_job.kind = "sky";
+		source_job.filter.size = uint32_t(source_size);
+		skies.emplace_back(&source_job);
+	}
+	{
+		std::unique_ptr< LatLonMips > mips;
+		if (sampling == LatLonMip) mips.reset(new LatLonMips(latlon.size, latlon.data));
+		pool.parallel_for(uint32_t(skies.size()), [&](uint32_t i) {
+			skies[i]->cube = bake_sky(latlon, skies[i]->filter.size, sampling, &pool, LayoutCube, mips.get());
+		});
+	}
+	latlon = LatLonImage();
+	std::cout << "Resampled " << skies.size() << " sky cube(s); " << since_start() << " seconds elapsed." << std::endl;
+
+	//blur inputs, shared by all jobs that need them (built here, rather than by whichever job gets there first, so no job waits on another):
+	std::unique_ptr< FilterSource > source;
+	if (!skies.empty()) source.reset(new FilterSource(skies[0]->cube, settings));
+	for (auto const &job : jobs) {
+		if (job.kind != "sky" && job.filter.kind != FilterJob::SH) source->input(job.filter.separates_bright());
+	}
+
+	//every output (including writing sky pngs) is a job on the shared pool:
+	std::mutex report_mutex;
+	pool.parallel_for(uint32_t(jobs.size()), [&](uint32_t j) {
+		Job const &job = jobs[j];
+		auto before = std::chrono::high_resolution_clock::now();
+		if (job.kind == "sky") {
+			save_cube(job.out_file, job.cube, debug);
+		} else {
+			//(an .e5 output holds all levels in one file; pngs get one file per level)
+			FilterResult result = filter_cube(*source, job.filter, &pool);
+			if (job.filter.kind == FilterJob::SH) save_sh(job.out_file + ".sh.txt", result.sh);
+			save_cube(job.out_file, result.cube, debug);
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+		std::unique_lock< std::mutex > lock(report_mutex);
+		std::cout << "  " << job.kind << " " << job.filter.size << " -> '" << job.out_file << "' in " << std::chrono::duration< double >(after - before).count() << " seconds." << std::endl;
+	});
+
+	std::cout << "Baked " << jobs.size() << " job(s) in " << since_start() << " seconds on " << pool.size() << " threads." << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,372 @@
+#include "latlon_to_cube.hpp"
+#include "cube_faces.hpp"
+#include "cube_lookup.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <cassert>
+#include <cmath>
+
+glm::vec2 direction_to_latlon(glm::vec3 const &dir) {
+	float lon = std::atan2(dir.y, dir.x);
+	float lat = std::atan2(dir.z, glm::length(glm::vec2(dir)));
+	float s = ((lon / M_PI) + 1.0f) / 2.0f;
+	float t = ((lat / (0.5f * M_PI)) + 1.0f) / 2.0f;
+	return glm::vec2(s, t);
+}
+
+LatLonMips::LatLonMips(glm::uvec2 size, std::vector< glm::vec3 > const &data) {
+	assert(data.size() == size.x * size.y);
+	levels.emplace_back();
+	levels.back().size = size;
+	levels.back().data = data.data();
+	while (levels.back().size.x > 1 || levels.back().size.y > 1) {
+		Level const &src = levels.back();
+		Level dst;
+		dst.size = glm::uvec2((src.size.x + 1) / 2, (src.size.y + 1) / 2);
+		dst.storage.reserve(dst.size.x * dst.size.y);
+		for (uint32_t y = 0; y < dst.size.y; ++y) {
+			uint32_t y0 = 2 * y;
+			uint32_t y1 = std::min(2 * y + 1, src.size.y - 1);
+			for (uint32_t x = 0; x < dst.size.x; ++x) {
+				uint32_t x0 = 2 * x;
+				uint32_t x1 = (2 * x + 1) % src.size.x;
+				dst.storage.emplace_back(0.25f * (
+					  src.data[y0 * src.size.x + x0] + src.data[y0 * src.size.x + x1]
+					+ src.data[y1 * src.size.x + x0] + src.data[y1 * src.size.x + x1]
+				));
+			}
+		}
+		dst.data = dst.storage.data();
+		levels.emplace_back(std::move(dst));
+	}
+}
+
+glm::vec3 LatLonMips::bilinear(uint32_t level, glm::vec2 const &st) const {
+	Level const &l = levels[level];
+	float x = st.x * l.size.x - 0.5f;
+	float y = st.y * l.size.y - 0.5f;
+	float fx = std::floor(x);
+	float fy = std::floor(y);
+	float ax = x - fx;
+	float ay = y - fy;
+	int32_t w = int32_t(l.size.x);
+	int32_t h = int32_t(l.size.y);
+	int32_t x0 = ((int32_t(fx) % w) + w) % w;
+	int32_t x1 = (x0 + 1) % w;
+	int32_t y0 = std::max(0, std::min(h - 1, int32_t(fy)));
+	int32_t y1 = std::max(0, std::min(h - 1, int32_t(fy) + 1));
+	return (1.0f - ay) * ((1.0f - ax) * l.data[y0 * w + x0] + ax * l.data[y0 * w + x1])
+	     +         ay  * ((1.0f - ax) * l.data[y1 * w + x0] + ax * l.data[y1 * w + x1]);
+}
+
+namespace {
+
+//cube faces are resampled in square tiles of this many texels on a side:
+constexpr uint32_t TileSize = 32;
+
+//nearest pixel of a latlon image for a direction:
+glm::uvec2 nearest_latlon_pixel(glm::uvec2 size, glm::vec3 const &dir) {
+	glm::vec2 st = direction_to_latlon(dir);
+	float s = st.x;
+	float t = st.y;
+	//clamp (shouldn't be needed?):
+	s = std::max(0.0f, std::min(1.0f, s));
+	t = std::max(0.0f, std::min(1.0f, t));
+
+	//return value from nearest pixel center:
+	glm::ivec2 px = glm::ivec2(std::floor(size.x*s), std::floor(size.y*t));
+	//clamp (may be needed if sampling exactly the right or left edge):
+	px.x = std::max(0, std::min(int32_t(size.x)-1, px.x));
+	px.y = std::max(0, std::min(int32_t(size.y)-1, px.y));
+	return glm::uvec2(px);
+}
+
+//'point' mode samples multiple times per texel, as (s offset, t offset, weight):
+std::vector< glm::vec3 > point_samples() {
+	std::vector< glm::vec3 > samples;
+	//even sampling over texel area:
+	constexpr uint32_t Count = 6; //6x6 = 36 samples
+	for (uint32_t t = 0; t < Count; ++t) {
+		for (uint32_t s = 0; s < Count; ++s) {
+			samples.emplace_back(
+				(s + 0.5f) / float(Count),
+				(t + 0.5f) / float(Count),
+				1.0f / float(Count * Count)
+			);
+		}
+	}
+	return samples;
+}
+
+//point-sample texels [s0,s1) x [t0,t1) of face f, writing texel (s,t) to out[(t - t0) * stride + (s - s0)]:
+template< typename Lookup >
+void sample_point_tile(TexelDirections const &directions, uint32_t f,
+	uint32_t s0, uint32_t t0, uint32_t s1, uint32_t t1,
+	std::vector< glm::vec3 > const &samples, Lookup const &lookup, glm::vec3 *out, uint32_t stride) {
+	//sample positions and directions of one texel, computed together (see cube_lookup.hpp):
+	size_t count = samples.size();
+	std::vector< float > ps(count), pt(count), x(count), y(count), z(count);
+	for (uint32_t t = t0; t < t1; ++t) {
+		for (uint32_t s = s0; s < s1; ++s) {
+			for (size_t i = 0; i < count; ++i) {
+				ps[i] = s + 0.5f + samples[i].x;
+				pt[i] = t + 0.5f + samples[i].y;
+			}
+			texel_directions_n(directions, f, ps.data(), pt.data(), count, x.data(), y.data(), z.data());
+			glm::vec3 acc = glm::vec3(0.0f);
+			for (size_t i = 0; i < count; ++i) {
+				acc += samples[i].z * lookup(glm::vec3(x[i], y[i], z[i]));
+			}
+			out[(t - t0) * stride + (s - s0)] = acc;
+		}
+	}
+}
+
+//first and last row of a latlon image that point samples of texels [s0,s1) x [t0,t1) of a face can read:
+glm::uvec2 point_tile_rows(glm::uvec2 size, uint32_t cube_size, glm::vec3 const &sc, glm::vec3 const &tc, glm::vec3 const &ma,
+	uint32_t s0, uint32_t t0, uint32_t s1, uint32_t t1) {
+	//samples fall within [s0 + 0.5, s1 + 0.5] x [t0 + 0.5, t1 + 0.5] (in texels).
+	// Over that rectangle, latitude only has an extreme at a pole (the center of the +z / -z faces),
+	// and along each edge it is monotonic on either side of the face's center line,
+	// so checking corners, center-line crossings, and the center bounds it:
+	float lo[2] = {s0 + 0.5f, t0 + 0.5f};
+	float hi[2] = {s1 + 0.5f, t1 + 0.5f};
+	float mid = 0.5f * cube_size;
+	std::vector< float > candidates[2];
+	for (uint32_t a = 0; a < 2; ++a) {
+		candidates[a] = {lo[a], hi[a]};
+		if (lo[a] < mid && mid < hi[a]) candidates[a].emplace_back(mid);
+	}
+	float t_min = 1.0f;
+	float t_max = 0.0f;
+	for (float u : candidates[0]) {
+		for (float v : candidates[1]) {
+			glm::vec3 dir = ma + (2.0f * u / cube_size - 1.0f) * sc + (2.0f * v / cube_size - 1.0f) * tc;
+			float t = direction_to_latlon(dir).y;
+			t_min = std::min(t_min, t);
+			t_max = std::max(t_max, t);
+		}
+	}
+	//(a row of slack on each side covers rounding differences from the per-sample computation)
+	int32_t row_min = int32_t(std::floor(size.y * std::max(0.0f, t_min))) - 1;
+	int32_t row_max = int32_t(std::floor(size.y * std::min(1.0f, t_max))) + 1;
+	return glm::uvec2(
+		uint32_t(std::max(0, std::min(int32_t(size.y) - 1, row_min))),
+		uint32_t(std::max(0, std::min(int32_t(size.y) - 1, row_max)))
+	);
+}
+
+}
+
+void latlon_to_cube(glm::uvec2 size, std::vector< glm::vec3 > const &image, uint32_t cube_size, LatLonSampling sampling, std::vector< glm::vec3 > *cube_, ThreadPool *pool, LatLonMips const *mips, Layout layout) {
+	assert(cube_);
+	auto &cube = *cube_;
+	assert(image.size() == size.x * size.y);
+
+	//in 'mip' mode, the float data becomes the base of a mip pyramid:
+	std::unique_ptr< LatLonMips > own_mips;
+	if (sampling == LatLonMip && !mips) {
+		own_mips.reset(new LatLonMips(size, image));
+		mips = own_mips.get();
+	}
+	if (sampling != LatLonMip) mips = nullptr;
+
+	//function for sampling a given direction from latlon map:
+	auto lookup = [&image,&size](glm::vec3 const &dir) -> glm::vec3 {
+		glm::uvec2 px = nearest_latlon_pixel(size, dir);
+		return image[px.y*size.x+px.x];
+	};
+
+	std::vector< glm::vec3 > samples = point_samples();
+	//in 'mip' mode, each texel is instead covered by MipTaps x MipTaps filtered lookups:
+	constexpr uint32_t MipTaps = 4;
+
+	TexelDirections directions(layout, cube_size);
+
+	cube.assign(directions.faces * cube_size * cube_size, glm::vec3(0.0f));
+
+	//split faces into square tiles of texels; each tile writes only its own texels,
+	// so results do not depend on how tiles are scheduled:
+	uint32_t tiles_per_side = (cube_size + TileSize - 1) / TileSize;
+	uint32_t tiles_per_face = tiles_per_side * tiles_per_side;
+
+	auto sample_tile = [&](uint32_t tile) {
+		uint32_t f = tile / tiles_per_face;
+		uint32_t t0 = ((tile % tiles_per_face) / tiles_per_side) * TileSize;
+		uint32_t s0 = ((tile % tiles_per_face) % tiles_per_side) * TileSize;
+		uint32_t t1 = std::min(t0 + TileSize, cube_size);
+		uint32_t s1 = std::min(s0 + TileSize, cube_size);
+
+		glm::vec3 *face = cube.data() + f * cube_size * cube_size;
+
+		if (mips) {
+			//latlon coordinates of the texel corners in this tile, shared by neighbouring texels:
+			uint32_t stride = s1 - s0 + 1;
+			std::vector< glm::vec2 > corners;
+			corners.reserve(stride * (t1 - t0 + 1));
+			std::vector< float > ps(stride), pt(stride), x(stride), y(stride), z(stride);
+			for (uint32_t t = t0; t <= t1; ++t) {
+				for (uint32_t s = s0; s <= s1; ++s) {
+					ps[s - s0] = float(s);
+					pt[s - s0] = float(t);
+				}
+				texel_directions_n(directions, f, ps.data(), pt.data(), stride, x.data(), y.data(), z.data());
+				for (uint32_t i = 0; i < stride; ++i) {
+					corners.emplace_back(direction_to_latlon(glm::vec3(x[i], y[i], z[i])));
+				}
+			}
+
+			for (uint32_t t = t0; t < t1; ++t) {
+				for (uint32_t s = s0; s < s1; ++s) {
+					glm::vec2 c00 = corners[(t - t0) * stride + (s - s0)];
+					glm::vec2 c10 = corners[(t - t0) * stride + (s - s0) + 1];
+					glm::vec2 c01 = corners[(t - t0 + 1) * stride + (s - s0)];
+					glm::vec2 c11 = corners[(t - t0 + 1) * stride + (s - s0) + 1];
+					//unwrap longitude relative to first corner, so texels on the seam don't span the whole image:
+					for (glm::vec2 *c : {&c10, &c01, &c11}) {
+						if (c->x - c00.x > 0.5f) c->x -= 1.0f;
+						if (c->x - c00.x < -0.5f) c->x += 1.0f;
+					}
+					glm::vec2 lo = glm::min(glm::min(c00, c10), glm::min(c01, c11));
+					glm::vec2 hi = glm::max(glm::max(c00, c10), glm::max(c01, c11));
+
+					//footprint size in (level zero) pixels; rows near the poles are oversampled horizontally by 1/cos(latitude):
+					float lat = (0.5f * (lo.y + hi.y) - 0.5f) * float(M_PI);
+					float footprint = std::max((hi.y - lo.y) * size.y, (hi.x - lo.x) * size.x * std::cos(lat));
+					uint32_t level = uint32_t(std::log2(std::max(1.0f, footprint / MipTaps)) + 0.5f);
+					level = std::min(level, uint32_t(mips->levels.size()) - 1);
+
+					//small texels are close enough to affine in latlon space to interpolate corners;
+					// texels near (or containing) a pole need their taps mapped exactly:
+					bool affine = (hi.x - lo.x) < 1.0f / 16.0f;
+
+					glm::vec3 acc = glm::vec3(0.0f);
+					for (uint32_t j = 0; j < MipTaps; ++j) {
+						float v = (j + 0.5f) / MipTaps;
+						for (uint32_t i = 0; i < MipTaps; ++i) {
+							float u = (i + 0.5f) / MipTaps;
+							glm::vec2 st;
+							if (affine) {
+								st = (1.0f - v) * ((1.0f - u) * c00 + u * c10) + v * ((1.0f - u) * c01 + u * c11);
+							} else {
+								st = direction_to_latlon(directions(f, s + u, t + v));
+							}
+							acc += mips->bilinear(level, st);
+						}
+					}
+					face[t * cube_size + s] = acc * (1.0f / (MipTaps * MipTaps));
+				}
+			}
+			return;
+		}
+
+		sample_point_tile(directions, f, s0, t0, s1, t1, samples, lookup, face + t0 * cube_size + s0, cube_size);
+	};
+
+	uint32_t tiles = directions.faces * tiles_per_face;
+	if (pool) {
+		pool->parallel_for(tiles, sample_tile);
+	} else {
+		for (uint32_t tile = 0; tile < tiles; ++tile) sample_tile(tile);
+	}
+}
+
+void latlon_to_cube_banded(glm::uvec2 size, uint32_t max_rows, std::function< void(uint32_t, uint32_t, glm::vec3 *) > const &read_rows, uint32_t cube_size, std::function< void(uint32_t, uint32_t, uint32_t, uint32_t, glm::vec3 const *) > const &write_texels, ThreadPool *pool) {
+	std::vector< glm::vec3 > samples = point_samples();
+
+	TexelDirections directions(LayoutCube, cube_size);
+
+	struct Tile {
+		uint32_t f, s0, t0, s1, t1;
+		glm::uvec2 rows; //first and last latlon row read
+	};
+	//tiles near the poles span many rows, so use smaller tiles until every tile fits in the window:
+	// (each texel is computed on its own, so tile size doesn't change results)
+	std::vector< Tile > tiles;
+	for (uint32_t tile_size = TileSize; ; tile_size /= 2) {
+		uint32_t tiles_per_side = (cube_size + tile_size - 1) / tile_size;
+		uint32_t tiles_per_face = tiles_per_side * tiles_per_side;
+		tiles.clear();
+		tiles.reserve(6 * tiles_per_face);
+		uint32_t widest = 0;
+		for (uint32_t tile = 0; tile < 6 * tiles_per_face; ++tile) {
+			Tile t;
+			t.f = tile / tiles_per_face;
+			t.t0 = ((tile % tiles_per_face) / tiles_per_side) * tile_size;
+			t.s0 = ((tile % tiles_per_face) % tiles_per_side) * tile_size;
+			t.t1 = std::min(t.t0 + tile_size, cube_size);
+			t.s1 = std::min(t.s0 + tile_size, cube_size);
+			t.rows = point_tile_rows(size, cube_size, directions.sc[t.f], directions.tc[t.f], directions.ma[t.f], t.s0, t.t0, t.s1, t.t1);
+			widest = std::max(widest, t.rows.y - t.rows.x + 1);
+			tiles.emplace_back(t);
+		}
+		if (widest <= max_rows) break;
+		if (tile_size == 1) {
+			throw std::runtime_error("A texel of the cube reads " + std::to_string(widest) + " rows of the latlon image, but only " + std::to_string(max_rows) + " rows fit in memory.");
+		}
+	}
+	//visit tiles in order of the first row they read:
+	std::stable_sort(tiles.begin(), tiles.end(), [](Tile const &a, Tile const &b) {
+		return a.rows.x < b.rows.x;
+	});
+
+	//rows [window_begin, window_end) of the image, held in 'window':
+	uint32_t window_begin = 0;
+	uint32_t window_end = 0;
+	std::vector< glm::vec3 > window(size_t(std::min(max_rows, size.y)) * size.x);
+
+	std::vector< bool > done(tiles.size(), false);
+	std::vector< uint32_t > batch;
+	for (uint32_t first = 0; first < tiles.size(); /* later */) {
+		if (done[first]) {
+			++first;
+			continue;
+		}
+		//slide the window to start at the first row the next tile needs, keeping rows already read:
+		uint32_t begin = tiles[first].rows.x;
+		uint32_t end = std::min(size.y, begin + max_rows);
+		assert(begin >= window_begin);
+		uint32_t keep_begin = std::min(std::max(begin, window_begin), window_end);
+		if (keep_begin < window_end) {
+			std::copy(window.begin() + size_t(keep_begin - window_begin) * size.x, window.begin() + size_t(window_end - window_begin) * size.x, window.begin());
+		}
+		uint32_t read_begin = std::max(begin, window_end);
+		if (read_begin < end) {
+			read_rows(read_begin, end, window.data() + size_t(read_begin - begin) * size.x);
+		}
+		window_begin = begin;
+		window_end = end;
+
+		//sample every waiting tile that the window covers:
+		batch.clear();
+		for (uint32_t i = first; i < tiles.size() && tiles[i].rows.x < window_end; ++i) {
+			if (!done[i] && tiles[i].rows.y < window_end) {
+				batch.emplace_back(i);
+				done[i] = true;
+			}
+		}
+		auto lookup = [&](glm::vec3 const &dir) -> glm::vec3 {
+			glm::uvec2 px = nearest_latlon_pixel(size, dir);
+			assert(px.y >= window_begin && px.y < window_end);
+			return window[size_t(px.y - window_begin) * size.x + px.x];
+		};
+		auto sample_tile = [&](uint32_t index) {
+			Tile const &t = tiles[batch[index]];
+			uint32_t width = t.s1 - t.s0;
+			std::vector< glm::vec3 > texels(width * (t.t1 - t.t0));
+			sample_point_tile(directions, t.f, t.s0, t.t0, t.s1, t.t1, samples, lookup, texels.data(), width);
+			for (uint32_t row = t.t0; row < t.t1; ++row) {
+				write_texels(t.f, row, t.s0, t.s1, texels.data() + (row - t.t0) * width);
+			}
+		};
+		if (pool) {
+			pool->parallel_for(uint32_t(batch.size()), sample_tile);
+		} else {
+			for (uint32_t i = 0; i < batch.size(); ++i) sample_tile(i);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cube_faces.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+struct ThreadPool;
+
+//Resampling of latitude/longitude ("equirectangular") images to cube maps.
+
+enum LatLonSampling {
+	LatLonPoint, //36 nearest-pixel samples per texel
+	LatLonMip, //MipTaps x MipTaps bilinear lookups per texel, from a level of a box-filtered pyramid matching the texel's footprint
+};
+
+//map a direction to (s,t) texture coordinates in the latlon image:
+// (s is not wrapped and t is not clamped; both are nominally in [0,1])
+glm::vec2 direction_to_latlon(glm::vec3 const &dir);
+
+//box-filtered mip pyramid over a latlon image, for area-filtered lookups:
+// (horizontal wraps around, vertical clamps)
+struct LatLonMips {
+	struct Level {
+		glm::uvec2 size;
+		std::vector< glm::vec3 > storage; //empty for level zero, which refers to the caller's image
+		glm::vec3 const *data;
+	};
+	std::vector< Level > levels;
+
+	//note: 'data' is used (not copied) as level zero, so it must outlive the pyramid:
+	LatLonMips(glm::uvec2 size, std::vector< glm::vec3 > const &data);
+	LatLonMips(LatLonMips const &) = delete;
+	LatLonMips &operator=(LatLonMips const &) = delete;
+
+	glm::vec3 bilinear(uint32_t level, glm::vec2 const &st) const;
+};
+
+//fill 'cube' with a cube_size cube (faces stacked, as in cube_faces.hpp) resampled from a latlon image:
+// (if 'pool' is given, tiles of texels are sampled in parallel on it; results do not depend on thread count)
+// (if 'mips' is given in LatLonMip mode, it is used instead of building a pyramid for this call)
+// (with LayoutOct, 'cube' is instead filled with a cube_size x cube_size octahedral map)
+void latlon_to_cube(glm::uvec2 size, std::vector< glm::vec3 > const &data, uint32_t cube_size, LatLonSampling sampling, std::vector< glm::vec3 > *cube, ThreadPool *pool = nullptr, LatLonMips const *mips = nullptr, Layout layout = LayoutCube);
+
+//'point' resampling of a latlon image too large to hold whole:
+// rows are asked for in bands by read_rows(y0, y1, rows), which fills rows[(y - y0) * size.x + x] for y in [y0,y1),
+// and at most 'max_rows' rows are held at once (each row is asked for once; tiles run in order of the rows they read).
+// Finished texels are handed to write_texels(face, t, s0, s1, texels) a row of a tile at a time,
+// possibly from several threads at once (for different texels).
+// Results match latlon_to_cube(..., LatLonPoint, ...). Throws if some tile needs more than 'max_rows' rows.
+void latlon_to_cube_banded(glm::uvec2 size, uint32_t max_rows, std::function< void(uint32_t, uint32_t, glm::vec3 *) > const &read_rows, uint32_t cube_size, std::function< void(uint32_t, uint32_t, uint32_t, uint32_t, glm::vec3 const *) > const &write_texels, ThreadPool *pool = nullptr);
@@ -1,34 +1,47 @@
 #include "load_hdr.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
 #include <iostream>
-#include <fstream>
 #include <sstream>
-
-#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <algorithm>
 
 //with reference to:
 //  http://paulbourke.net/dataformats/pic/
 //and the 'pic' section of:
 //  http://radsite.lbl.gov/radiance/refer/filefmts.pdf
 
-void load_hdr(std::string const &filename, glm::uvec2 *size_, std::vector< glm::u8vec4 > *data_) {
-	assert(size_);
-	assert(data_);
-	auto &size = *size_;
-	auto &data = *data_;
+//The file is mapped (not read) and decoded in two passes:
+// (1) walk the run codes of every scanline to find where each one starts (cheap; no pixels written)
+// (2) decode scanlines in parallel, writing every pixel straight to its flipped/transposed position
+//     (or, for HDRFile::read_rows, only the scanlines of a band of rows)
+
+HDRFile::HDRFile(std::string const &filename_, bool low_memory) : file(filename_), filename(filename_) {
+	uint8_t const *begin = file.data;
+	uint8_t const *end = file.data + file.size;
+	uint8_t const *at = begin;
+
+	auto get_line = [&at,&end](std::string *line) -> bool {
+		if (at == end) return false;
+		uint8_t const *nl = reinterpret_cast< uint8_t const * >(std::memchr(at, '\n', end - at));
+		if (!nl) nl = end;
+		*line = std::string(reinterpret_cast< char const * >(at), nl - at);
+		at = (nl == end ? end : nl + 1);
+		return true;
+	};
 
-	std::ifstream in(filename, std::ios::binary);
 	{ //check header:
-		char header[11]; //expecting "#?RADIANCE\n"
-		in.read(header, 11);
-		if (std::string(header, header+11) != "#?RADIANCE\n") {
+		if (end - at < 11 || std::string(reinterpret_cast< char const * >(at), 11) != "#?RADIANCE\n") {
 			throw std::runtime_error("hdr file '" + filename + "' does not start with expected header.");
 		}
+		at += 11;
 	}
 	{ //read information lines:
 		std::string FORMAT = "";
 
 		std::string line;
-		while (std::getline(in, line)) {
+		while (get_line(&line)) {
 			if (line == "") break; //blank line is end of headers.
 			if (line[0] == '#') continue; //ignore comment/info lines
 			{ //look for assignments:
@@ -41,6 +54,7 @@ void load_hdr(std::string const &filename, glm::uvec2 *size_, std::vector< glm::
 					} else {
 						//silently ignore.
 					}
+					continue;
 				}
 			}
 			std::cerr << "WARNING: unknown header line: '" << line << "'" << std::endl;
@@ -55,18 +69,14 @@ void load_hdr(std::string const &filename, glm::uvec2 *size_, std::vector< glm::
 		}
 	}
 
-	//indicate how picture needs to be flipped after reading in order to arrive at a lower-left-origin coordinate system:
-	bool flip_y;
-	bool flip_x;
-	bool transpose;
 	{ //read resolution line:
 		std::string line;
-		if (!getline(in, line)) {
+		if (!get_line(&line)) {
 			throw std::runtime_error("hdr file '" + filename + "' missing resolution string.");
 		}
 		std::istringstream str(line);
 		std::string l1, l2;
-		if (!(str >> l1 >> size.y >> l2 >> size.x)) {
+		if (!(str >> l1 >> stored_size.y >> l2 >> stored_size.x)) {
 			throw std::runtime_error("hdr file '" + filename + "' has bad resolution line '" + line + "'.");
 		}
 		std::string temp;
@@ -92,125 +102,190 @@ void load_hdr(std::string const &filename, glm::uvec2 *size_, std::vector< glm::
 		}
 	}
 
-	data.resize(size.x*size.y);
-
-	//read the scanlines:
+	size = (transpose ? glm::uvec2(stored_size.y, stored_size.x) : stored_size);
 
-	auto get_pix = [&in,&filename]() -> glm::u8vec4 {
-		glm::u8vec4 ret;
-		if (!in.read(reinterpret_cast< char * >(glm::value_ptr(ret)), 4)) {
-			throw std::runtime_error("hdr file '" + filename + "' did not have a pixel when we were expecting one.");
-		}
-		return ret;
+	//pass 1: find the start of each scanline:
+	// (when asked to use little memory, pages already walked are handed back as we go)
+	scanlines.reserve(stored_size.y + 1);
+	uint8_t const *released = begin;
+	auto overrun = [this]() {
+		throw std::runtime_error("hdr file '" + filename + "' did not have a byte when we were expecting one.");
 	};
-	auto get_byte = [&in,&filename]() -> uint8_t {
-		uint8_t ret;
-		if (!in.read(reinterpret_cast< char * >(&ret), 1)) {
-			throw std::runtime_error("hdr file '" + filename + "' did not have a byte when we were expecting one.");
-		}
-		return ret;
+	auto too_many_repeats = [this]() { //(a fourth old-style repeat in a row would shift its count by 32 or more)
+		throw std::runtime_error("hdr file '" + filename + "' specifies too many consecutive repeats in a scanline");
 	};
-
-	for (uint32_t y = 0; y < size.y; ++y) {
+	for (uint32_t y = 0; y < stored_size.y; ++y) {
+		if (low_memory && at - released > (16 << 20)) {
+			file.release(released, at);
+			released = at;
+		}
 		//with reference to read code in ray/src/common/color.c (radiance source code)
-
+		scanlines.emplace_back(at);
+		if (end - at < 4) overrun();
 		//Look at first pixel of line to determine format:
-		glm::u8vec4 pix = get_pix();
-		//"new" RLE format [separated components]:
-		if (pix.r == 2 && pix.g == 2 && (pix.b & 128) == 0) {
-			uint32_t len = (uint32_t(pix.b) << 8) | uint32_t(pix.a);
-			if (len != size.x) {
-				throw std::runtime_error("hdr file '" + filename + "' has scanline that should be new RLE but reports an incorrect length (" + std::to_string(len) + " instead of " + std::to_string(size.x) + ").");
-			}
+		if (at[0] == 2 && at[1] == 2 && (at[2] & 128) == 0) {
+			//"new" RLE format [separated components]:
+			at += 4;
 			for (uint32_t c = 0; c < 4; ++c) {
-				for (uint32_t x = 0; x < size.x; /* later */) {
-					uint8_t code = get_byte();
+				for (uint32_t x = 0; x < stored_size.x; /* later */) {
+					if (at == end) overrun();
+					uint8_t code = *(at++);
 					if (code > 128) {
-						//run, mask upper bit to get length:
 						code &= 0x7F;
-						if (x + code > size.x) {
-							throw std::runtime_error("hdr file '" + filename + "' has scanline over-run.");
-						}
-						//get run value:
-						uint8_t val = get_byte();
-						while (code) {
-							data[y*size.x+x][c] = val;
-							++x;
-							--code;
-						}
+						at += 1; //run value
 					} else {
-						//non-run:
-						if (x + code > size.x) {
-							throw std::runtime_error("hdr file '" + filename + "' has scanline over-run.");
-						}
-						while (code) {
-							data[y*size.x+x][c] = get_byte();
-							++x;
-							--code;
-						}
+						at += code; //literal values
 					}
+					if (at > end) overrun();
+					x += code;
 				}
 			}
 		} else {
-			//the reference code does this clever rshift thing; I'm going to more-or-less do the same thing, while at the same time being concerned that the code will pretty much never be touched.
+			//"old" format [whole pixels, with optional repeat codes]:
 			uint32_t rshift = 0;
-			for (uint32_t x = 0; x < size.x; /* later */) {
-				if (x != 0) pix = get_pix();
-				if (pix.r == 1 && pix.r == 1 && pix.g == 1) {
-					if (x == 0) {
-						throw std::runtime_error("hdr file '" + filename + "' specifies repeat at the start of a scanline");
-					}
-					for (uint32_t c = uint32_t(pix.a) << rshift; c > 0; --c) {
-						data[y*size.x+x] = data[y*size.x+x-1];
-						++x;
-						if (x >= size.x) {
-							throw std::runtime_error("hdr file '" + filename + "' specifies repeat that overflows a scanline");
-						}
-					}
+			for (uint32_t x = 0; x < stored_size.x; /* later */) {
+				if (end - at < 4) overrun();
+				if (at[0] == 1 && at[1] == 1 && at[2] == 1) {
+					if (rshift >= 24) too_many_repeats();
+					x += uint32_t(at[3]) << rshift;
 					rshift += 8;
 				} else {
-					data[y*size.x+x] = pix;
-					++x;
+					x += 1;
 					rshift = 0;
 				}
+				at += 4;
 			}
 		}
 	}
+	scanlines.emplace_back(at);
+	if (low_memory) file.release(released, at);
+}
+
+void HDRFile::decode_scanline(uint32_t y, glm::u8vec4 *out, int64_t step_x) const {
+	uint8_t const *in = scanlines[y];
+	uint8_t const *in_end = scanlines[y+1];
 
-	if (flip_y) {
-		std::vector< glm::u8vec4 > new_data;
-		new_data.resize(size.x*size.y);
-		for (uint32_t y = 0; y < size.y; ++y) {
-			uint32_t ny = size.y-1-y;
-			for (uint32_t x = 0; x < size.x; ++x) {
-				new_data[ny*size.x+x] = data[y*size.x+x];
+	if (in[0] == 2 && in[1] == 2 && (in[2] & 128) == 0) {
+		uint32_t len = (uint32_t(in[2]) << 8) | uint32_t(in[3]);
+		if (len != stored_size.x) {
+			throw std::runtime_error("hdr file '" + filename + "' has scanline that should be new RLE but reports an incorrect length (" + std::to_string(len) + " instead of " + std::to_string(stored_size.x) + ").");
+		}
+		in += 4;
+		for (uint32_t c = 0; c < 4; ++c) {
+			for (uint32_t x = 0; x < stored_size.x; /* later */) {
+				uint8_t code = *(in++);
+				if (code > 128) {
+					//run, mask upper bit to get length:
+					code &= 0x7F;
+					if (x + code > stored_size.x) {
+						throw std::runtime_error("hdr file '" + filename + "' has scanline over-run.");
+					}
+					uint8_t val = *(in++);
+					for (; code; --code, ++x) {
+						out[x * step_x][c] = val;
+					}
+				} else {
+					//non-run:
+					if (x + code > stored_size.x) {
+						throw std::runtime_error("hdr file '" + filename + "' has scanline over-run.");
+					}
+					for (; code; --code, ++x) {
+						out[x * step_x][c] = *(in++);
+					}
+				}
 			}
 		}
-		data = std::move(new_data);
-	}
-	if (flip_x) {
-		std::vector< glm::u8vec4 > new_data;
-		new_data.resize(size.x*size.y);
-		for (uint32_t y = 0; y < size.y; ++y) {
-			for (uint32_t x = 0; x < size.x; ++x) {
-				uint32_t nx = size.x-1-x;
-				new_data[y*size.x+nx] = data[y*size.x+x];
+	} else {
+		//the reference code does this clever rshift thing; I'm going to more-or-less do the same thing, while at the same time being concerned that the code will pretty much never be touched.
+		uint32_t rshift = 0;
+		for (uint32_t x = 0; x < stored_size.x && in < in_end; in += 4) {
+			if (in[0] == 1 && in[1] == 1 && in[2] == 1) {
+				if (x == 0) {
+					throw std::runtime_error("hdr file '" + filename + "' specifies repeat at the start of a scanline");
+				}
+				if (rshift >= 24) {
+					//(a fourth repeat in a row would shift by 32 or more)
+					throw std::runtime_error("hdr file '" + filename + "' specifies too many consecutive repeats in a scanline");
+				}
+				uint32_t count = uint32_t(in[3]) << rshift;
+				if (x + count > stored_size.x) {
+					throw std::runtime_error("hdr file '" + filename + "' specifies repeat that overflows a scanline");
+				}
+				glm::u8vec4 prev = out[(x - 1) * step_x];
+				for (; count; --count, ++x) {
+					out[x * step_x] = prev;
+				}
+				rshift += 8;
+			} else {
+				out[x * step_x] = glm::u8vec4(in[0], in[1], in[2], in[3]);
+				++x;
+				rshift = 0;
 			}
 		}
-		data = std::move(new_data);
 	}
+}
+
+void HDRFile::read_rows(uint32_t y0, uint32_t y1, glm::u8vec4 *out, ThreadPool *pool) const {
+	assert(y0 <= y1 && y1 <= size.y);
 	if (transpose) {
-		glm::uvec2 new_size(size.y, size.x);
-		std::vector< glm::u8vec4 > new_data;
-		new_data.resize(new_size.y*new_size.x);
-		for (uint32_t y = 0; y < size.y; ++y) {
-			for (uint32_t x = 0; x < size.x; ++x) {
-				uint32_t nx = y;
-				uint32_t ny = x;
-				new_data[ny*new_size.x+nx] = data[y*size.x+x];
-			}
+		throw std::runtime_error("hdr file '" + filename + "' stores columns, so can't be read in rows.");
+	}
+	constexpr uint32_t LinesPerJob = 16;
+	uint32_t jobs = (y1 - y0 + LinesPerJob - 1) / LinesPerJob;
+	auto decode_lines = [&](uint32_t job) {
+		uint32_t end = std::min(y1, y0 + (job + 1) * LinesPerJob);
+		for (uint32_t y = y0 + job * LinesPerJob; y < end; ++y) {
+			glm::u8vec4 *row = out + size_t(y - y0) * size.x;
+			decode_scanline(flip_y ? size.y - 1 - y : y, row + (flip_x ? size.x - 1 : 0), flip_x ? -1 : 1);
+		}
+	};
+	if (pool) {
+		pool->parallel_for(jobs, decode_lines);
+	} else {
+		for (uint32_t job = 0; job < jobs; ++job) decode_lines(job);
+	}
+}
+
+void HDRFile::release_rows(uint32_t y0, uint32_t y1) {
+	assert(y0 <= y1 && y1 <= size.y);
+	if (transpose || y0 == y1) return;
+	uint32_t first = (flip_y ? size.y - y1 : y0);
+	uint32_t last = (flip_y ? size.y - y0 : y1);
+	file.release(scanlines[first], scanlines[last]);
+}
+
+void load_hdr(std::string const &filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data_, ThreadPool *pool) {
+	assert(size);
+	assert(data_);
+	auto &data = *data_;
+
+	HDRFile file(filename);
+	*size = file.size;
+	data.resize(file.size.x * file.size.y);
+	if (!file.transpose) {
+		file.read_rows(0, file.size.y, data.data(), pool);
+		return;
+	}
+
+	//A stored pixel (x,y) lands at out[y * step_y + x * step_x + offset] in the final image:
+	glm::uvec2 const &stored = file.stored_size;
+	int64_t step_x = (file.flip_x ? -1 : 1) * int64_t(stored.y);
+	int64_t step_y = (file.flip_y ? -1 : 1);
+	int64_t offset = 0;
+	if (step_x < 0) offset -= step_x * (int64_t(stored.x) - 1);
+	if (step_y < 0) offset -= step_y * (int64_t(stored.y) - 1);
+
+	constexpr uint32_t LinesPerJob = 16;
+	uint32_t jobs = (stored.y + LinesPerJob - 1) / LinesPerJob;
+	auto decode_lines = [&](uint32_t job) {
+		uint32_t y1 = std::min(stored.y, (job + 1) * LinesPerJob);
+		for (uint32_t y = job * LinesPerJob; y < y1; ++y) {
+			file.decode_scanline(y, data.data() + offset + y * step_y, step_x);
 		}
-		size = new_size;
-		data = std::move(new_data);
+	};
+	if (pool) {
+		pool->parallel_for(jobs, decode_lines);
+	} else {
+		for (uint32_t job = 0; job < jobs; ++job) decode_lines(job);
 	}
 }
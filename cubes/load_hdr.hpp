@@ -1,8 +1,13 @@
 #pragma once
 
+#include "MappedFile.hpp"
+
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
+#include <stdint.h>
+
+struct ThreadPool;
 
 //load an .hdr / .pic image into a [rgbe] buffer.
 //origin will be placed at the lower left (opengl-style)
@@ -10,4 +15,34 @@
 
 //(will throw on error)
 
-void load_hdr(std::string const &file, glm::uvec2 *size, std::vector< glm::u8vec4 > *data);
+//if 'pool' is given, scanlines are decoded in parallel on it:
+void load_hdr(std::string const &file, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, ThreadPool *pool = nullptr);
+
+//an .hdr file, mapped and indexed so that bands of rows can be decoded on their own
+// (for images too large to hold whole; see hdr_to_cube --max-memory):
+struct HDRFile {
+	//reads header and finds every scanline (will throw on error);
+	// with 'low_memory', pages of the mapping are released once walked, so the index pass doesn't leave the file resident
+	HDRFile(std::string const &filename, bool low_memory = false);
+
+	glm::uvec2 size = glm::uvec2(0); //image size (after any flip / transpose)
+
+	//decode rows [y0,y1) (lower-left origin) into out[(y - y0) * size.x + x]:
+	// (files stored as columns, which are rare, can only be loaded whole with load_hdr; will throw)
+	void read_rows(uint32_t y0, uint32_t y1, glm::u8vec4 *out, ThreadPool *pool = nullptr) const;
+
+	//hand back the mapped pages holding rows [y0,y1) (they stay readable, but are paged in again if touched):
+	void release_rows(uint32_t y0, uint32_t y1);
+
+	//internals:
+	MappedFile file;
+	std::string filename;
+	glm::uvec2 stored_size = glm::uvec2(0); //(scanline length, scanline count) as stored in the file
+	//how the stored picture is flipped to arrive at a lower-left-origin coordinate system:
+	bool flip_x = false;
+	bool flip_y = false;
+	bool transpose = false;
+	std::vector< uint8_t const * > scanlines; //start of each stored scanline, and the end of the last
+	//decode stored scanline 'y' to out[x * step_x]:
+	void decode_scanline(uint32_t y, glm::u8vec4 *out, int64_t step_x) const;
+};
@@ -0,0 +1,153 @@
+#include "cube_lookup.hpp"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+//Microbenchmark for cube_lookup.hpp:
+// checks every path against the one-direction-at-a-time functions in cube_faces.hpp (bit-for-bit),
+// then reports lookups/sec for each path the CPU supports.
+
+int main(int argc, char **argv) {
+	uint32_t count = 1 << 20;
+	uint32_t size = 512;
+	uint32_t rounds = 10;
+	if (argc >= 2) count = std::atoi(argv[1]);
+	if (argc >= 3) size = std::atoi(argv[2]);
+	if (argc >= 4) rounds = std::atoi(argv[3]);
+	if (argc > 4 || count < 1 || size < 1 || rounds < 1) {
+		std::cerr << "Usage:\n\t./lookup_bench [directions] [cube size] [rounds]\n(lookups read a size x size cube; 512 is larger than cache, 32 fits)" << std::endl;
+		return 1;
+	}
+
+	std::mt19937 mt(0x12341234);
+
+	//test directions: mostly uniform on the sphere, with some on face edges, corners, and axes (including -0.0):
+	std::vector< float > x(count), y(count), z(count);
+	{
+		std::normal_distribution< float > normal;
+		float specials[] = {0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f};
+		for (uint32_t i = 0; i < count; ++i) {
+			glm::vec3 dir(normal(mt), normal(mt), normal(mt));
+			if (mt() % 16 == 0) {
+				dir[mt() % 3] = dir[mt() % 3]; //tie between two axes
+				if (mt() % 2) dir[mt() % 3] *= -1.0f;
+			}
+			if (mt() % 32 == 0) dir[mt() % 3] = specials[mt() % (sizeof(specials) / sizeof(specials[0]))];
+			if (dir == glm::vec3(0.0f)) dir.x = 1.0f;
+			x[i] = dir.x;
+			y[i] = dir.y;
+			z[i] = dir.z;
+		}
+	}
+
+	//a cube with a distinct value per texel, so a wrong index shows up as a mismatch:
+	std::vector< glm::vec3 > cube(6 * size * size);
+	for (uint32_t i = 0; i < cube.size(); ++i) {
+		cube[i] = glm::vec3(float(i), float(i % 7), float(i % 13));
+	}
+
+	//face points, in texels, for texel_directions_n:
+	std::vector< float > ps(count), pt(count);
+	{
+		std::uniform_real_distribution< float > unit(0.0f, float(size));
+		for (uint32_t i = 0; i < count; ++i) {
+			ps[i] = unit(mt);
+			pt[i] = unit(mt);
+		}
+	}
+	TexelDirections directions(LayoutCube, size);
+
+	//reference results:
+	std::vector< uint32_t > ref_face(count);
+	std::vector< float > ref_s(count), ref_t(count);
+	std::vector< glm::vec3 > ref_nearest(count);
+	std::vector< glm::vec3 > ref_dirs(count);
+
+	auto time = [&](std::function< void() > const &fn) -> double {
+		fn(); //warm up
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t r = 0; r < rounds; ++r) fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration< double >(after - before).count();
+		return double(count) * rounds / seconds;
+	};
+
+	std::cout << "Looking up " << count << " directions in a " << size << " cube, " << rounds << " rounds." << std::endl;
+
+	{
+		double lps = time([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::vec2 st;
+				ref_face[i] = direction_to_face(glm::vec3(x[i], y[i], z[i]), &st);
+				ref_s[i] = st.x;
+				ref_t[i] = st.y;
+			}
+		});
+		std::cout << "  direction_to_face (per direction): " << lps / 1e6 << " Mlookups/sec" << std::endl;
+		lps = time([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::vec2 st;
+				uint32_t f = direction_to_face(glm::vec3(x[i], y[i], z[i]), &st);
+				ref_nearest[i] = cube[cube_texel_index(size, f, st)];
+			}
+		});
+		std::cout << "  nearest texel (per direction): " << lps / 1e6 << " Mlookups/sec" << std::endl;
+		lps = time([&](){
+			for (uint32_t i = 0; i < count; ++i) ref_dirs[i] = directions(i % 6, ps[i], pt[i]);
+		});
+		std::cout << "  TexelDirections (per point): " << lps / 1e6 << " Mpoints/sec" << std::endl;
+	}
+
+	bool ok = true;
+	for (LookupPath path : {LookupPathScalar, LookupPathAVX2}) {
+		if (!lookup_path_supported(path)) {
+			std::cout << "  " << lookup_path_name(path) << ": not supported on this CPU/build." << std::endl;
+			continue;
+		}
+
+		std::vector< uint32_t > face(count);
+		std::vector< float > s(count), t(count);
+		std::vector< glm::vec3 > nearest(count);
+		std::vector< float > dx(count), dy(count), dz(count);
+
+		double faces = time([&](){ direction_to_face_n(x.data(), y.data(), z.data(), count, face.data(), s.data(), t.data(), path); });
+		double lookups = time([&](){ cube_nearest_n(cube.data(), size, x.data(), y.data(), z.data(), count, nearest.data(), path); });
+		//(one face per batch of 1024 points, as the tools call it per texel or per row)
+		double points = time([&](){
+			for (uint32_t i = 0; i < count; i += 1024) {
+				uint32_t n = std::min(1024U, count - i);
+				texel_directions_n(directions, (i / 1024) % 6, ps.data() + i, pt.data() + i, n, dx.data() + i, dy.data() + i, dz.data() + i, path);
+			}
+		});
+
+		uint32_t face_mismatch = 0;
+		uint32_t nearest_mismatch = 0;
+		uint32_t direction_mismatch = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (face[i] != ref_face[i] || std::memcmp(&s[i], &ref_s[i], 4) != 0 || std::memcmp(&t[i], &ref_t[i], 4) != 0) ++face_mismatch;
+			if (std::memcmp(&nearest[i], &ref_nearest[i], sizeof(glm::vec3)) != 0) ++nearest_mismatch;
+			glm::vec3 ref = directions((i / 1024) % 6, ps[i], pt[i]);
+			glm::vec3 dir(dx[i], dy[i], dz[i]);
+			if (std::memcmp(&dir, &ref, sizeof(glm::vec3)) != 0) ++direction_mismatch;
+		}
+		if (face_mismatch || nearest_mismatch || direction_mismatch) ok = false;
+
+		auto mismatches = [](uint32_t n) {
+			return (n ? " MISMATCHES: " + std::to_string(n) : std::string(""));
+		};
+		std::cout << "  direction_to_face_n (" << lookup_path_name(path) << "): " << faces / 1e6 << " Mlookups/sec" << mismatches(face_mismatch) << std::endl;
+		std::cout << "  cube_nearest_n (" << lookup_path_name(path) << "): " << lookups / 1e6 << " Mlookups/sec" << mismatches(nearest_mismatch) << std::endl;
+		std::cout << "  texel_directions_n (" << lookup_path_name(path) << "): " << points / 1e6 << " Mpoints/sec" << mismatches(direction_mismatch) << std::endl;
+	}
+
+	if (!ok) {
+		std::cerr << "Batched lookups do not match cube_faces.hpp!" << std::endl;
+		return 1;
+	}
+	std::cout << "All paths match cube_faces.hpp bit-for-bit." << std::endl;
+	return 0;
+}
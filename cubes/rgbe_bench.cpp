@@ -0,0 +1,119 @@
+#include "rgbe.hpp"
+#include "rgbe_n.hpp"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <functional>
+
+//Microbenchmark for rgbe_n.hpp:
+// checks every path against the per-pixel functions in rgbe.hpp (bit-for-bit),
+// then reports pixels/sec for each path the CPU supports.
+
+int main(int argc, char **argv) {
+	uint32_t count = 1 << 22;
+	uint32_t rounds = 10;
+	if (argc >= 2) count = std::atoi(argv[1]);
+	if (argc >= 3) rounds = std::atoi(argv[2]);
+	if (argc > 3 || count < 1 || rounds < 1) {
+		std::cerr << "Usage:\n\t./rgbe_bench [pixels] [rounds]" << std::endl;
+		return 1;
+	}
+
+	std::mt19937 mt(0x12341234);
+
+	//test data: all sorts of rgbe values, including zero and near-denormal exponents:
+	std::vector< glm::u8vec4 > rgbe(count);
+	for (auto &px : rgbe) {
+		uint32_t bits = mt();
+		px = glm::u8vec4(bits & 0xff, (bits >> 8) & 0xff, (bits >> 16) & 0xff, bits >> 24);
+		if (mt() % 16 == 0) px = glm::u8vec4(0,0,0,0);
+	}
+
+	//...and floats: mostly plausible radiance values, with some negative, tiny, huge, and non-finite ones:
+	std::vector< glm::vec3 > floats(count);
+	{
+		std::uniform_real_distribution< float > exponent(-40.0f, 40.0f);
+		std::uniform_real_distribution< float > unit(-0.1f, 1.0f);
+		float specials[] = {
+			0.0f, -0.0f, 1e-32f, 1e-38f, 1e38f, 3.4e38f,
+			std::numeric_limits< float >::infinity(),
+			-std::numeric_limits< float >::infinity(),
+			std::numeric_limits< float >::quiet_NaN(),
+		};
+		for (auto &px : floats) {
+			float scale = std::exp2(exponent(mt));
+			px = glm::vec3(unit(mt) * scale, unit(mt) * scale, unit(mt) * scale);
+			if (mt() % 64 == 0) px[mt() % 3] = specials[mt() % (sizeof(specials) / sizeof(specials[0]))];
+		}
+	}
+
+	//reference results:
+	std::vector< glm::vec3 > ref_floats;
+	ref_floats.reserve(count);
+	for (auto const &px : rgbe) ref_floats.emplace_back(rgbe_to_float(px));
+	std::vector< glm::u8vec4 > ref_rgbe;
+	ref_rgbe.reserve(count);
+	for (auto const &px : floats) ref_rgbe.emplace_back(float_to_rgbe(px));
+
+	auto time = [&](std::function< void() > const &fn) -> double {
+		fn(); //warm up
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t r = 0; r < rounds; ++r) fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration< double >(after - before).count();
+		return double(count) * rounds / seconds;
+	};
+
+	std::cout << "Converting " << count << " pixels, " << rounds << " rounds." << std::endl;
+
+	{
+		double pps = time([&](){
+			for (uint32_t i = 0; i < count; ++i) ref_floats[i] = rgbe_to_float(rgbe[i]);
+		});
+		std::cout << "  rgbe_to_float (per pixel): " << pps / 1e6 << " Mpix/sec" << std::endl;
+		pps = time([&](){
+			for (uint32_t i = 0; i < count; ++i) ref_rgbe[i] = float_to_rgbe(floats[i]);
+		});
+		std::cout << "  float_to_rgbe (per pixel): " << pps / 1e6 << " Mpix/sec" << std::endl;
+	}
+
+	bool ok = true;
+	for (RGBEPath path : {RGBEPathScalar, RGBEPathSSE2, RGBEPathAVX2}) {
+		if (!rgbe_path_supported(path)) {
+			std::cout << "  " << rgbe_path_name(path) << ": not supported on this CPU/build." << std::endl;
+			continue;
+		}
+
+		std::vector< glm::vec3 > out_floats(count);
+		std::vector< glm::u8vec4 > out_rgbe(count);
+
+		double decode = time([&](){ rgbe_to_float_n(rgbe.data(), count, out_floats.data(), path); });
+		double encode = time([&](){ float_to_rgbe_n(floats.data(), count, out_rgbe.data(), path); });
+
+		uint32_t decode_mismatch = 0;
+		uint32_t encode_mismatch = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (std::memcmp(&out_floats[i], &ref_floats[i], sizeof(glm::vec3)) != 0) ++decode_mismatch;
+			if (out_rgbe[i] != ref_rgbe[i]) ++encode_mismatch;
+		}
+		if (decode_mismatch || encode_mismatch) ok = false;
+
+		std::cout << "  rgbe_to_float_n (" << rgbe_path_name(path) << "): " << decode / 1e6 << " Mpix/sec"
+		          << (decode_mismatch ? " MISMATCHES: " + std::to_string(decode_mismatch) : std::string(""))
+		          << std::endl;
+		std::cout << "  float_to_rgbe_n (" << rgbe_path_name(path) << "): " << encode / 1e6 << " Mpix/sec"
+		          << (encode_mismatch ? " MISMATCHES: " + std::to_string(encode_mismatch) : std::string(""))
+		          << std::endl;
+	}
+
+	if (!ok) {
+		std::cerr << "Batch conversion does not match rgbe.hpp!" << std::endl;
+		return 1;
+	}
+	std::cout << "All paths match rgbe.hpp bit-for-bit." << std::endl;
+	return 0;
+}
@@ -96,7 +96,11 @@ void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 co
 			glUniform4fv(text_program_color_vec4, 1, glm::value_ptr(color));
 
 			MeshBuffer::Mesh const &mesh = text_meshes->lookup(text.substr(i,1));
-			glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
+			if (mesh.index_type == GL_NONE) {
+				glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
+			} else {
+				glDrawElements(GL_TRIANGLES, mesh.count, mesh.index_type, MeshBuffer::index_offset(mesh.index_type, mesh.start));
+			}
 		}
 
 		x += char_width(text[i]);
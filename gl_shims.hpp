@@ -134,6 +134,7 @@ DO(ISBUFFER, IsBuffer)
 DO(BUFFERDATA, BufferData)
 DO(BUFFERSUBDATA, BufferSubData)
 DO(GETBUFFERSUBDATA, GetBufferSubData)
+DO(MAPBUFFER, MapBuffer)
 DO(UNMAPBUFFER, UnmapBuffer)
 DO(GETBUFFERPARAMETERIV, GetBufferParameteriv)
 DO(GETBUFFERPOINTERV, GetBufferPointerv)
@@ -299,6 +300,7 @@ DO(CLEARBUFFERIV, ClearBufferiv)
 DO(CLEARBUFFERUIV, ClearBufferuiv)
 DO(CLEARBUFFERFV, ClearBufferfv)
 DO(CLEARBUFFERFI, ClearBufferfi)
+DO(GETSTRINGI, GetStringi)
 DO(ISRENDERBUFFER, IsRenderbuffer)
 DO(BINDRENDERBUFFER, BindRenderbuffer)
 DO(DELETERENDERBUFFERS, DeleteRenderbuffers)
@@ -319,6 +321,7 @@ DO(GENERATEMIPMAP, GenerateMipmap)
 DO(BLITFRAMEBUFFER, BlitFramebuffer)
 DO(RENDERBUFFERSTORAGEMULTISAMPLE, RenderbufferStorageMultisample)
 DO(FRAMEBUFFERTEXTURELAYER, FramebufferTextureLayer)
+DO(MAPBUFFERRANGE, MapBufferRange)
 DO(FLUSHMAPPEDBUFFERRANGE, FlushMappedBufferRange)
 DO(BINDVERTEXARRAY, BindVertexArray)
 DO(DELETEVERTEXARRAYS, DeleteVertexArrays)
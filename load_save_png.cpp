@@ -13,6 +13,7 @@ using std::vector;
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
+static void save_png(std::ostream &to, unsigned int width, unsigned int height, int bit_depth, int color_type, size_t pixel_bytes, void const *data, OriginLocation origin);
 
 
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
@@ -32,6 +33,11 @@ void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, Or
 	save_png(file, size.x, size.y, data, origin);
 }
 
+void save_png(std::string filename, glm::uvec2 size, glm::u16vec2 const *data, OriginLocation origin) {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	save_png(file, size.x, size.y, 16, PNG_COLOR_TYPE_GRAY_ALPHA, sizeof(glm::u16vec2), data, origin);
+}
+
 
 static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
 	std::istream *from = reinterpret_cast< std::istream * >(png_get_io_ptr(png_ptr));
@@ -130,7 +136,12 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 
 
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin) {
+	save_png(to, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, sizeof(glm::u8vec4), data, origin);
+}
+
+static void save_png(std::ostream &to, unsigned int width, unsigned int height, int bit_depth, int color_type, size_t pixel_bytes, void const *data_, OriginLocation origin) {
 //After the libpng example.c
+	png_bytep data = (png_bytep)data_;
 	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
 	png_set_write_fn(png_ptr, &to, user_write_data, user_flush_data);
@@ -154,16 +165,21 @@ void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8
 	}
 
 	//Not needed with custom read/write functions: png_init_io(png_ptr, fp);
-	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
 	png_write_info(png_ptr, info_ptr);
+	if (bit_depth == 16) {
+		//png stores 16-bit samples big-endian:
+		uint16_t test = 1;
+		if (*reinterpret_cast< uint8_t * >(&test) == 1) png_set_swap(png_ptr);
+	}
 	//png_set_swap_alpha(png_ptr) // might need?
 	vector< png_bytep > row_pointers(height);
 	for (unsigned int i = 0; i < height; ++i) {
 		if (origin == UpperLeftOrigin) {
-			row_pointers[i] = (png_bytep)&(data[i * width]);
+			row_pointers[i] = data + size_t(i) * width * pixel_bytes;
 		} else {
-			row_pointers[i] = (png_bytep)&(data[(height - 1 - i) * width]);
+			row_pointers[i] = data + size_t(height - 1 - i) * width * pixel_bytes;
 		}
 	}
 	png_write_image(png_ptr, &(row_pointers[0]));
@@ -18,3 +18,5 @@ enum OriginLocation {
 //NOTE: load_png will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
+//16-bit, two channel (gray + alpha) images, e.g. for lookup tables:
+void save_png(std::string filename, glm::uvec2 size, glm::u16vec2 const *data, OriginLocation origin);
@@ -0,0 +1,43 @@
+#!/bin/sh
+
+#Exports a .blend file's meshes and turns them into the dist/ file the game loads, as one step:
+# meshes are exported to raw/ (export-meshes.py), cooked for the vertex cache into cooked/ (cook-meshes.py), and quantized (quantize-vertices.py);
+# bone animations are exported to raw/ (export-bone-animations.py) and their mesh quantized.
+#Running the chain as one command means a dist/ file depends only on committed files, so its bake.manifest line
+# still matches on a fresh checkout, where raw/ and cooked/ don't exist.
+#
+#./bake-meshes.sh [--compress] <infile.blend> <outfile.pnc|outfile.pnct>
+#./bake-meshes.sh [--compress] <infile.blend> <outfile.banims> <object> <actions>
+#(blender is run as $BLENDER, default 'blender'; '--compress' applies to the final file)
+
+set -e
+
+COMPRESS=
+if [ "$1" = "--compress" ]; then
+	COMPRESS=--compress
+	shift
+fi
+BLENDER=${BLENDER:-blender}
+
+IN="$1"
+OUT="$2"
+NAME=`basename "$OUT"`
+
+mkdir -p raw cooked
+case "$OUT" in
+	*.pnc|*.pnct)
+		"$BLENDER" --background --python export-meshes.py -- "$IN" "raw/$NAME"
+		python3 cook-meshes.py "raw/$NAME" "cooked/$NAME"
+		python3 quantize-vertices.py $COMPRESS "cooked/$NAME" "$OUT"
+		;;
+	*.banims)
+		"$BLENDER" --background --python export-bone-animations.py -- "$IN" "$3" "$4" "raw/$NAME"
+		python3 quantize-vertices.py $COMPRESS "raw/$NAME" "$OUT"
+		;;
+	*)
+		echo "Usage:" >&2
+		echo "	./bake-meshes.sh [--compress] <infile.blend> <outfile.pnc|outfile.pnct>" >&2
+		echo "	./bake-meshes.sh [--compress] <infile.blend> <outfile.banims> <object> <actions>" >&2
+		exit 1
+		;;
+esac
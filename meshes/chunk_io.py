@@ -0,0 +1,63 @@
+#Reading and writing chunk files (the format read by ../read_chunk.hpp), shared by the scripts in this directory.
+#
+#Scripts import this from their own directory, which also works when they are run with 'blender --python':
+#  sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+#  import chunk_io
+
+import struct
+import zlib
+
+#read all chunks of a file as a list of (magic, data), decompressing compressed chunks and skipping the table of contents:
+def read_chunks(filename):
+	blob = open(filename, 'rb').read()
+	chunks = []
+	at = 0
+	while at < len(blob):
+		(magic, size) = struct.unpack('4sI', blob[at:at+8])
+		data = blob[at+8:at+8+size]
+		at += 8 + size
+		if magic[3] & 0x80: #compressed chunk
+			magic = magic[0:3] + bytes([magic[3] & 0x7f])
+			data = zlib.decompress(data[4:])
+		if magic == b'toc0': continue
+		chunks.append((magic, data))
+	return chunks
+
+def write_chunk(blob, magic, data):
+	blob.write(struct.pack('4s',magic)) #type
+	blob.write(struct.pack('I', len(data))) #length
+	blob.write(data)
+
+#table of contents chunk (see MappedChunks in ../read_chunk.hpp), listing the magic, header offset, and size of each chunk after it:
+def write_toc(blob, chunks):
+	offset = 8 + 12 * len(chunks)
+	toc = b''
+	for (magic, data) in chunks:
+		toc += struct.pack('4sII', magic, offset, len(data))
+		offset += 8 + len(data)
+	write_chunk(blob, b'toc0', toc)
+
+#with compress, chunks are stored as their uncompressed size followed by a zlib stream, and marked by setting the high bit of their magic's last byte:
+def pack_chunk(magic, data, compress):
+	if compress:
+		packed = struct.pack('I', len(data)) + zlib.compress(data, 9)
+		if len(packed) < len(data):
+			return (magic[0:3] + bytes([magic[3] | 0x80]), packed)
+	return (magic, data)
+
+#chunk data is padded with zeros to a multiple of four bytes, so every chunk starts four-byte aligned and
+# MappedChunks can hand out spans straight into the mapped file (rather than copying chunks that follow an odd-length 'str0'):
+# (readers don't mind the padding -- names use begin/end offsets into 'str0', and zlib ignores bytes after its stream)
+def pad_chunk(magic, data):
+	return (magic, data + b'\0' * (-len(data) % 4))
+
+#write a table of contents and then 'chunks' (a list of (magic, data)) to a file; returns the number of bytes written:
+def write_chunks(filename, chunks, compress=False):
+	chunks = [pad_chunk(*pack_chunk(magic, data, compress)) for (magic, data) in chunks]
+	blob = open(filename, 'wb')
+	write_toc(blob, chunks)
+	for (magic, data) in chunks:
+		write_chunk(blob, magic, data)
+	wrote = blob.tell()
+	blob.close()
+	return wrote
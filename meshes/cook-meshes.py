@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+
+#Cooks a mesh file written by export-meshes.py (a triangle soup, drawn with glDrawArrays) into an indexed one (drawn with glDrawElements):
+# - identical vertices within each mesh are welded, so each is stored (and run through the vertex shader) once;
+# - each mesh's triangles are reordered for the post-transform vertex cache ("Tipsify", from
+#   Sander, Nehab, and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007);
+# - each mesh's vertices are then reordered by first use, for locality of vertex fetches.
+#
+#Runs with plain python 3 (no blender):
+#python3 cook-meshes.py [--compress] <infile.p[n][c][t]> <outfile.p[n][c][t]>
+#
+#The output has the same vertex chunk and 'str0' chunk as the input, but the 'idx0' chunk is replaced by:
+# idx1 len < uint uint uint uint uint uint > * [name begin/end, vertex begin/end, index begin/end per mesh]
+# tri0 len < uint > * [vertex indices (into the whole vertex chunk), three per triangle]
+#(MeshBuffer.cpp reads both flavors.)
+
+import sys
+import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
+
+args = sys.argv[1:]
+
+#'--compress' stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
+if len(args) != 2:
+	print("\n\nUsage:\npython3 cook-meshes.py [--compress] <infile.p[n][c][t]> <outfile.p[n][c][t]>\nWelds, indexes, and reorders the meshes in a mesh file for the vertex cache, and reports the vertex shader work saved per mesh.\n")
+	exit(1)
+
+infile = args[0]
+outfile = args[1]
+
+#post-transform cache size to optimize for (and to estimate vertex shader runs with);
+# real caches vary by GPU, but orderings made for a small cache hold up well on bigger ones:
+CACHE_SIZE = 16
+
+vertex_magics = {
+	".p" : (b"p...", 3*4),
+	".pn" : (b"pn..", 3*4+3*4),
+	".pnc" : (b"pnc.", 3*4+3*4+4),
+	".pnct" : (b"pnct", 3*4+3*4+4+2*4),
+}
+
+vertex_magic = None
+for (ext, magic_bytes) in vertex_magics.items():
+	if infile.endswith(ext) and outfile.endswith(ext):
+		vertex_magic, vertex_bytes = magic_bytes
+if vertex_magic == None:
+	print("ERROR: input and output should both be named with one of:")
+	for k in vertex_magics.keys():
+		print("\t\"" + k + "\"")
+	exit(1)
+
+#------------ read ------------
+
+chunks = dict(chunk_io.read_chunks(infile))
+
+if b'tri0' in chunks:
+	print("ERROR: '" + infile + "' is already indexed.")
+	exit(1)
+for magic in [vertex_magic, b'str0', b'idx0']:
+	if not magic in chunks:
+		print("ERROR: '" + infile + "' has no '" + magic.decode() + "' chunk.")
+		exit(1)
+
+vertex_data = chunks[vertex_magic]
+strings = chunks[b'str0']
+index = list(struct.iter_unpack('IIII', chunks[b'idx0']))
+
+#------------ cook ------------
+
+#vertex shader runs to draw 'indices' through a FIFO post-transform cache of CACHE_SIZE entries:
+def cache_misses(indices):
+	cache = []
+	misses = 0
+	for i in indices:
+		if not i in cache:
+			misses += 1
+			cache.append(i)
+			if len(cache) > CACHE_SIZE: cache.pop(0)
+	return misses
+
+#reorder 'triangles' (tuples of indices < vertex_count) for a cache of CACHE_SIZE entries:
+# (fans around one vertex at a time, picking the next vertex to fan around from those probably still in the cache)
+def tipsify(triangles, vertex_count):
+	if vertex_count == 0: return [] #(empty mesh; there is no vertex to start fanning around)
+	adjacency = [[] for v in range(0, vertex_count)]
+	for (t, tri) in enumerate(triangles):
+		for v in tri:
+			adjacency[v].append(t)
+	live = [len(a) for a in adjacency] #triangles not yet emitted, per vertex
+	cache_time = [0] * vertex_count #when each vertex last entered the cache
+	emitted = [False] * len(triangles)
+	dead_end = [] #recently used vertices, to fall back on
+	time = CACHE_SIZE + 1
+	cursor = 0 #for finding vertices with live triangles when all else fails
+	order = []
+
+	fan = 0
+	while fan >= 0:
+		candidates = []
+		for t in adjacency[fan]:
+			if emitted[t]: continue
+			emitted[t] = True
+			order.append(triangles[t])
+			for v in triangles[t]:
+				dead_end.append(v)
+				candidates.append(v)
+				live[v] -= 1
+				if time - cache_time[v] > CACHE_SIZE:
+					cache_time[v] = time
+					time += 1
+
+		#next fan: the candidate that will still be in the cache after its own triangles, and entered it earliest:
+		fan = -1
+		best = -1
+		for v in candidates:
+			if live[v] <= 0: continue
+			priority = 0
+			if time - cache_time[v] + 2 * live[v] <= CACHE_SIZE:
+				priority = time - cache_time[v]
+			if priority > best:
+				best = priority
+				fan = v
+		if fan == -1:
+			while len(dead_end) > 0:
+				v = dead_end.pop()
+				if live[v] > 0:
+					fan = v
+					break
+		if fan == -1:
+			while cursor < vertex_count and live[cursor] <= 0:
+				cursor += 1
+			if cursor < vertex_count:
+				fan = cursor
+	assert len(order) == len(triangles)
+	return order
+
+out_vertices = b''
+out_indices = []
+out_index = b''
+total = { 'soup':0, 'welded':0, 'cooked':0, 'triangles':0, 'vertices':0 }
+
+print("Cooking '" + infile + "' for a " + str(CACHE_SIZE) + "-entry vertex cache:")
+for (name_begin, name_end, vertex_begin, vertex_end) in index:
+	name = strings[name_begin:name_end].decode('utf8')
+	if (vertex_end - vertex_begin) % 3 != 0:
+		print("ERROR: mesh '" + name + "' has a vertex count that isn't a multiple of three.")
+		exit(1)
+
+	#weld identical vertices:
+	welded = {}
+	vertices = []
+	indices = []
+	for i in range(vertex_begin, vertex_end):
+		vertex = vertex_data[i*vertex_bytes:(i+1)*vertex_bytes]
+		if not vertex in welded:
+			welded[vertex] = len(vertices)
+			vertices.append(vertex)
+		indices.append(welded[vertex])
+	triangles = [tuple(indices[i:i+3]) for i in range(0, len(indices), 3)]
+
+	#reorder triangles:
+	triangles = tipsify(triangles, len(vertices))
+
+	#reorder vertices by first use:
+	remap = {}
+	for tri in triangles:
+		for v in tri:
+			if not v in remap: remap[v] = len(remap)
+	first_vertex = len(out_vertices) // vertex_bytes
+	first_index = len(out_indices)
+	ordered = [None] * len(remap)
+	for (v, r) in remap.items():
+		ordered[r] = vertices[v]
+	out_vertices += b''.join(ordered)
+	for tri in triangles:
+		for v in tri:
+			out_indices.append(first_vertex + remap[v])
+
+	out_index += struct.pack('IIIIII', name_begin, name_end, first_vertex, first_vertex + len(ordered), first_index, len(out_indices))
+
+	#report vertex shader runs -- as a triangle soup (glDrawArrays reuses nothing), welded in export order, and cooked:
+	soup = vertex_end - vertex_begin
+	welded_runs = cache_misses(indices)
+	cooked_runs = cache_misses(out_indices[first_index:])
+	print("  '" + name + "': " + str(soup // 3) + " triangles, " + str(soup) + " -> " + str(len(ordered)) + " vertices; "
+		+ "vertex shader runs " + str(soup) + " -> " + str(welded_runs) + " welded -> " + str(cooked_runs) + " cooked "
+		+ "(" + ("%.2f" % (cooked_runs / max(1, soup // 3))) + " per triangle, " + ("%.1f" % (100.0 * (1.0 - cooked_runs / soup) if soup > 0 else 0.0)) + "% saved)")
+	total['soup'] += soup
+	total['welded'] += welded_runs
+	total['cooked'] += cooked_runs
+	total['triangles'] += soup // 3
+	total['vertices'] += len(ordered)
+
+print("  total: " + str(total['triangles']) + " triangles, " + str(total['soup']) + " -> " + str(total['vertices']) + " vertices; "
+	+ "vertex shader runs " + str(total['soup']) + " -> " + str(total['welded']) + " welded -> " + str(total['cooked']) + " cooked "
+	+ "(" + ("%.1f" % (100.0 * (1.0 - total['cooked'] / total['soup']) if total['soup'] > 0 else 0.0)) + "% saved)")
+
+#------------ write ------------
+
+#chunks: the (welded) vertices, the strings, the index, the triangles
+chunks = [
+	(vertex_magic, out_vertices),
+	(b'str0', strings),
+	(b'idx1', out_index),
+	(b'tri0', struct.pack(str(len(out_indices)) + 'I', *out_indices)),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes (from " + str(len(vertex_data)) + " bytes of vertices to " + str(len(out_vertices)) + " bytes of vertices + " + str(4 * len(out_indices)) + " bytes of indices) to '" + outfile + "'")
@@ -5,6 +5,11 @@
 import sys
 import bpy
 import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
 import bmesh
 import mathutils
 import re;
@@ -14,8 +19,12 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+#'--compress' (anywhere after '--') stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
 if len(args) != 4:
-	print("\n\nUsage:\nblender --background --python export-bone-animations.py -- <infile.blend> <object> <action[;action2][;...]> <outfile.character>\nExports an armature-animated mesh to a binary blob.\n<action> can also be a named frame range as per '[100,150]Walk'\n<action> can specify root transforms by appending 'Walk!local' (local to armature),'Walk!global' (world-relative),'Walk!first' (first-frame relative)")
+	print("\n\nUsage:\nblender --background --python export-bone-animations.py -- [--compress] <infile.blend> <object> <action[;action2][;...]> <outfile.character>\nExports an armature-animated mesh to a binary blob.\n<action> can also be a named frame range as per '[100,150]Walk'\n<action> can specify root transforms by appending 'Walk!local' (local to armature),'Walk!global' (world-relative),'Walk!first' (first-frame relative)")
 	exit(1)
 
 infile = args[0]
@@ -314,23 +323,20 @@ for obj in objs:
 #Write final animation file
 
 #write the strings chunk and scene chunk to an output blob:
-blob = open(outfile, 'wb')
-def write_chunk(magic, data):
-	blob.write(struct.pack('4s',magic)) #type
-	blob.write(struct.pack('I', len(data))) #length
-	blob.write(data)
-
-write_chunk(b'str0', strings_data)
-write_chunk(b'bon0', bone_data)
-write_chunk(b'frm0', frame_data)
-write_chunk(b'act0', action_data)
-write_chunk(b'msh0', vertex_data)
-
-print("Wrote " + str(blob.tell()) + " bytes [== "
+chunks = [
+	(b'str0', strings_data),
+	(b'bon0', bone_data),
+	(b'frm0', frame_data),
+	(b'act0', action_data),
+	(b'msh0', vertex_data),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes [== "
+	+ str(8 + 12 * len(chunks)) + " bytes of table of contents + "
 	+ str(len(strings_data)) + " bytes of strings + "
 	+ str(len(bone_data)) + " bytes of bone info + "
 	+ str(len(frame_data)) + " bytes of frames + "
 	+ str(len(action_data)) + " bytes of action info + "
 	+ str(len(vertex_data)) + " bytes of mesh]"
 	+ " to '" + outfile + "'")
-blob.close()
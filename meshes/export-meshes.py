@@ -12,8 +12,12 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+#'--compress' (anywhere after '--') stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend>[:layer] <outfile.p[n][c][t][l]>\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them. If 'l' is specified in the file extension, only mesh edges will be exported.\n")
+	print("\n\nUsage:\nblender --background --python export-meshes.py -- [--compress] <infile.blend>[:layer] <outfile.p[n][c][t][l]>\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them. If 'l' is specified in the file extension, only mesh edges will be exported.\n")
 	exit(1)
 
 infile = args[0]
@@ -68,6 +72,11 @@ if filetype == None:
 
 import bpy
 import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
 
 import argparse
 
@@ -194,20 +203,12 @@ for obj in bpy.data.objects:
 assert(vertex_count * filetype.vertex_bytes == len(data))
 
 #write the data chunk and index chunk to an output blob:
-blob = open(outfile, 'wb')
-#first chunk: the data
-blob.write(struct.pack('4s',filetype.magic)) #type
-blob.write(struct.pack('I', len(data))) #length
-blob.write(data)
-#second chunk: the strings
-blob.write(struct.pack('4s',b'str0')) #type
-blob.write(struct.pack('I', len(strings))) #length
-blob.write(strings)
-#third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
-blob.write(struct.pack('I', len(index))) #length
-blob.write(index)
-wrote = blob.tell()
-blob.close()
-
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+#chunks: the data, the strings, the index
+chunks = [
+	(filetype.magic, data),
+	(b'str0', strings),
+	(b'idx0', index),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes [== " + str(8 + 12 * len(chunks)) + " bytes of table of contents + " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
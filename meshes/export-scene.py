@@ -12,8 +12,12 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+#'--compress' (anywhere after '--') stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-scene.py -- <infile.blend>[:layer] <outfile.scene>\nExports the transforms of objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them.\n")
+	print("\n\nUsage:\nblender --background --python export-scene.py -- [--compress] <infile.blend>[:layer] <outfile.scene>\nExports the transforms of objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them.\n")
 	exit(1)
 
 infile = args[0]
@@ -29,6 +33,11 @@ print("Will export layer " + str(layer) + " from file '" + infile + "' to scene
 import bpy
 import mathutils
 import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
 import math
 
 #---------------------------------------------------------------------
@@ -160,17 +169,13 @@ for obj in bpy.data.objects:
 		print('Skipping ' + obj.type)
 
 #write the strings chunk and scene chunk to an output blob:
-blob = open(outfile, 'wb')
-def write_chunk(magic, data):
-	blob.write(struct.pack('4s',magic)) #type
-	blob.write(struct.pack('I', len(data))) #length
-	blob.write(data)
-
-write_chunk(b'str0', strings_data)
-write_chunk(b'xfh0', xfh_data)
-write_chunk(b'msh0', mesh_data)
-write_chunk(b'cam0', camera_data)
-write_chunk(b'lmp0', lamp_data)
-
-print("Wrote " + str(blob.tell()) + " bytes to '" + outfile + "'")
-blob.close()
+chunks = [
+	(b'str0', strings_data),
+	(b'xfh0', xfh_data),
+	(b'msh0', mesh_data),
+	(b'cam0', camera_data),
+	(b'lmp0', lamp_data),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes to '" + outfile + "'")
@@ -5,6 +5,11 @@
 import sys
 import bpy
 import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
 import bmesh
 import mathutils
 
@@ -23,8 +28,12 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+#'--compress' (anywhere after '--') stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
 if len(args) != 5:
-	print("\n\nUsage:\nblender --background --python export-animation.py -- <infile.blend> <object name,object name,...> <minFrame> <maxFrame> <outfile.manim>\nExports transforms for range [minFrame,maxFrame] animation to a binary blob. Exported transforms are relative to the parent transform but otherwise absolute.\n")
+	print("\n\nUsage:\nblender --background --python export-animation.py -- [--compress] <infile.blend> <object name,object name,...> <minFrame> <maxFrame> <outfile.manim>\nExports transforms for range [minFrame,maxFrame] animation to a binary blob. Exported transforms are relative to the parent transform but otherwise absolute.\n")
 	exit(1)
 
 infile = args[0]
@@ -77,19 +86,16 @@ print("Wrote frames [" + str(min_frame) + ", " + str(max_frame) + "]")
 #Write data to file
 
 #write the strings chunk and scene chunk to an output blob:
-blob = open(outfile, 'wb')
-def write_chunk(magic, data):
-	blob.write(struct.pack('4s',magic)) #type
-	blob.write(struct.pack('I', len(data))) #length
-	blob.write(data)
-
-write_chunk(b'str0', strings_data)
-write_chunk(b'idx0', index_data)
-write_chunk(b'xff0', frames_data)
-
-print("Wrote " + str(blob.tell()) + " bytes [== "
+chunks = [
+	(b'str0', strings_data),
+	(b'idx0', index_data),
+	(b'xff0', frames_data),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes [== "
+	+ str(8 + 12 * len(chunks)) + " bytes of table of contents + "
 	+ str(len(strings_data)) + " bytes of strings + "
 	+ str(len(index_data)) + " bytes of index + "
 	+ str(len(frames_data)) + " bytes of frames]"
 	+ " to '" + outfile + "'")
-blob.close()
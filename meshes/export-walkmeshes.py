@@ -12,8 +12,12 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+#'--compress' (anywhere after '--') stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-walkmeshes.py -- <infile.blend>[:layer] <outfile.wn>\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, in walkmesh format, indexed by the names of the objects that reference them.\n")
+	print("\n\nUsage:\nblender --background --python export-walkmeshes.py -- [--compress] <infile.blend>[:layer] <outfile.wn>\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, in walkmesh format, indexed by the names of the objects that reference them.\n")
 	exit(1)
 
 infile = args[0]
@@ -30,6 +34,11 @@ print("Will export meshes referenced from layer " + str(layer) + " of '" + infil
 
 import bpy
 import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
 
 import argparse
 
@@ -158,23 +167,17 @@ assert(position_count * 3*4 == len(positions))
 assert(normal_count * 3*4 == len(normals))
 
 #write the data chunk and index chunk to an output blob:
-blob = open(outfile, 'wb')
-
-def write_chunk(magic, data):
-	blob.write(struct.pack('4s',magic)) #type
-	blob.write(struct.pack('I', len(data))) #length
-	blob.write(data)
-
-#first chunk: the positions
-write_chunk(b'p...', positions)
-write_chunk(b'n...', normals)
-write_chunk(b'tri0', triangles)
-write_chunk(b'str0', strings)
-write_chunk(b'idxA', index)
-wrote = blob.tell()
-blob.close()
+chunks = [
+	(b'p...', positions),
+	(b'n...', normals),
+	(b'tri0', triangles),
+	(b'str0', strings),
+	(b'idxA', index),
+]
+wrote = chunk_io.write_chunks(outfile, chunks, compress)
 
 print("Wrote " + str(wrote) + " bytes [== " +
+	str(8 + 12 * len(chunks)) + " bytes of table of contents + " +
 	str(len(positions)+8) + " bytes of positions + " +
 	str(len(normals)+8) + " bytes of normals + " +
 	str(len(triangles)+8) + " bytes of triangles + " +
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+
+#Converts the vertices of a mesh file (from export-meshes.py or cook-meshes.py) or a bone animation file
+# (from export-bone-animations.py) to compact, quantized formats, which the GPU decodes through the
+# attribute formats set up in MeshBuffer.cpp and BoneAnimation.cpp (no shader changes needed):
+# - positions as half floats (x,y,z, and w = 1), 8 bytes;
+# - normals as GL_INT_2_10_10_10_REV, normalized (10 signed bits per component), 4 bytes;
+# - colors as before (four unorm8), 4 bytes;
+# - texture coordinates as two unorm16 (or, if any are outside [0,1], as two half floats), 4 bytes;
+# - bone weights as four unorm8 (rounded to still sum to one), and bone indices as four uint8, 4 bytes each.
+#
+#Runs with plain python 3 (no blender):
+#python3 quantize-vertices.py [--compress] <infile.pnc|.pnct|.banims> <outfile, of the same type>
+#
+#Vertex chunks are replaced as follows (all other chunks are copied):
+# pnc. len < half4 snorm10x3 unorm8x4 > * -> qnc. (16 bytes per vertex, from 28)
+# pnct len < half4 snorm10x3 unorm8x4 unorm16x2 > * -> qnct, or
+#        < half4 snorm10x3 unorm8x4 half2 > * -> qnch (20 bytes per vertex, from 36)
+# msh0 len < half4 snorm10x3 unorm8x4 half2 unorm8x4 uint8x4 > * -> msh1 (28 bytes per vertex, from 68)
+
+import sys
+import struct
+import os
+
+#chunk file reading and writing, shared with the other scripts here:
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import chunk_io
+
+args = sys.argv[1:]
+
+#'--compress' stores chunks zlib-compressed, where that makes them smaller (see ../read_chunk.hpp):
+compress = ('--compress' in args)
+args = [arg for arg in args if arg != '--compress']
+
+if len(args) != 2:
+	print("\n\nUsage:\npython3 quantize-vertices.py [--compress] <infile.pnc|.pnct|.banims> <outfile, of the same type>\nStores vertices in compact quantized formats (half float positions, 10-bit normals, 16-bit texture coordinates, 8-bit bone weights and indices).\n")
+	exit(1)
+
+infile = args[0]
+outfile = args[1]
+
+filetype = None
+for ext in [".pnc", ".pnct", ".banims"]:
+	if infile.endswith(ext) and outfile.endswith(ext):
+		filetype = ext
+if filetype == None:
+	print("ERROR: input and output should both be named with one of \".pnc\", \".pnct\", or \".banims\".")
+	exit(1)
+
+#------------ read ------------
+
+chunks = chunk_io.read_chunks(infile)
+
+#------------ quantize ------------
+
+def half4_position(x, y, z):
+	return struct.pack('eeee', x, y, z, 1.0)
+
+def snorm10_normal(x, y, z):
+	packed = 0
+	for (i, c) in enumerate([x, y, z]):
+		q = max(-511, min(511, int(round(c * 511.0))))
+		packed |= (q & 0x3ff) << (10 * i)
+	return struct.pack('I', packed) #(w, the top two bits, is zero)
+
+def unorm16_texcoord(u, v):
+	return struct.pack('HH', int(round(u * 65535.0)), int(round(v * 65535.0)))
+
+def half2_texcoord(u, v):
+	return struct.pack('ee', u, v)
+
+#weights rounded to multiples of 1/255, with the rounding error put on the largest so they still sum to one:
+def unorm8_weights(weights):
+	total = sum(weights)
+	if total <= 0.0: return struct.pack('BBBB', 255, 0, 0, 0)
+	q = [int(round(w / total * 255.0)) for w in weights]
+	largest = q.index(max(q))
+	q[largest] += 255 - sum(q)
+	return struct.pack('BBBB', *q)
+
+#largest error (over positions) that went into the half floats, for the report:
+position_error = 0.0
+def track_position_error(x, y, z, packed):
+	global position_error
+	(qx, qy, qz, qw) = struct.unpack('eeee', packed)
+	position_error = max(position_error, abs(qx - x), abs(qy - y), abs(qz - z))
+
+converted = None
+out_chunks = []
+for (magic, data) in chunks:
+	if filetype == ".pnc" and magic == b'pnc.':
+		out = b''
+		for (px,py,pz, nx,ny,nz, r,g,b,a) in struct.iter_unpack('3f3f4B', data):
+			position = half4_position(px,py,pz)
+			track_position_error(px,py,pz, position)
+			out += position + snorm10_normal(nx,ny,nz) + struct.pack('4B', r,g,b,a)
+		converted = (magic, len(data), b'qnc.', len(out), len(data) // 28)
+		out_chunks.append((b'qnc.', out))
+	elif filetype == ".pnct" and magic == b'pnct':
+		vertices = list(struct.iter_unpack('3f3f4B2f', data))
+		in_unit = all(0.0 <= v[10] <= 1.0 and 0.0 <= v[11] <= 1.0 for v in vertices)
+		out = b''
+		for (px,py,pz, nx,ny,nz, r,g,b,a, u,v) in vertices:
+			position = half4_position(px,py,pz)
+			track_position_error(px,py,pz, position)
+			out += position + snorm10_normal(nx,ny,nz) + struct.pack('4B', r,g,b,a)
+			out += (unorm16_texcoord(u,v) if in_unit else half2_texcoord(u,v))
+		out_magic = (b'qnct' if in_unit else b'qnch')
+		converted = (magic, len(data), out_magic, len(out), len(vertices))
+		out_chunks.append((out_magic, out))
+	elif filetype == ".banims" and magic == b'msh0':
+		out = b''
+		for vertex in struct.iter_unpack('3f3f4B2f4f4I', data):
+			(px,py,pz, nx,ny,nz, r,g,b,a, u,v) = vertex[0:12]
+			weights = vertex[12:16]
+			indices = vertex[16:20]
+			if max(indices) > 255:
+				print("ERROR: bone index " + str(max(indices)) + " doesn't fit in eight bits.")
+				exit(1)
+			position = half4_position(px,py,pz)
+			track_position_error(px,py,pz, position)
+			out += position + snorm10_normal(nx,ny,nz) + struct.pack('4B', r,g,b,a) + half2_texcoord(u,v)
+			out += unorm8_weights(weights) + struct.pack('4B', *indices)
+		converted = (magic, len(data), b'msh1', len(out), len(data) // 68)
+		out_chunks.append((b'msh1', out))
+	else:
+		out_chunks.append((magic, data))
+
+if converted == None:
+	print("ERROR: '" + infile + "' has no unquantized vertex chunk to convert.")
+	exit(1)
+
+(in_magic, in_bytes, out_magic, out_bytes, count) = converted
+print("Quantized " + str(count) + " vertices from '" + in_magic.decode() + "' (" + str(in_bytes // max(1, count)) + " bytes each) to '" + out_magic.decode() + "' (" + str(out_bytes // max(1, count)) + " bytes each); "
+	+ str(in_bytes) + " -> " + str(out_bytes) + " bytes, largest position error " + ("%.5f" % position_error) + ".")
+
+#------------ write ------------
+
+wrote = chunk_io.write_chunks(outfile, out_chunks, compress)
+
+print("Wrote " + str(wrote) + " bytes to '" + outfile + "'")
@@ -0,0 +1,22 @@
+#include "GL.hpp"
+#include "Load.hpp"
+
+//OctProgram draws a surface by looking up an octahedral environment map (see octahedral.hpp) using 3D texture coordinates; no lighting is done.
+struct OctProgram {
+	//opengl program object:
+	GLuint program = 0;
+
+	//uniform locations:
+	GLuint object_to_clip_mat4 = -1U;
+
+	//textures:
+	//texture0 - octahedral map (2D)
+
+	//attributes:
+	//Position (vec4 so you can set .w to zero to make sky far away)
+	//TexCoord (vec3)
+
+	OctProgram();
+};
+
+extern Load< OctProgram > oct_program;
@@ -0,0 +1,27 @@
+#include "GL.hpp"
+#include "Load.hpp"
+
+//OctReflectProgram draws a surface like CubeReflectProgram, but with octahedral environment maps (see octahedral.hpp) for lighting
+struct OctReflectProgram {
+	//opengl program object:
+	GLuint program = 0;
+
+	//uniform locations:
+	GLuint object_to_clip_mat4 = -1U;
+	GLuint object_to_light_mat4x3 = -1U;
+	GLuint normal_to_light_mat3 = -1U;
+	GLuint eye_vec3 = -1U; //camera position in lighting space
+
+	//textures:
+	//texture0 - octahedral map (diffuse)
+	//texture1 - octahedral map (shine)
+
+	//attributes:
+	//Position (vec4)
+	//Normal (vec3)
+	//Color (vec4)
+
+	OctReflectProgram();
+};
+
+extern Load< OctReflectProgram > oct_reflect_program;
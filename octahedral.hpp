@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+//Octahedral environment maps store every direction in one square 2D texture:
+// the unit octahedron |x|+|y|+|z| = 1 is projected down z and unfolded, so the upper (z >= 0) hemisphere
+// is the diamond in the middle of the square and the lower hemisphere folds out into the four corners.
+// (the square's center is +z, its corners are all -z, and the midpoints of its edges are +x/+y/-x/-y)
+//
+//Texture coordinates are in [0,1]^2 with t increasing upward (rows bottom-to-top, as in the stored pngs).
+// Mapping is continuous inside the square; neighbours across an edge of the square are the texels mirrored
+// about that edge's midpoint, which clamped filtering gets only approximately right (at most half a texel off).
+
+//sign that is never zero, so points on the axes fold consistently:
+inline glm::vec2 octahedral_sign(glm::vec2 const &v) {
+	return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+//(s,t) position of direction 'dir' (need not be normalized, must not be zero):
+inline glm::vec2 direction_to_octahedral(glm::vec3 const &dir) {
+	glm::vec3 p = dir / (std::abs(dir.x) + std::abs(dir.y) + std::abs(dir.z));
+	glm::vec2 st = glm::vec2(p.x, p.y);
+	if (p.z < 0.0f) {
+		st = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * octahedral_sign(st);
+	}
+	return st * 0.5f + 0.5f;
+}
+
+//direction (not normalized) through position (s,t):
+inline glm::vec3 octahedral_to_direction(glm::vec2 const &st) {
+	glm::vec2 p = st * 2.0f - 1.0f;
+	float z = 1.0f - std::abs(p.x) - std::abs(p.y);
+	if (z < 0.0f) {
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * octahedral_sign(p);
+	}
+	return glm::vec3(p, z);
+}
+
+//The same mapping (and lookups through it) for shaders, to be pasted into GLSL source.
+// Adjacent fragments on either side of an edge of the square have very different coordinates, so their
+// derivatives would pick the smallest mip level there; oct_texture() ignores derivatives that jump that far.
+#define OCTAHEDRAL_GLSL \
+	"vec2 octahedral_sign(vec2 v) {\n" \
+	"	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n" \
+	"}\n" \
+	"vec2 direction_to_octahedral(vec3 dir) {\n" \
+	"	vec3 p = dir / (abs(dir.x) + abs(dir.y) + abs(dir.z));\n" \
+	"	vec2 st = p.xy;\n" \
+	"	if (p.z < 0.0) st = (1.0 - abs(p.yx)) * octahedral_sign(st);\n" \
+	"	return st * 0.5 + 0.5;\n" \
+	"}\n" \
+	"vec3 octahedral_to_direction(vec2 st) {\n" \
+	"	vec2 p = st * 2.0 - 1.0;\n" \
+	"	float z = 1.0 - abs(p.x) - abs(p.y);\n" \
+	"	if (z < 0.0) p = (1.0 - abs(p.yx)) * octahedral_sign(p);\n" \
+	"	return vec3(p, z);\n" \
+	"}\n" \
+	"vec3 oct_texture(sampler2D tex, vec3 dir) {\n" \
+	"	vec2 st = direction_to_octahedral(dir);\n" \
+	"	vec2 dx = dFdx(st);\n" \
+	"	vec2 dy = dFdy(st);\n" \
+	"	if (dot(dx, dx) > 0.25) dx = vec2(0.0);\n" \
+	"	if (dot(dy, dy) > 0.25) dy = vec2(0.0);\n" \
+	"	return textureGrad(tex, st, dx, dy).rgb;\n" \
+	"}\n" \
+	"vec3 oct_texture_lod(sampler2D tex, vec3 dir, float lod) {\n" \
+	"	return textureLod(tex, direction_to_octahedral(dir), lod).rgb;\n" \
+	"}\n"
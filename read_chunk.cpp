@@ -0,0 +1,23 @@
+#include "read_chunk.hpp"
+
+#include <zlib.h>
+
+#include <stdexcept>
+
+void inflate_chunk(std::string const &what, uint8_t const *data, size_t size, std::vector< uint8_t > *_to) {
+	assert(_to);
+	auto &to = *_to;
+
+	uint32_t inflated_size = 0;
+	if (size < sizeof(inflated_size)) {
+		throw std::runtime_error("Compressed chunk " + what + " is missing its size.");
+	}
+	std::memcpy(&inflated_size, data, sizeof(inflated_size));
+
+	to.resize(inflated_size);
+	uLongf got = inflated_size;
+	int ret = uncompress(to.data(), &got, data + sizeof(inflated_size), uLong(size - sizeof(inflated_size)));
+	if (ret != Z_OK || got != inflated_size) {
+		throw std::runtime_error("Failed to decompress chunk " + what + " (zlib error " + std::to_string(ret) + ").");
+	}
+}
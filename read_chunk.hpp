@@ -1,9 +1,38 @@
 #pragma once
 
+#include "MappedFile.hpp"
+
 #include <iostream>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <future>
+#include <string>
 #include <stdexcept>
+#include <cstring>
 #include <cassert>
+#include <stdint.h>
+
+//Chunks may be stored zlib-compressed (the exporters in meshes/ do this when run with '--compress'):
+// a compressed chunk's magic number has the high bit of its last byte set (so 'idx0' is stored as 'idx\xb0'),
+// and its data is the uncompressed size (uint32_t) followed by a zlib stream.
+// Both readers below decompress these transparently, so code asks for chunks by their usual magic numbers.
+constexpr uint8_t CompressedChunkBit = 0x80;
+
+//does 'stored' (a magic number from a chunk header) name a compressed chunk?
+inline bool is_compressed_chunk(char const *stored) {
+	return (uint8_t(stored[3]) & CompressedChunkBit) != 0;
+}
+
+//the magic number of a chunk, with any compressed marker removed:
+inline std::string chunk_magic(char const *stored) {
+	std::string magic(stored, 4);
+	magic[3] = char(uint8_t(magic[3]) & ~CompressedChunkBit);
+	return magic;
+}
+
+//decompress the data of a compressed chunk (uncompressed size + zlib stream) into 'to' (throws, mentioning 'what', on corrupt data):
+void inflate_chunk(std::string const &what, uint8_t const *data, size_t size, std::vector< uint8_t > *to);
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
@@ -20,10 +49,25 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
 		throw std::runtime_error("Failed to read chunk header");
 	}
-	if (std::string(header.magic,4) != magic) {
+	if (chunk_magic(header.magic) != magic) {
 		throw std::runtime_error("Unexpected magic number in chunk");
 	}
 
+	if (is_compressed_chunk(header.magic)) {
+		std::vector< uint8_t > stored(header.size);
+		if (!from.read(reinterpret_cast< char * >(stored.data()), stored.size())) {
+			throw std::runtime_error("Failed to read chunk data.");
+		}
+		std::vector< uint8_t > data;
+		inflate_chunk("'" + magic + "'", stored.data(), stored.size(), &data);
+		if (data.size() % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk not divisible by element size");
+		}
+		to.resize(data.size() / sizeof(T));
+		if (!data.empty()) std::memcpy(&to[0], data.data(), data.size());
+		return;
+	}
+
 	if (header.size % sizeof(T) != 0) {
 		throw std::runtime_error("Size of chunk not divisible by element size");
 	}
@@ -33,3 +77,207 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 		throw std::runtime_error("Failed to read chunk data.");
 	}
 }
+
+//"ChunkSpan" is a read-only view of a chunk's elements, as returned by MappedChunks::read and ::find:
+template< typename T >
+struct ChunkSpan {
+	ChunkSpan() = default;
+	ChunkSpan(T const *data_, size_t size_) : data_ptr(data_), count(size_) { }
+
+	T const *data() const { return data_ptr; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const *begin() const { return data_ptr; }
+	T const *end() const { return data_ptr + count; }
+	T const &operator[](size_t i) const { assert(i < count); return data_ptr[i]; }
+
+	T const *data_ptr = nullptr;
+	size_t count = 0;
+};
+
+//"MappedChunks" reads the same chunks as read_chunk, but from a mapped file (see MappedFile.hpp):
+// each read returns a span pointing straight into the mapping, so data can go from disk to (e.g.) glBufferData without a copy.
+// Chunks are checked against the end of the file and against alignof(T); a chunk whose data isn't aligned for T
+// (e.g. one that follows a 'str0' chunk with an odd length) is copied once into storage owned by the reader, and counted in realigned_bytes.
+// (meshes/chunk_io.py pads chunk data to a multiple of four bytes, so files it writes don't need such copies.)
+// note: spans are valid only as long as the MappedChunks they came from.
+//
+//Files may start with a table of contents: a 'toc0' chunk of TocEntry records, one per following chunk,
+// giving its magic number and where its header starts (written by the exporters in meshes/).
+// Chunks can then be fetched by magic number with find(), in any order, skipping any that aren't needed,
+// and from several threads at once. Files without a table of contents work the same way;
+// the reader walks their chunk headers once when opening them.
+//
+//Compressed chunks are decompressed (into storage owned by the reader) the first time they are read or found,
+// on the calling thread; inflate_all() instead decompresses all of them up front, one thread per chunk.
+// Table of contents entries keep the stored magic number (compressed marker and all), and the stored size.
+struct MappedChunks {
+	struct TocEntry {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t offset = 0; //of the chunk's header, from the start of the file
+		uint32_t size = 0; //of the chunk's data
+	};
+	static_assert(sizeof(TocEntry) == 12, "TocEntry is packed");
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	//note: will throw if the file cannot be opened or mapped, or if its chunks (or table of contents) run past its end.
+	MappedChunks(std::string const &filename_) : file(filename_), at(file.data), filename(filename_) {
+		uint8_t const *end = file.data + file.size;
+		ChunkHeader header;
+		if (file.size >= sizeof(header)) std::memcpy(&header, file.data, sizeof(header));
+		if (file.size >= sizeof(header) && std::string(header.magic, 4) == "toc0") {
+			if (header.size % sizeof(TocEntry) != 0 || header.size > file.size - sizeof(header)) {
+				throw std::runtime_error("Table of contents in '" + filename + "' is truncated or misshapen.");
+			}
+			at += sizeof(header) + header.size;
+			toc.resize(header.size / sizeof(TocEntry));
+			std::memcpy(toc.data(), file.data + sizeof(header), header.size);
+			for (auto const &entry : toc) {
+				ChunkHeader check;
+				if (entry.offset < size_t(at - file.data) || entry.offset > file.size || file.size - entry.offset < sizeof(check) + size_t(entry.size)) {
+					throw std::runtime_error("Table of contents in '" + filename + "' points past the end of the file.");
+				}
+				std::memcpy(&check, file.data + entry.offset, sizeof(check));
+				if (std::memcmp(check.magic, entry.magic, 4) != 0 || check.size != entry.size) {
+					throw std::runtime_error("Table of contents in '" + filename + "' doesn't match chunk '" + std::string(entry.magic, 4) + "'.");
+				}
+			}
+		} else {
+			//no table of contents, so build one from the chunk headers:
+			for (uint8_t const *chunk = file.data; chunk != end; ) {
+				if (size_t(end - chunk) < sizeof(header)) {
+					throw std::runtime_error("Failed to read chunk header in '" + filename + "'.");
+				}
+				std::memcpy(&header, chunk, sizeof(header));
+				if (size_t(end - chunk) - sizeof(header) < header.size) {
+					throw std::runtime_error("Failed to read chunk data ('" + std::string(header.magic, 4) + "') in '" + filename + "'.");
+				}
+				toc.emplace_back();
+				std::memcpy(toc.back().magic, header.magic, 4);
+				toc.back().offset = uint32_t(chunk - file.data);
+				toc.back().size = header.size;
+				chunk += sizeof(header) + header.size;
+			}
+		}
+		used.assign(toc.size(), false);
+		inflated.assign(toc.size(), nullptr);
+	}
+
+	MappedChunks(MappedChunks const &) = delete;
+	MappedChunks &operator=(MappedChunks const &) = delete;
+
+	//read the next chunk (in file order), which must have the given magic number:
+	template< typename T >
+	ChunkSpan< T > read(std::string const &magic) {
+		uint32_t offset = uint32_t(at - file.data);
+		for (uint32_t i = 0; i < toc.size(); ++i) {
+			if (toc[i].offset != offset) continue;
+			if (chunk_magic(toc[i].magic) != magic) {
+				throw std::runtime_error("Unexpected magic number in chunk (expecting '" + magic + "') in '" + filename + "'.");
+			}
+			at += sizeof(ChunkHeader) + toc[i].size;
+			return span< T >(i);
+		}
+		throw std::runtime_error("Failed to read chunk header ('" + magic + "') in '" + filename + "'.");
+	}
+
+	//fetch the (first) chunk with the given magic number, wherever it is in the file:
+	// (safe to call from several threads at once)
+	template< typename T >
+	ChunkSpan< T > find(std::string const &magic) {
+		for (uint32_t i = 0; i < toc.size(); ++i) {
+			if (chunk_magic(toc[i].magic) == magic) return span< T >(i);
+		}
+		throw std::runtime_error("No chunk '" + magic + "' in '" + filename + "'.");
+	}
+
+	//does the file have a chunk with the given magic number?
+	bool has(std::string const &magic) const {
+		for (auto const &entry : toc) {
+			if (chunk_magic(entry.magic) == magic) return true;
+		}
+		return false;
+	}
+
+	//magic numbers of chunks that haven't been read (or found), for warnings about extra data:
+	std::vector< std::string > unread() {
+		std::unique_lock< std::mutex > lock(mutex);
+		std::vector< std::string > ret;
+		for (uint32_t i = 0; i < toc.size(); ++i) {
+			if (!used[i]) ret.emplace_back(chunk_magic(toc[i].magic));
+		}
+		return ret;
+	}
+
+	//decompress every compressed chunk that hasn't been yet, each on its own thread, and wait for them:
+	// (worthwhile for files with several large compressed chunks; chunks still count as unread until read or found)
+	void inflate_all() {
+		std::vector< std::future< void > > inflating;
+		for (uint32_t i = 0; i < toc.size(); ++i) {
+			if (!is_compressed_chunk(toc[i].magic)) continue;
+			inflating.emplace_back(std::async(std::launch::async, [this,i](){ inflated_data(i); }));
+		}
+		for (auto &f : inflating) f.get(); //(rethrows any decompression errors)
+	}
+
+	//decompressed data of compressed chunk toc[i] (decompressed on first call):
+	std::vector< uint8_t > const &inflated_data(uint32_t i) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			if (inflated[i]) return *inflated[i];
+		}
+		//decompress without holding the lock, so other chunks can decompress at the same time:
+		std::vector< uint8_t > data;
+		inflate_chunk("'" + chunk_magic(toc[i].magic) + "' in '" + filename + "'", file.data + toc[i].offset + sizeof(ChunkHeader), toc[i].size, &data);
+		std::unique_lock< std::mutex > lock(mutex);
+		if (!inflated[i]) { //(unless another thread got here first)
+			inflated_bytes += data.size();
+			owned.emplace_back(std::move(data));
+			inflated[i] = &owned.back();
+		}
+		return *inflated[i];
+	}
+
+	//span over the data of chunk toc[i] (realigned or decompressed if needed):
+	template< typename T >
+	ChunkSpan< T > span(uint32_t i) {
+		TocEntry const &entry = toc[i];
+		if (is_compressed_chunk(entry.magic)) {
+			std::vector< uint8_t > const &data = inflated_data(i);
+			if (data.size() % sizeof(T) != 0) {
+				throw std::runtime_error("Size of chunk '" + chunk_magic(entry.magic) + "' in '" + filename + "' not divisible by element size.");
+			}
+			std::unique_lock< std::mutex > lock(mutex);
+			used[i] = true;
+			return ChunkSpan< T >(reinterpret_cast< T const * >(data.data()), data.size() / sizeof(T));
+		}
+		if (entry.size % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk '" + std::string(entry.magic, 4) + "' in '" + filename + "' not divisible by element size.");
+		}
+		uint8_t const *data = file.data + entry.offset + sizeof(ChunkHeader);
+		std::unique_lock< std::mutex > lock(mutex);
+		used[i] = true;
+		if (reinterpret_cast< uintptr_t >(data) % alignof(T) != 0) {
+			owned.emplace_back(data, data + entry.size); //(new[]'d storage is aligned for any T)
+			realigned_bytes += entry.size;
+			data = owned.back().data();
+		}
+		return ChunkSpan< T >(reinterpret_cast< T const * >(data), entry.size / sizeof(T));
+	}
+
+	MappedFile file;
+	uint8_t const *at = nullptr; //start of next chunk for read()
+	std::string filename;
+	std::vector< TocEntry > toc; //every chunk after the table of contents (from the file, or from walking the headers)
+	std::mutex mutex; //guards 'used', 'inflated', and 'owned'
+	std::vector< bool > used; //per toc entry: has it been read or found?
+	std::vector< std::vector< uint8_t > const * > inflated; //per toc entry: decompressed data (in 'owned'), once decompressed
+	std::list< std::vector< uint8_t > > owned; //decompressed chunks, and copies of chunks that weren't aligned in the file
+	size_t realigned_bytes = 0;
+	size_t inflated_bytes = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+//GL_RGB9_E5 shared-exponent texels, packed as for GL_UNSIGNED_INT_5_9_9_9_REV:
+// bits 0-8 red, 9-17 green, 18-26 blue mantissas; bits 27-31 exponent (bias 15).
+//see the EXT_texture_shared_exponent specification for the conversion rules used here.
+
+inline uint32_t float_to_rgb9e5(glm::vec3 col) {
+	constexpr int32_t Bias = 15;
+	constexpr int32_t Mantissa = 9;
+	constexpr float Max = float(511.0 / 512.0 * 65536.0); //largest representable value
+
+	//clamp (written so that NaN becomes zero):
+	glm::vec3 c;
+	for (uint32_t i = 0; i < 3; ++i) {
+		c[i] = (col[i] > 0.0f ? std::min(col[i], Max) : 0.0f);
+	}
+	float m = std::max(c.r, std::max(c.g, c.b));
+	if (m <= 0.0f) return 0;
+
+	int e;
+	std::frexp(m, &e); //m = f * 2^e, f in [0.5,1), so floor(log2(m)) = e - 1
+	int32_t exp = std::max(-Bias - 1, e - 1) + 1 + Bias;
+	if (int32_t(std::floor(m / std::ldexp(1.0f, exp - Bias - Mantissa) + 0.5f)) == (1 << Mantissa)) {
+		exp += 1;
+	}
+	float scale = std::ldexp(1.0f, -(exp - Bias - Mantissa));
+	uint32_t r = uint32_t(std::floor(c.r * scale + 0.5f));
+	uint32_t g = uint32_t(std::floor(c.g * scale + 0.5f));
+	uint32_t b = uint32_t(std::floor(c.b * scale + 0.5f));
+	return r | (g << 9) | (b << 18) | (uint32_t(exp) << 27);
+}
+
+inline glm::vec3 rgb9e5_to_float(uint32_t bits) {
+	float scale = std::ldexp(1.0f, int32_t(bits >> 27) - 15 - 9);
+	return glm::vec3(
+		float(bits & 0x1ff) * scale,
+		float((bits >> 9) & 0x1ff) * scale,
+		float((bits >> 18) & 0x1ff) * scale
+	);
+}
@@ -0,0 +1,332 @@
+#include "rgbe_n.hpp"
+
+#include "rgbe.hpp"
+
+#include <cstring>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RGBE_N_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define RGBE_N_AVX2
+#else
+#define RGBE_N_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 is tightly packed");
+static_assert(sizeof(glm::u8vec4) == 4, "u8vec4 is tightly packed");
+
+//Why the tricks below are exact:
+// decode: ldexp((c + 0.5) / 256, e - 128) == (c + 0.5) * 2^(e - 136), and every value of that form
+//   (nine significant bits, exponent >= -145) is representable, so one multiply by a table entry gives the same bits.
+// encode: frexp(d) / d is exactly 2^-e, so fac = 255.999f * 2^-e is 255.999f with its exponent field
+//   lowered by e; this is computed with integer math on the bits of 255.999f.
+//   d > 1e-32 means d is always normal, so e comes straight from the exponent field of d.
+//   inf/nan inputs have no such guarantee, so those pixels are handed to float_to_rgbe().
+
+namespace {
+
+struct ExponentTable {
+	ExponentTable() {
+		for (int a = 0; a < 256; ++a) {
+			scale[a] = std::ldexp(1.0f / 256.0f, a - 128);
+		}
+	}
+	float scale[256];
+};
+
+float const *exponent_table() {
+	static ExponentTable table;
+	return table.scale;
+}
+
+uint32_t float_bits(float f) {
+	uint32_t ret;
+	std::memcpy(&ret, &f, 4);
+	return ret;
+}
+
+float bits_float(uint32_t b) {
+	float ret;
+	std::memcpy(&ret, &b, 4);
+	return ret;
+}
+
+const uint32_t FacBits = float_bits(255.999f);
+
+//---------- scalar ----------
+
+void rgbe_to_float_scalar(glm::u8vec4 const *in, size_t count, glm::vec3 *out) {
+	float const *scale = exponent_table();
+	for (size_t i = 0; i < count; ++i) {
+		glm::u8vec4 px = in[i];
+		if (px == glm::u8vec4(0,0,0,0)) {
+			out[i] = glm::vec3(0.0f);
+		} else {
+			float s = scale[px.a];
+			out[i] = glm::vec3((px.r + 0.5f) * s, (px.g + 0.5f) * s, (px.b + 0.5f) * s);
+		}
+	}
+}
+
+void float_to_rgbe_scalar(glm::vec3 const *in, size_t count, glm::u8vec4 *out) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 col = in[i];
+		float d = std::max(col.r, std::max(col.g, col.b));
+		if (d <= 1e-32f) {
+			out[i] = glm::u8vec4(0,0,0,0);
+			continue;
+		}
+		uint32_t exp_field = (float_bits(d) >> 23) & 0xff;
+		if (exp_field == 0xff) { //inf/nan
+			out[i] = float_to_rgbe(col);
+			continue;
+		}
+		if (exp_field >= 254) { //e > 127
+			out[i] = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+			continue;
+		}
+		float fac = bits_float(FacBits - ((exp_field - 126) << 23));
+		out[i] = glm::u8vec4(
+			std::max(0, int32_t(col.r * fac)),
+			std::max(0, int32_t(col.g * fac)),
+			std::max(0, int32_t(col.b * fac)),
+			exp_field + 2
+		);
+	}
+}
+
+#ifdef RGBE_N_X86
+
+//---------- SSE2 ----------
+
+void rgbe_to_float_sse2(glm::u8vec4 const *in, size_t count, glm::vec3 *out) {
+	float const *scale = exponent_table();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i px = _mm_loadu_si128(reinterpret_cast< __m128i const * >(in + i));
+		__m128i mask = _mm_set1_epi32(0xff);
+		__m128 half = _mm_set1_ps(0.5f);
+		__m128 s = _mm_setr_ps(scale[in[i+0].a], scale[in[i+1].a], scale[in[i+2].a], scale[in[i+3].a]);
+		__m128 keep = _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(px, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+		s = _mm_and_ps(s, keep); //zero pixels decode to zero
+		__m128 r = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(px, mask)), half), s);
+		__m128 g = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask)), half), s);
+		__m128 b = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask)), half), s);
+
+		//interleave to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3:
+		__m128 rg_lo = _mm_unpacklo_ps(r, g);
+		__m128 rg_hi = _mm_unpackhi_ps(r, g);
+		__m128 o0 = _mm_shuffle_ps(rg_lo, _mm_shuffle_ps(b, rg_lo, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,0,1,0));
+		__m128 o1 = _mm_shuffle_ps(_mm_shuffle_ps(rg_lo, b, _MM_SHUFFLE(1,1,3,3)), rg_hi, _MM_SHUFFLE(1,0,2,0));
+		__m128 o2 = _mm_shuffle_ps(_mm_shuffle_ps(b, rg_hi, _MM_SHUFFLE(2,2,2,2)), _mm_shuffle_ps(rg_hi, b, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(2,0,2,0));
+		float *dst = reinterpret_cast< float * >(out + i);
+		_mm_storeu_ps(dst + 0, o0);
+		_mm_storeu_ps(dst + 4, o1);
+		_mm_storeu_ps(dst + 8, o2);
+	}
+	rgbe_to_float_scalar(in + i, count - i, out + i);
+}
+
+void float_to_rgbe_sse2(glm::vec3 const *in, size_t count, glm::u8vec4 *out) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float const *src = reinterpret_cast< float const * >(in + i);
+		__m128 a = _mm_loadu_ps(src + 0);
+		__m128 b = _mm_loadu_ps(src + 4);
+		__m128 c = _mm_loadu_ps(src + 8);
+
+		//de-interleave to r, g, b:
+		__m128 R = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,3,0));
+		__m128 G = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+		__m128 B = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+
+		//same operand order as std::max, so nan propagates identically:
+		__m128 d = _mm_max_ps(_mm_max_ps(B, G), R);
+		__m128i exp_field = _mm_and_si128(_mm_srli_epi32(_mm_castps_si128(d), 23), _mm_set1_epi32(0xff));
+
+		__m128i small = _mm_castps_si128(_mm_cmple_ps(d, _mm_set1_ps(1e-32f)));
+		__m128i special = _mm_andnot_si128(small, _mm_cmpeq_epi32(exp_field, _mm_set1_epi32(0xff)));
+		if (_mm_movemask_epi8(special)) {
+			float_to_rgbe_scalar(in + i, 4, out + i);
+			continue;
+		}
+		__m128i overflow = _mm_cmpgt_epi32(exp_field, _mm_set1_epi32(253));
+
+		__m128 fac = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(FacBits), _mm_slli_epi32(_mm_sub_epi32(exp_field, _mm_set1_epi32(126)), 23)));
+		__m128i zero = _mm_setzero_si128();
+		__m128i ri = _mm_cvttps_epi32(_mm_mul_ps(R, fac));
+		__m128i gi = _mm_cvttps_epi32(_mm_mul_ps(G, fac));
+		__m128i bi = _mm_cvttps_epi32(_mm_mul_ps(B, fac));
+		ri = _mm_and_si128(ri, _mm_cmpgt_epi32(ri, zero));
+		gi = _mm_and_si128(gi, _mm_cmpgt_epi32(gi, zero));
+		bi = _mm_and_si128(bi, _mm_cmpgt_epi32(bi, zero));
+		__m128i ei = _mm_add_epi32(exp_field, _mm_set1_epi32(2));
+
+		//(masking matches the truncation to uint8_t in float_to_rgbe, which matters if a non-max channel is nan)
+		__m128i byte = _mm_set1_epi32(0xff);
+		__m128i packed = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(ri, byte), _mm_slli_epi32(_mm_and_si128(gi, byte), 8)),
+			_mm_or_si128(_mm_slli_epi32(_mm_and_si128(bi, byte), 16), _mm_slli_epi32(ei, 24))
+		);
+		packed = _mm_or_si128(packed, overflow);
+		packed = _mm_andnot_si128(small, packed);
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(out + i), packed);
+	}
+	float_to_rgbe_scalar(in + i, count - i, out + i);
+}
+
+//---------- AVX2 ----------
+//(same as SSE2, but eight pixels at a time; in-lane shuffles act on pixels 0-3 and 4-7 separately)
+
+RGBE_N_AVX2
+void rgbe_to_float_avx2(glm::u8vec4 const *in, size_t count, glm::vec3 *out) {
+	float const *scale = exponent_table();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i px = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(in + i));
+		__m256i mask = _mm256_set1_epi32(0xff);
+		__m256 half = _mm256_set1_ps(0.5f);
+		__m256 s = _mm256_i32gather_ps(scale, _mm256_srli_epi32(px, 24), 4);
+		__m256 keep = _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(px, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+		s = _mm256_and_ps(s, keep);
+		__m256 r = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, mask)), half), s);
+		__m256 g = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask)), half), s);
+		__m256 b = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask)), half), s);
+
+		__m256 rg_lo = _mm256_unpacklo_ps(r, g);
+		__m256 rg_hi = _mm256_unpackhi_ps(r, g);
+		__m256 o0 = _mm256_shuffle_ps(rg_lo, _mm256_shuffle_ps(b, rg_lo, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,0,1,0));
+		__m256 o1 = _mm256_shuffle_ps(_mm256_shuffle_ps(rg_lo, b, _MM_SHUFFLE(1,1,3,3)), rg_hi, _MM_SHUFFLE(1,0,2,0));
+		__m256 o2 = _mm256_shuffle_ps(_mm256_shuffle_ps(b, rg_hi, _MM_SHUFFLE(2,2,2,2)), _mm256_shuffle_ps(rg_hi, b, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(2,0,2,0));
+		float *dst = reinterpret_cast< float * >(out + i);
+		_mm256_storeu_ps(dst + 0, _mm256_permute2f128_ps(o0, o1, 0x20));
+		_mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(o2, o0, 0x30));
+		_mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(o1, o2, 0x31));
+	}
+	rgbe_to_float_scalar(in + i, count - i, out + i);
+}
+
+RGBE_N_AVX2
+void float_to_rgbe_avx2(glm::vec3 const *in, size_t count, glm::u8vec4 *out) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		float const *src = reinterpret_cast< float const * >(in + i);
+		__m256 l0 = _mm256_loadu_ps(src + 0);
+		__m256 l1 = _mm256_loadu_ps(src + 8);
+		__m256 l2 = _mm256_loadu_ps(src + 16);
+		__m256 a = _mm256_permute2f128_ps(l0, l1, 0x30);
+		__m256 b = _mm256_permute2f128_ps(l0, l2, 0x21);
+		__m256 c = _mm256_permute2f128_ps(l1, l2, 0x30);
+
+		__m256 R = _mm256_shuffle_ps(a, _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,3,0));
+		__m256 G = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+		__m256 B = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+
+		__m256 d = _mm256_max_ps(_mm256_max_ps(B, G), R);
+		__m256i exp_field = _mm256_and_si256(_mm256_srli_epi32(_mm256_castps_si256(d), 23), _mm256_set1_epi32(0xff));
+
+		__m256i small = _mm256_castps_si256(_mm256_cmp_ps(d, _mm256_set1_ps(1e-32f), _CMP_LE_OQ));
+		__m256i special = _mm256_andnot_si256(small, _mm256_cmpeq_epi32(exp_field, _mm256_set1_epi32(0xff)));
+		if (_mm256_movemask_epi8(special)) {
+			float_to_rgbe_scalar(in + i, 8, out + i);
+			continue;
+		}
+		__m256i overflow = _mm256_cmpgt_epi32(exp_field, _mm256_set1_epi32(253));
+
+		__m256 fac = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(FacBits), _mm256_slli_epi32(_mm256_sub_epi32(exp_field, _mm256_set1_epi32(126)), 23)));
+		__m256i zero = _mm256_setzero_si256();
+		__m256i ri = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(R, fac)), zero);
+		__m256i gi = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(G, fac)), zero);
+		__m256i bi = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(B, fac)), zero);
+		__m256i ei = _mm256_add_epi32(exp_field, _mm256_set1_epi32(2));
+
+		__m256i byte = _mm256_set1_epi32(0xff);
+		__m256i packed = _mm256_or_si256(
+			_mm256_or_si256(_mm256_and_si256(ri, byte), _mm256_slli_epi32(_mm256_and_si256(gi, byte), 8)),
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(bi, byte), 16), _mm256_slli_epi32(ei, 24))
+		);
+		packed = _mm256_or_si256(packed, overflow);
+		packed = _mm256_andnot_si256(small, packed);
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(out + i), packed);
+	}
+	float_to_rgbe_scalar(in + i, count - i, out + i);
+}
+
+#endif //RGBE_N_X86
+
+RGBEPath resolve(RGBEPath path) {
+	if (path == RGBEPathBest) {
+		static RGBEPath best = []() -> RGBEPath {
+			if (rgbe_path_supported(RGBEPathAVX2)) return RGBEPathAVX2;
+			if (rgbe_path_supported(RGBEPathSSE2)) return RGBEPathSSE2;
+			return RGBEPathScalar;
+		}();
+		return best;
+	}
+	if (!rgbe_path_supported(path)) return RGBEPathScalar;
+	return path;
+}
+
+} //namespace
+
+bool cpu_has_avx2() {
+	#if defined(RGBE_N_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!(osxsave && avx)) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS saves ymm state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+	#elif defined(RGBE_N_X86)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+	#else
+	return false;
+	#endif
+}
+
+bool rgbe_path_supported(RGBEPath path) {
+	if (path == RGBEPathScalar || path == RGBEPathBest) return true;
+	#ifdef RGBE_N_X86
+	if (path == RGBEPathSSE2) return true;
+	if (path == RGBEPathAVX2) {
+		static bool avx2 = cpu_has_avx2();
+		return avx2;
+	}
+	#endif
+	return false;
+}
+
+char const *rgbe_path_name(RGBEPath path) {
+	if (path == RGBEPathScalar) return "scalar";
+	if (path == RGBEPathSSE2) return "sse2";
+	if (path == RGBEPathAVX2) return "avx2";
+	if (path == RGBEPathBest) return rgbe_path_name(resolve(path));
+	return "(unknown)";
+}
+
+void rgbe_to_float_n(glm::u8vec4 const *in, size_t count, glm::vec3 *out, RGBEPath path) {
+	path = resolve(path);
+	#ifdef RGBE_N_X86
+	if (path == RGBEPathAVX2) { rgbe_to_float_avx2(in, count, out); return; }
+	if (path == RGBEPathSSE2) { rgbe_to_float_sse2(in, count, out); return; }
+	#endif
+	rgbe_to_float_scalar(in, count, out);
+}
+
+void float_to_rgbe_n(glm::vec3 const *in, size_t count, glm::u8vec4 *out, RGBEPath path) {
+	path = resolve(path);
+	#ifdef RGBE_N_X86
+	if (path == RGBEPathAVX2) { float_to_rgbe_avx2(in, count, out); return; }
+	if (path == RGBEPathSSE2) { float_to_rgbe_sse2(in, count, out); return; }
+	#endif
+	float_to_rgbe_scalar(in, count, out);
+}
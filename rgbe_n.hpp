@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+//Batch versions of the conversions in rgbe.hpp.
+// These produce exactly the same bits as calling rgbe_to_float / float_to_rgbe on each pixel,
+// but use an exponent lookup table and (where available) SSE2 or AVX2 code.
+
+enum RGBEPath {
+	RGBEPathScalar, //table-based, one pixel at a time
+	RGBEPathSSE2,   //four pixels at a time
+	RGBEPathAVX2,   //eight pixels at a time
+	RGBEPathBest    //fastest path supported by the running CPU
+};
+
+//is a given path supported by this build + CPU?
+bool rgbe_path_supported(RGBEPath path);
+char const *rgbe_path_name(RGBEPath path);
+
+//does the running CPU (and OS) support AVX2? (cubes/cube_lookup.cpp picks its path with this too)
+bool cpu_has_avx2();
+
+//convert count pixels; 'in' and 'out' must not overlap:
+void rgbe_to_float_n(glm::u8vec4 const *in, size_t count, glm::vec3 *out, RGBEPath path = RGBEPathBest);
+void float_to_rgbe_n(glm::vec3 const *in, size_t count, glm::u8vec4 *out, RGBEPath path = RGBEPathBest);